@@ -0,0 +1,57 @@
+#include <iostream>
+#include <exception>
+#include <string>
+#include <ShaderLang.h>
+#include "phase_benchmark.h"
+
+// The phase benchmark is its own executable: it replaces the global
+// allocation functions to count allocations, which ShaderRetriever itself
+// must not pay for.
+namespace {
+const char* kUsage = "ShaderRetrieverBenchmark [--baseline <file>] [--save-baseline <file>] [--regression-threshold <percent>]";
+
+std::string NextArgument(int argc, char** argv, int& i) {
+    if (i + 1 >= argc) {
+        throw std::runtime_error(std::string(argv[i]) + " requires an argument.");
+    }
+    return argv[++i];
+}
+}
+
+int main(int argc, char** argv) {
+    int ret = 0;
+    try {
+        PhaseBenchmarkOptions options;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg == "--baseline") {
+                options.baseline_path = NextArgument(argc, argv, i);
+            }
+            else if (arg == "--save-baseline") {
+                options.save_baseline_path = NextArgument(argc, argv, i);
+            }
+            else if (arg == "--regression-threshold") {
+                const auto value = NextArgument(argc, argv, i);
+                try {
+                    options.regression_threshold = static_cast<uint32_t>(std::stoul(value));
+                }
+                catch (std::exception&) {
+                    throw std::runtime_error("invalid number " + value + ".");
+                }
+            }
+            else {
+                throw std::runtime_error("unknown option " + arg + ".");
+            }
+        }
+
+        glslang::InitializeProcess();
+        ret = RunPhaseBenchmark(options, std::cout) ? 0 : 1;
+        glslang::FinalizeProcess();
+    }
+    catch (std::exception& error) {
+        std::cout << error.what() << std::endl;
+        std::cout << kUsage << std::endl;
+        ret = 1;
+    }
+    return ret;
+}
@@ -0,0 +1,128 @@
+#include <iostream>
+#include <fstream>
+#include <streambuf>
+#include <exception>
+#include <chrono>
+#include <map>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <json.hpp>
+#include "local_socket.h"
+#include "server_protocol.h"
+
+using JSON = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+const char* kUsage = "ShaderRetrieverClient <socket path> [--shutdown] <config>...";
+
+std::string ReadFile(const std::string& path, std::ios::openmode mode = std::ios::in) {
+    std::ifstream file(path, mode);
+    if (!file.is_open()) {
+        throw std::runtime_error(path + " can not be loaded.");
+    }
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+// The server may run in another directory, so sources travel inline.
+JSON MakeRequest(uint32_t id, const std::string& config_path) {
+    JSON config = JSON::parse(ReadFile(config_path));
+    if (config.count("sources") == 0) {
+        throw std::runtime_error(config_path + ": shader must exists.");
+    }
+    for (auto it = config["sources"].begin(); it != config["sources"].end(); ++it) {
+        auto& stage = it.value();
+        if (stage.count("source") == 0 && stage.count("path") > 0) {
+            stage["source"] = ReadFile(stage["path"].get<std::string>());
+        }
+    }
+    JSON request;
+    request["id"] = id;
+    request["config"] = config;
+    return request;
+}
+
+bool WriteOutputs(const Frame& response) {
+    for (const auto& binary : response.header["binaries"]) {
+        std::ofstream sr_file(binary["path"].get<std::string>(), std::ios::binary);
+        if (!sr_file.is_open()) {
+            return false;
+        }
+        sr_file.write(response.payload.data() + binary["offset"].get<size_t>(), binary["size"].get<size_t>());
+    }
+    std::ofstream sd_file(response.header["descriptor_path"].get<std::string>());
+    if (!sd_file.is_open()) {
+        return false;
+    }
+    sd_file << std::setw(4) << response.header["descriptor"];
+    return true;
+}
+}
+
+int main(int argc, char** argv) {
+    int ret = 0;
+    try {
+        if (argc < 3) {
+            throw std::runtime_error("a socket path and a config must be specified.");
+        }
+        auto socket = LocalSocket::connect(argv[1]);
+
+        std::vector<std::string> config_paths;
+        bool shutdown = false;
+        for (int i = 2; i < argc; ++i) {
+            if (std::string(argv[i]) == "--shutdown") {
+                shutdown = true;
+            }
+            else {
+                config_paths.push_back(argv[i]);
+            }
+        }
+
+        // Every request is sent before the first response is read, so the
+        // server compiles them concurrently.
+        std::vector<Clock::time_point> sent_times;
+        for (uint32_t id = 0; id < config_paths.size(); ++id) {
+            Frame request;
+            request.header = MakeRequest(id, config_paths[id]);
+            sent_times.push_back(Clock::now());
+            if (!WriteFrame(socket, request)) {
+                throw std::runtime_error("request can not be sent.");
+            }
+        }
+
+        std::vector<double> latencies;
+        for (size_t i = 0; i < config_paths.size(); ++i) {
+            Frame response;
+            if (!ReadFrame(socket, response)) {
+                throw std::runtime_error("connection closed by the server.");
+            }
+            auto id = response.header["id"].get<uint32_t>();
+            latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - sent_times[id]).count());
+
+            std::cout << config_paths[id] << ": " << latencies.back() << " ms" << std::endl;
+            std::cout << response.header["log"].get<std::string>();
+            if (!response.header["succeeded"].get<bool>() || !WriteOutputs(response)) {
+                std::cout << config_paths[id] << " failed." << std::endl;
+                ret = 1;
+            }
+        }
+        if (!latencies.empty()) {
+            std::sort(latencies.begin(), latencies.end());
+            std::cout << "p50 latency: " << latencies[latencies.size() / 2] << " ms" << std::endl;
+        }
+
+        if (shutdown) {
+            Frame request;
+            request.header["id"] = config_paths.size();
+            request.header["command"] = "shutdown";
+            WriteFrame(socket, request);
+        }
+    }
+    catch (std::exception& error) {
+        std::cout << error.what() << std::endl;
+        std::cout << kUsage << std::endl;
+        ret = 1;
+    }
+    return ret;
+}
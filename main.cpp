@@ -1,103 +1,145 @@
 #include <iostream>
-#include <fstream>
 #include <exception>
-#include <streambuf>
-#include <new>
-#include <cstring>
-#include <cassert>
-#include <map>
-#include <vector>
+#include <memory>
+#include <thread>
+#include <algorithm>
 #include <ShaderLang.h>
-#include <GlslangToSpv.h>
+#include "options.h"
 #include "config.h"
-#include "spv_program.h"
-#include "shader_descriptor.h"
+#include "manifest.h"
+#include "batch_compiler.h"
+#include "program_compiler.h"
+#include "compile_cache.h"
+#include "compile_server.h"
+#include "watch_mode.h"
+#include "shader_archive_writer.h"
+#include "spirv_postprocess.h"
+#include "spirv_codec_benchmark.h"
+#include "tracer.h"
+#include "layout_planner.h"
+#include "include_cache.h"
 
 int main(int argc, char** argv) {
-    std::vector<glslang::TShader*> p_shaders;
-    std::vector<glslang::TShader*> p_pc_shaders;
+    int ret = 0;
 	try {
-        if (argc < 2) {
-            throw std::exception("input must be specified.");
+        Options options(argc, argv);
+        if (options.codec_benchmark) {
+            return RunCodecBenchmark(options.benchmark_paths, std::cout) ? 0 : 1;
         }
-        
-		Config config(argv[1]);
+
+        CompileContext context;
+        context.descriptor_format = options.descriptor_format;
+        context.spirv_encoding = options.spirv_encoding;
+        context.write_depfiles = options.depfiles;
+        context.write_cpp_headers = options.cpp_headers;
+        IncludeCache include_cache;
+        context.p_include_cache = &include_cache;
+        std::unique_ptr<CompileCache> p_cache;
+        if (!options.cache_path.empty()) {
+            p_cache.reset(new CompileCache(options.cache_path, (uint64_t)options.cache_size_mb << 20));
+            context.p_cache = p_cache.get();
+        }
+        SpirvStatistics spirv_stats;
+        if (options.strip_spirv) {
+            context.p_spirv_stats = &spirv_stats;
+        }
+        std::unique_ptr<Tracer> p_tracer;
+        if (!options.trace_path.empty() || options.trace_summary > 0) {
+            p_tracer.reset(new Tracer());
+            context.p_tracer = p_tracer.get();
+        }
+        LayoutPlanner layout_planner;
+        if (options.isPlanningLayouts()) {
+            context.p_layout_planner = &layout_planner;
+        }
+        std::unique_ptr<ArchiveWriter> p_archive;
+        if (!options.archive_path.empty()) {
+            p_archive.reset(new ArchiveWriter(options.archive_path));
+            context.p_archive = p_archive.get();
+        }
+
 		glslang::InitializeProcess();
-        const auto& stages = config.getStages();
-        uint32_t stage_count = config.getStages().size();
-        p_shaders.resize(stage_count);
-        p_pc_shaders.resize(stage_count);
-        
-        for (uint32_t i = 0; i < stage_count; ++i) {
-            auto sh_stage = VKStageFlagToEShStage(stages[i]);
-            CreateShader(sh_stage, p_shaders[i]);
-            CreateShader(sh_stage, p_pc_shaders[i]);
-            if (p_shaders[i] == nullptr) {
-                std::cout
-                    << "Something is going wrong,"
-                    << "memory allocation failed!"
-                    << std::endl;
-                return 1;
+        if (options.isServer()) {
+            CompileServer server(options.server_path, options.jobs, context);
+            server.run();
+        }
+        else if (options.watch) {
+            std::unique_ptr<Manifest> p_manifest(options.isBatch() ?
+                new Manifest(options.manifest_path) :
+                new Manifest(std::vector<Manifest::Program>{ { options.config_path, nullptr } }));
+            WatchSession watch_session(*p_manifest, options, context);
+            watch_session.run();
+        }
+        else if (options.isBatch()) {
+            Manifest manifest(options.manifest_path);
+            BatchCompiler batch_compiler(manifest, options, context);
+            ret = batch_compiler.run() ? 0 : 1;
+            if (!options.layout_table_path.empty() &&
+                !layout_planner.writeFile(options.layout_table_path, manifest.draw_groups, std::cout)) {
+                std::cout << options.layout_table_path << " can not be written!" << std::endl;
+                ret = 1;
             }
-
-            auto& srcs = LoadShaderSoruces({ config.shaderFilepaths[stages[i]] });
-            std::vector<const char*> c_srcs;
-            for (auto& s : srcs) {
-                c_srcs.push_back(s.c_str());
+            if (!options.pool_sizes_path.empty() &&
+                !layout_planner.writePoolSizes(options.pool_sizes_path, manifest.instances)) {
+                std::cout << options.pool_sizes_path << " can not be written!" << std::endl;
+                ret = 1;
             }
-            p_shaders[i]->setStrings(c_srcs.data(), c_srcs.size());
-            p_shaders[i]->setEntryPoint(config.shaderEntrys[stages[i]].c_str());
-            ConfigureShader(p_shaders[i], sh_stage, config);
-
-            p_pc_shaders[i]->setStrings(c_srcs.data(), c_srcs.size());
-            p_pc_shaders[i]->setEntryPoint(config.shaderEntrys[stages[i]].c_str());
-            ConfigureShader(p_pc_shaders[i], sh_stage, config);
+            if (!options.padding_report_path.empty() &&
+                !layout_planner.writePaddingReport(options.padding_report_path, manifest.update_rates, std::cout)) {
+                std::cout << options.padding_report_path << " can not be written!" << std::endl;
+                ret = 1;
+            }
+            if (!options.push_constant_report_path.empty() &&
+                !layout_planner.writePushConstantReport(options.push_constant_report_path, manifest.update_rates, std::cout)) {
+                std::cout << options.push_constant_report_path << " can not be written!" << std::endl;
+                ret = 1;
+            }
+        }
+        else {
+            std::unique_ptr<Config> p_config;
+            {
+                TraceSpan span(context.p_tracer, "config", options.config_path);
+                p_config.reset(new Config(&options.config_path[0]));
+            }
+            // The main thread holds one slot, as a batch worker would.
+            JobSlots job_slots(options.jobs > 0 ? options.jobs : std::max(1u, std::thread::hardware_concurrency()));
+            job_slots.acquire();
+            context.p_job_slots = &job_slots;
+            ret = CompileProgram(*p_config, context) ? 0 : 1;
+            context.p_job_slots = nullptr;
         }
+		glslang::FinalizeProcess();
 
-		glslang::TProgram program;
+        if (p_archive) {
+            p_archive->commit();
+        }
 
-        for (auto p_shader : p_shaders) {
-            program.addShader(p_shader);
+        if (options.strip_spirv) {
+            spirv_stats.write(std::cout);
         }
 
-		bool result = InitializeProgram(program, config.getMessages());
-		assert(result);
-		
-        ShaderDescriptor shader_descriptor;
-        for (auto p_shader : p_pc_shaders) {
-            shader_descriptor.buildPushConstants(p_shader, config);
-            if (p_shader)
-                delete p_shader;
-        }
-        shader_descriptor.processProgram(program, config);
+        if (options.isBatch()) {
+            include_cache.writeStatistics(std::cout);
+        }
 
-        for (int i = 0; i < stage_count; ++i) {
-            std::vector<unsigned int> spirv;
-            glslang::GlslangToSpv(*program.getIntermediate(VKStageFlagToEShStage(stages[i])), spirv);
-            std::ofstream sr_file(config.getShaderBinFilename(stages[i]), std::ios::binary);
-            if (!sr_file.is_open()) {
-                std::cout
-                    << "Something is going wrong,"
-                    << "file can not be loaded!"
-                    << std::endl;
-                return 1;
-            }
-            sr_file.write((char*)spirv.data(), spirv.size() * sizeof(unsigned int));
-            sr_file.close();
+        if (p_cache) {
+            p_cache->trim();
+            p_cache->writeStatistics(std::cout);
         }
 
-		glslang::FinalizeProcess();
-        shader_descriptor.writeFile(config.getShaderDescriptorFilename());
+        if (p_tracer && !options.trace_path.empty() && !p_tracer->writeFile(options.trace_path)) {
+            std::cout << options.trace_path << " can not be written!" << std::endl;
+            ret = 1;
+        }
+        if (p_tracer && options.trace_summary > 0) {
+            p_tracer->writeSummary(std::cout, options.trace_summary);
+        }
 	}
-	catch(std::runtime_error& error) {
+	catch(std::exception& error) {
 		std::cout << error.what() << std::endl;
-		std::cout << "ShaderRetriever -i <filename> -s <vertex|fragment> -o <Output Filename> -v <true|false>" << std::endl;
+		std::cout << Options::usage() << std::endl;
+		ret = 1;
 	}
 
-    for (auto p_shader : p_shaders) {
-        if(p_shader)
-            delete p_shader;
-    }
-
-	return 0;
-}
\ No newline at end of file
+	return ret;
+}
@@ -0,0 +1,173 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <exception>
+#include <thread>
+#include <algorithm>
+#include <ShaderLang.h>
+#include "batch_compiler.h"
+#include "config.h"
+#include "tracer.h"
+
+namespace {
+// Rough cost of one program in flight: the per-thread glslang pools and
+// symbol tables plus the AST, which grows with the source size.
+const uint64_t kProgramBaseMemory = 16ull << 20;
+const uint64_t kMemoryPerSourceByte = 256;
+
+Config LoadConfig(const Manifest::Program& program, Tracer* p_tracer) {
+    TraceSpan span(p_tracer, "config", program.name);
+    return program.config.is_null() ?
+        Config(Config::LoadJSON(program.name)) :
+        Config(program.config);
+}
+}
+
+void MemoryBudget::acquire(uint64_t bytes) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_released.wait(lock, [&]() {
+        return m_in_use == 0 || m_in_use + bytes <= m_capacity;
+    });
+    m_in_use += bytes;
+}
+
+bool MemoryBudget::tryAcquire(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_in_use != 0 && m_in_use + bytes > m_capacity) {
+        return false;
+    }
+    m_in_use += bytes;
+    return true;
+}
+
+void MemoryBudget::release(uint64_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_in_use -= bytes;
+    }
+    m_released.notify_all();
+}
+
+void JobSlots::acquire() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_released.wait(lock, [&]() { return m_free > 0; });
+    --m_free;
+}
+
+bool JobSlots::tryAcquire() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_free == 0) {
+        return false;
+    }
+    --m_free;
+    return true;
+}
+
+void JobSlots::release() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_free;
+    }
+    m_released.notify_one();
+}
+
+uint64_t EstimateCompileMemory(const Config& config) {
+    uint64_t source_bytes = 0;
+    for (const auto& path : config.shaderFilepaths) {
+        std::ifstream file(path.second, std::ios::binary | std::ios::ate);
+        if (file.is_open()) {
+            source_bytes += static_cast<uint64_t>(file.tellg());
+        }
+    }
+    return kProgramBaseMemory + source_bytes * kMemoryPerSourceByte;
+}
+
+BatchCompiler::BatchCompiler(const Manifest& manifest, const Options& options, const CompileContext& context) :
+    m_manifest(manifest),
+    m_context(context),
+    m_results(manifest.getPrograms().size()) {
+    m_jobs = options.jobs > 0 ? options.jobs : manifest.jobs;
+    if (m_jobs == 0) {
+        m_jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    m_jobs = std::min<uint32_t>(m_jobs, std::max<size_t>(1, m_results.size()));
+
+    uint32_t max_memory_mb = options.max_memory_mb > 0 ? options.max_memory_mb : manifest.max_memory_mb;
+    m_max_memory = max_memory_mb > 0 ? (uint64_t)max_memory_mb << 20 : UINT64_MAX;
+}
+
+bool BatchCompiler::run() {
+    MemoryBudget budget(m_max_memory);
+    JobSlots job_slots(m_jobs);
+    m_context.p_memory_budget = &budget;
+    m_context.p_job_slots = &job_slots;
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < m_jobs; ++i) {
+        workers.emplace_back(&BatchCompiler::work, this);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    m_context.p_memory_budget = nullptr;
+    m_context.p_job_slots = nullptr;
+
+    uint32_t failed_count = 0;
+    for (const auto& result : m_results) {
+        if (!result.succeeded) {
+            ++failed_count;
+        }
+    }
+    std::cout
+        << m_results.size() << " programs compiled with " << m_jobs << " jobs, "
+        << failed_count << " failed." << std::endl;
+    for (const auto& result : m_results) {
+        if (!result.succeeded) {
+            std::cout << "  failed: " << result.name << std::endl;
+        }
+    }
+    return failed_count == 0;
+}
+
+void BatchCompiler::work() {
+    // Every worker owns its glslang thread context (pool allocator and
+    // symbol tables); the process-wide state is reference counted.
+    glslang::InitializeProcess();
+    const auto& programs = m_manifest.getPrograms();
+    for (size_t i = m_next_program++; i < programs.size(); i = m_next_program++) {
+        compile(programs[i], m_results[i]);
+
+        std::lock_guard<std::mutex> lock(m_report_mutex);
+        if (!m_results[i].succeeded) {
+            std::cout << "[" << programs[i].name << "]" << std::endl << m_results[i].log;
+        }
+    }
+    glslang::FinalizeProcess();
+}
+
+void BatchCompiler::compile(const Manifest::Program& program, Result& result) {
+    result.name = program.name;
+    std::ostringstream log;
+    try {
+        Config config = LoadConfig(program, m_context.p_tracer);
+
+        uint64_t memory = EstimateCompileMemory(config);
+        m_context.p_memory_budget->acquire(memory);
+        m_context.p_job_slots->acquire();
+        try {
+            result.succeeded = CompileProgram(config, m_context, log);
+        }
+        catch (...) {
+            m_context.p_job_slots->release();
+            m_context.p_memory_budget->release(memory);
+            throw;
+        }
+        m_context.p_job_slots->release();
+        m_context.p_memory_budget->release(memory);
+    }
+    catch (std::exception& error) {
+        log << error.what() << std::endl;
+        result.succeeded = false;
+    }
+    result.log = log.str();
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include "manifest.h"
+#include "options.h"
+#include "program_compiler.h"
+
+// Bounds the estimated memory of the programs compiling at the same time.
+// A request larger than the whole budget is still granted once nothing
+// else is in flight, so a single huge program can not stall the batch.
+class MemoryBudget {
+public:
+    MemoryBudget(uint64_t capacity) : m_capacity(capacity) {}
+
+    void acquire(uint64_t bytes);
+    // acquire() without waiting; false when the bytes do not fit now.
+    bool tryAcquire(uint64_t bytes);
+    void release(uint64_t bytes);
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_released;
+    uint64_t m_capacity;
+    uint64_t m_in_use = 0;
+};
+
+// The threads a run may compile on at once (-j). Every batch worker holds
+// one while it compiles a program; a program that builds several variants
+// (see CompilePermutations) builds on its own thread and takes idle slots
+// for helpers, so nesting never exceeds the limit.
+class JobSlots {
+public:
+    JobSlots(uint32_t count) : m_free(count) {}
+
+    void acquire();
+    // false when every slot is taken.
+    bool tryAcquire();
+    void release();
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_released;
+    uint32_t m_free;
+};
+
+// Rough memory of compiling config once, for MemoryBudget.
+uint64_t EstimateCompileMemory(const Config& config);
+
+class BatchCompiler {
+public:
+    struct Result {
+        std::string name;
+        bool succeeded = false;
+        std::string log;
+    };
+
+    BatchCompiler(const Manifest& manifest, const Options& options, const CompileContext& context);
+
+    // Compiles every program of the manifest; returns false if any failed.
+    bool run();
+
+    uint32_t getJobs() const { return m_jobs; }
+    const std::vector<Result>& getResults() const { return m_results; }
+
+private:
+    void work();
+    void compile(const Manifest::Program& program, Result& result);
+
+    const Manifest& m_manifest;
+    // A copy, pointing at the job slots and memory budget of run().
+    CompileContext m_context;
+    uint32_t m_jobs;
+    uint64_t m_max_memory;
+    std::atomic<size_t> m_next_program{ 0 };
+    std::vector<Result> m_results;
+    std::mutex m_report_mutex;
+};
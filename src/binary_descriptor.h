@@ -0,0 +1,277 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Binary .sd format, an alternative to the JSON descriptor that can be used
+// in place from a memory-mapped file. Every record is made of 32-bit words
+// in host byte order; names are byte offsets into a string table of
+// interned, null-terminated strings. Values missing from the JSON form
+// (e.g. a variable without a binding) are kSdAbsent.
+//
+//     SdHeader
+//     sections, each 4-byte aligned, located by SdHeader::sections
+//     string table
+
+const uint32_t kSdMagic = 0x44535253; // "SRSD"
+const uint32_t kSdVersion = 8;
+const uint32_t kSdAbsent = 0xFFFFFFFF;
+
+enum SdSectionIndex {
+    kSdAttributes,
+    kSdUniformBlocks,
+    kSdUniformVariables,
+    kSdPushConstants,
+    kSdBindings,
+    kSdDescriptorPool,
+    kSdSpvs,
+    kSdStorageBlocks,
+    kSdBlockMembers,
+    kSdPushConstantRanges,
+    kSdVertexBindings,
+    kSdVertexAttributes,
+    kSdStageCosts,
+    kSdStrings,
+    kSdSectionCount
+};
+
+struct SdSection {
+    uint32_t offset;
+    // Records, or bytes for the string table.
+    uint32_t count;
+};
+
+struct SdHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t file_size;
+    uint32_t attributes_count;
+    uint32_t uniform_blocks_count;
+    uint32_t uniform_variables_count;
+    uint32_t sets_count;
+    // All 0 unless the program is a compute program.
+    uint32_t local_size_x;
+    uint32_t local_size_y;
+    uint32_t local_size_z;
+    uint32_t shared_memory_bytes;
+    // The 16 bytes of "layout_hash" and "pipeline_hash" (see
+    // content_hash.h); all 0 when the modules were not hashed.
+    uint32_t layout_hash[4];
+    uint32_t pipeline_hash[4];
+    SdSection sections[kSdSectionCount];
+};
+
+struct SdQualifier {
+    uint32_t location;
+    uint32_t binding;
+    uint32_t set;
+};
+
+struct SdAttribute {
+    uint32_t name;
+    uint32_t basic_type;
+    uint32_t type;
+    uint32_t vector_size;
+    SdQualifier qualifier;
+};
+
+struct SdUniformBlock {
+    uint32_t name;
+    uint32_t basic_type;
+    uint32_t block_size;
+    uint32_t offset;
+    SdQualifier qualifier;
+    uint32_t padding_bytes;
+};
+
+struct SdUniformVariable {
+    uint32_t name;
+    uint32_t basic_type;
+    uint32_t offset;
+    // kSdAbsent unless the variable is a sampler.
+    uint32_t sampler_dim;
+    uint32_t sampler_type;
+    uint32_t sampler_combined;
+    SdQualifier qualifier;
+};
+
+struct SdPushConstant {
+    uint32_t name;
+    uint32_t basic_type;
+    uint32_t block_size;
+    uint32_t stage;
+    SdQualifier qualifier;
+};
+
+struct SdBinding {
+    uint32_t name;
+    uint32_t set;
+    uint32_t binding;
+    uint32_t type;
+    uint32_t count;
+};
+
+// One per VkDescriptorType, indexed by the type.
+struct SdDescriptorCount {
+    uint32_t count;
+};
+
+struct SdSpv {
+    uint32_t path;
+    uint32_t stage;
+    // The 16 bytes of its "spv_hashes" entry, or all 0.
+    uint32_t hash[4];
+};
+
+struct SdPushConstantRange {
+    uint32_t offset;
+    uint32_t size;
+    uint32_t stages;
+};
+
+// VkVertexInputBindingDescription, by binding.
+struct SdVertexBinding {
+    uint32_t binding;
+    uint32_t stride;
+    uint32_t input_rate;
+};
+
+// VkVertexInputAttributeDescription, by location.
+struct SdVertexAttribute {
+    uint32_t location;
+    uint32_t binding;
+    uint32_t format;
+    uint32_t offset;
+};
+
+// Static cost of a stage, see ReflectedStageCost.
+struct SdStageCost {
+    uint32_t stage;
+    uint32_t float_ops;
+    uint32_t integer_ops;
+    uint32_t transcendental_ops;
+    uint32_t conversion_ops;
+    uint32_t compare_ops;
+    uint32_t texture_samples;
+    uint32_t image_reads;
+    uint32_t branches;
+    uint32_t static_loops;
+    uint32_t dynamic_loops;
+    uint32_t registers;
+};
+
+// Members of all uniform blocks, those of a block next to each other in
+// offset order.
+struct SdBlockMember {
+    // Index of the block in the uniform blocks section.
+    uint32_t block;
+    uint32_t name;
+    uint32_t offset;
+    uint32_t size;
+    // 0 unless an array, or a matrix.
+    uint32_t array_stride;
+    uint32_t matrix_stride;
+};
+
+struct SdStorageBlock {
+    uint32_t name;
+    uint32_t basic_type;
+    uint32_t block_size;
+    SdQualifier qualifier;
+};
+
+// Read-only view of a binary descriptor. It never copies or allocates; the
+// buffer must stay alive and 4-byte aligned while the view is used.
+class SdView {
+public:
+    SdView(const void* data, size_t size) :
+        m_data(static_cast<const uint8_t*>(data)),
+        m_size(size) {
+
+    }
+
+    // Checks the header and that every section lies inside the buffer.
+    bool isValid() const {
+        if (m_size < sizeof(SdHeader) || reinterpret_cast<uintptr_t>(m_data) % 4 != 0) {
+            return false;
+        }
+        const auto& h = header();
+        if (h.magic != kSdMagic || h.version != kSdVersion || h.file_size > m_size) {
+            return false;
+        }
+        const size_t record_sizes[kSdSectionCount] = {
+            sizeof(SdAttribute), sizeof(SdUniformBlock), sizeof(SdUniformVariable), sizeof(SdPushConstant),
+            sizeof(SdBinding), sizeof(SdDescriptorCount), sizeof(SdSpv), sizeof(SdStorageBlock),
+            sizeof(SdBlockMember), sizeof(SdPushConstantRange), sizeof(SdVertexBinding), sizeof(SdVertexAttribute),
+            sizeof(SdStageCost), 1
+        };
+        for (int i = 0; i < kSdSectionCount; ++i) {
+            const auto& section = h.sections[i];
+            if (section.offset % 4 != 0 || section.offset > h.file_size ||
+                static_cast<uint64_t>(section.count) * record_sizes[i] > h.file_size - section.offset) {
+                return false;
+            }
+        }
+        const auto& strings = h.sections[kSdStrings];
+        return strings.count == 0 || m_data[strings.offset + strings.count - 1] == '\0';
+    }
+
+    const SdHeader& header() const { return *reinterpret_cast<const SdHeader*>(m_data); }
+
+    uint32_t attributeCount() const { return header().sections[kSdAttributes].count; }
+    const SdAttribute* attributes() const { return section<SdAttribute>(kSdAttributes); }
+    uint32_t uniformBlockCount() const { return header().sections[kSdUniformBlocks].count; }
+    const SdUniformBlock* uniformBlocks() const { return section<SdUniformBlock>(kSdUniformBlocks); }
+    uint32_t uniformVariableCount() const { return header().sections[kSdUniformVariables].count; }
+    const SdUniformVariable* uniformVariables() const { return section<SdUniformVariable>(kSdUniformVariables); }
+    uint32_t pushConstantCount() const { return header().sections[kSdPushConstants].count; }
+    const SdPushConstant* pushConstants() const { return section<SdPushConstant>(kSdPushConstants); }
+    uint32_t bindingCount() const { return header().sections[kSdBindings].count; }
+    const SdBinding* bindings() const { return section<SdBinding>(kSdBindings); }
+    uint32_t descriptorTypeCount() const { return header().sections[kSdDescriptorPool].count; }
+    const SdDescriptorCount* descriptorPool() const { return section<SdDescriptorCount>(kSdDescriptorPool); }
+    uint32_t spvCount() const { return header().sections[kSdSpvs].count; }
+    const SdSpv* spvs() const { return section<SdSpv>(kSdSpvs); }
+    uint32_t storageBlockCount() const { return header().sections[kSdStorageBlocks].count; }
+    const SdStorageBlock* storageBlocks() const { return section<SdStorageBlock>(kSdStorageBlocks); }
+    uint32_t blockMemberCount() const { return header().sections[kSdBlockMembers].count; }
+    const SdBlockMember* blockMembers() const { return section<SdBlockMember>(kSdBlockMembers); }
+    uint32_t pushConstantRangeCount() const { return header().sections[kSdPushConstantRanges].count; }
+    const SdPushConstantRange* pushConstantRanges() const { return section<SdPushConstantRange>(kSdPushConstantRanges); }
+    uint32_t vertexBindingCount() const { return header().sections[kSdVertexBindings].count; }
+    const SdVertexBinding* vertexBindings() const { return section<SdVertexBinding>(kSdVertexBindings); }
+    uint32_t vertexAttributeCount() const { return header().sections[kSdVertexAttributes].count; }
+    const SdVertexAttribute* vertexAttributes() const { return section<SdVertexAttribute>(kSdVertexAttributes); }
+    uint32_t stageCostCount() const { return header().sections[kSdStageCosts].count; }
+    const SdStageCost* stageCosts() const { return section<SdStageCost>(kSdStageCosts); }
+
+    // "" for an offset outside the strings section, which isValid() does
+    // not check the records for; every string inside it is terminated.
+    const char* string(uint32_t offset) const {
+        const auto& strings = header().sections[kSdStrings];
+        if (offset >= strings.count) {
+            return "";
+        }
+        return reinterpret_cast<const char*>(m_data + strings.offset + offset);
+    }
+
+    // Linear search over a section by name, e.g. find(bindings(), bindingCount(), "Scene").
+    template<typename T>
+    const T* find(const T* records, uint32_t count, const char* name) const {
+        for (uint32_t i = 0; i < count; ++i) {
+            if (std::strcmp(string(records[i].name), name) == 0) {
+                return records + i;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    template<typename T>
+    const T* section(SdSectionIndex index) const {
+        return reinterpret_cast<const T*>(m_data + header().sections[index].offset);
+    }
+
+    const uint8_t* m_data;
+    size_t m_size;
+};
@@ -0,0 +1,211 @@
+#include <map>
+#include <vector>
+#include <cstring>
+#include "binary_descriptor_writer.h"
+
+namespace {
+class StringTable {
+public:
+    // value may be any string; reflection strings are interned already, so
+    // equal ones share a pointer.
+    uint32_t intern(const char* value) {
+        auto found = m_offsets.find(value);
+        if (found != m_offsets.end()) {
+            return found->second;
+        }
+        uint32_t offset = static_cast<uint32_t>(m_data.size());
+        m_data.append(value, std::strlen(value) + 1);
+        m_offsets[value] = offset;
+        return offset;
+    }
+
+    const std::string& data() const { return m_data; }
+
+private:
+    std::map<const char*, uint32_t> m_offsets;
+    std::string m_data;
+};
+
+SdQualifier GetQualifier(const ReflectedQualifier& qualifier) {
+    return { qualifier.location, qualifier.binding, qualifier.set };
+}
+
+template<typename T>
+void AppendSection(std::string& out, SdSection& section, const std::vector<T>& records) {
+    out.resize((out.size() + 3) & ~size_t(3), '\0');
+    section.offset = static_cast<uint32_t>(out.size());
+    section.count = static_cast<uint32_t>(records.size());
+    out.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(T));
+}
+}
+
+std::string EncodeBinaryDescriptor(const ProgramReflection& reflection, const std::map<std::string, uint32_t>& spvs,
+    const ProgramHashes& hashes) {
+    StringTable strings;
+
+    std::vector<SdAttribute> attributes;
+    for (const auto& attribute : reflection.attributes) {
+        attributes.push_back({
+            strings.intern(attribute.name),
+            strings.intern(attribute.basic_type),
+            attribute.type,
+            attribute.vector_size,
+            GetQualifier(attribute.qualifier)
+        });
+    }
+
+    std::vector<SdUniformBlock> uniform_blocks;
+    std::vector<SdBlockMember> block_members;
+    for (const auto& block : reflection.uniform_blocks) {
+        for (const auto& member : block.members) {
+            block_members.push_back({
+                static_cast<uint32_t>(uniform_blocks.size()),
+                strings.intern(member.name),
+                member.offset,
+                member.size,
+                member.array_stride,
+                member.matrix_stride
+            });
+        }
+        uniform_blocks.push_back({
+            strings.intern(block.name),
+            strings.intern(block.basic_type),
+            block.block_size,
+            block.offset,
+            GetQualifier(block.qualifier),
+            block.padding_bytes
+        });
+    }
+
+    std::vector<SdUniformVariable> uniform_variables;
+    for (const auto& variable : reflection.uniform_variables) {
+        const auto& sampler = variable.sampler;
+        const bool has_sampler = variable.has_sampler;
+        uniform_variables.push_back({
+            strings.intern(variable.name),
+            strings.intern(variable.basic_type),
+            variable.offset,
+            has_sampler ? sampler.dim : kSdAbsent,
+            has_sampler ? sampler.type : kSdAbsent,
+            has_sampler ? uint32_t(sampler.combined) : kSdAbsent,
+            GetQualifier(variable.qualifier)
+        });
+    }
+
+    std::vector<SdPushConstant> push_constants;
+    for (const auto& push_constant : reflection.push_constants) {
+        push_constants.push_back({
+            strings.intern(push_constant.name),
+            strings.intern(push_constant.basic_type),
+            push_constant.block_size,
+            push_constant.stage,
+            GetQualifier(push_constant.qualifier)
+        });
+    }
+
+    std::vector<SdPushConstantRange> push_constant_ranges;
+    for (const auto& range : reflection.push_constant_ranges) {
+        push_constant_ranges.push_back({ range.offset, range.size, range.stages });
+    }
+
+    std::vector<SdVertexBinding> vertex_bindings;
+    for (const auto& binding : reflection.vertex_bindings) {
+        vertex_bindings.push_back({ binding.binding, binding.stride, binding.input_rate });
+    }
+
+    std::vector<SdVertexAttribute> vertex_attributes;
+    for (const auto& attribute : reflection.vertex_attributes) {
+        vertex_attributes.push_back({ attribute.location, attribute.binding, attribute.format, attribute.offset });
+    }
+
+    std::vector<SdStageCost> costs;
+    for (const auto& cost : reflection.costs) {
+        costs.push_back({
+            cost.stage,
+            cost.float_ops,
+            cost.integer_ops,
+            cost.transcendental_ops,
+            cost.conversion_ops,
+            cost.compare_ops,
+            cost.texture_samples,
+            cost.image_reads,
+            cost.branches,
+            cost.static_loops,
+            cost.dynamic_loops,
+            cost.registers
+        });
+    }
+
+    std::vector<SdBinding> bindings;
+    for (const auto& binding : reflection.bindings) {
+        bindings.push_back({
+            strings.intern(binding.name),
+            binding.set,
+            binding.binding,
+            binding.type,
+            binding.count
+        });
+    }
+
+    std::vector<SdDescriptorCount> descriptor_pool;
+    for (auto count : reflection.descriptor_pool) {
+        descriptor_pool.push_back({ count });
+    }
+
+    std::vector<SdStorageBlock> storage_blocks;
+    for (const auto& block : reflection.storage_blocks) {
+        storage_blocks.push_back({
+            strings.intern(block.name),
+            strings.intern(block.basic_type),
+            block.block_size,
+            GetQualifier(block.qualifier)
+        });
+    }
+
+    std::vector<SdSpv> sd_spvs;
+    for (const auto& spv : spvs) {
+        SdSpv sd_spv = { strings.intern(spv.first.c_str()), spv.second, {} };
+        const auto hash = hashes.spvs.find(spv.first);
+        if (hash != hashes.spvs.end()) {
+            std::memcpy(sd_spv.hash, hash->second.bytes.data(), sizeof(sd_spv.hash));
+        }
+        sd_spvs.push_back(sd_spv);
+    }
+
+    SdHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = kSdMagic;
+    header.version = kSdVersion;
+    header.attributes_count = reflection.attributes_count;
+    header.uniform_blocks_count = reflection.uniform_blocks_count;
+    header.uniform_variables_count = reflection.uniform_variables_count;
+    header.sets_count = reflection.sets_count;
+    header.local_size_x = reflection.compute.local_size_x;
+    header.local_size_y = reflection.compute.local_size_y;
+    header.local_size_z = reflection.compute.local_size_z;
+    header.shared_memory_bytes = reflection.compute.shared_memory_bytes;
+    if (!hashes.spvs.empty()) {
+        std::memcpy(header.layout_hash, hashes.layout.bytes.data(), sizeof(header.layout_hash));
+        std::memcpy(header.pipeline_hash, hashes.pipeline.bytes.data(), sizeof(header.pipeline_hash));
+    }
+
+    std::string out(sizeof(SdHeader), '\0');
+    AppendSection(out, header.sections[kSdAttributes], attributes);
+    AppendSection(out, header.sections[kSdUniformBlocks], uniform_blocks);
+    AppendSection(out, header.sections[kSdUniformVariables], uniform_variables);
+    AppendSection(out, header.sections[kSdPushConstants], push_constants);
+    AppendSection(out, header.sections[kSdBindings], bindings);
+    AppendSection(out, header.sections[kSdDescriptorPool], descriptor_pool);
+    AppendSection(out, header.sections[kSdSpvs], sd_spvs);
+    AppendSection(out, header.sections[kSdStorageBlocks], storage_blocks);
+    AppendSection(out, header.sections[kSdBlockMembers], block_members);
+    AppendSection(out, header.sections[kSdPushConstantRanges], push_constant_ranges);
+    AppendSection(out, header.sections[kSdVertexBindings], vertex_bindings);
+    AppendSection(out, header.sections[kSdVertexAttributes], vertex_attributes);
+    AppendSection(out, header.sections[kSdStageCosts], costs);
+    AppendSection(out, header.sections[kSdStrings], std::vector<char>(strings.data().begin(), strings.data().end()));
+    out.resize((out.size() + 3) & ~size_t(3), '\0');
+    header.file_size = static_cast<uint32_t>(out.size());
+    std::memcpy(&out[0], &header, sizeof(header));
+    return out;
+}
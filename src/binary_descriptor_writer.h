@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+#include <map>
+#include <cstdint>
+#include "binary_descriptor.h"
+#include "reflection.h"
+#include "content_hash.h"
+
+// Encodes a reflection and its .sr files (what ShaderDescriptor::writeFile
+// writes) in the binary .sd format read by SdView.
+std::string EncodeBinaryDescriptor(const ProgramReflection& reflection, const std::map<std::string, uint32_t>& spvs,
+    const ProgramHashes& hashes);
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include "block_layout.h"
+
+namespace {
+const uint32_t kNoOffset = 0xFFFFFFFF;
+// std140 rounds the alignment of arrays, structs and matrix columns up to
+// the one of a vec4.
+const uint32_t kVec4Alignment = 16;
+
+struct Extent {
+    uint32_t size = 0;
+    uint32_t alignment = 1;
+    // Bytes that hold values.
+    uint32_t data = 0;
+    uint32_t array_stride = 0;
+    uint32_t matrix_stride = 0;
+};
+
+uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+class Layouter {
+public:
+    Layouter(LayoutPacking packing) : m_packing(packing) {}
+
+    Extent measure(const LayoutType& type) const {
+        Extent extent = measureElement(type);
+        if (type.array_sizes.empty()) {
+            return extent;
+        }
+        const uint32_t alignment = roundAlignment(extent.alignment);
+        uint32_t stride = AlignUp(extent.size, alignment);
+        for (auto it = type.array_sizes.rbegin(); it != type.array_sizes.rend(); ++it) {
+            extent.array_stride = stride;
+            stride *= *it;
+            extent.data *= *it;
+        }
+        extent.size = stride;
+        extent.alignment = alignment;
+        return extent;
+    }
+
+    // Lays out members from offset, adding every one (nested ones too) to
+    // p_layouts when not null; returns the end of the last member.
+    uint32_t place(const std::vector<LayoutType::Member>& members, uint32_t offset, const std::string& prefix,
+        std::vector<MemberLayout>* p_layouts, uint32_t* p_data = nullptr) const {
+        for (const auto& member : members) {
+            const Extent extent = measure(member.type);
+            offset = member.explicit_offset != kNoOffset ?
+                member.explicit_offset : AlignUp(offset, alignment(member, extent));
+            if (p_layouts != nullptr) {
+                p_layouts->push_back({ prefix + member.name, offset, extent.size, extent.array_stride, extent.matrix_stride });
+                if (member.type.kind == LayoutType::kStruct) {
+                    place(member.type.members, offset, prefix + member.name + ".", p_layouts);
+                }
+            }
+            if (p_data != nullptr) {
+                *p_data += extent.data;
+            }
+            offset += extent.size;
+        }
+        return offset;
+    }
+
+    uint32_t alignment(const LayoutType::Member& member, const Extent& extent) const {
+        return std::max(extent.alignment, member.align);
+    }
+
+private:
+    uint32_t roundAlignment(uint32_t alignment) const {
+        return m_packing == kPackingStd140 ? std::max(alignment, kVec4Alignment) : alignment;
+    }
+
+    Extent vector(uint32_t component_bytes, uint32_t size) const {
+        Extent extent;
+        extent.size = component_bytes * size;
+        // Scalar packing aligns a vector to its components.
+        extent.alignment = m_packing == kPackingScalar ?
+            component_bytes : component_bytes * (size == 1 ? 1 : size == 2 ? 2 : 4);
+        extent.data = extent.size;
+        return extent;
+    }
+
+    Extent measureElement(const LayoutType& type) const {
+        switch (type.kind) {
+        case LayoutType::kScalar:
+            return vector(type.component_bytes, 1);
+        case LayoutType::kVector:
+            return vector(type.component_bytes, type.vector_size);
+        case LayoutType::kMatrix: {
+            // An array of columns, or of rows when row-major.
+            const Extent column = vector(type.component_bytes, type.row_major ? type.columns : type.vector_size);
+            const uint32_t count = type.row_major ? type.vector_size : type.columns;
+            Extent extent;
+            extent.alignment = roundAlignment(column.alignment);
+            extent.matrix_stride = AlignUp(column.size, extent.alignment);
+            extent.size = extent.matrix_stride * count;
+            extent.data = column.data * count;
+            return extent;
+        }
+        case LayoutType::kStruct:
+        default: {
+            Extent extent;
+            for (const auto& member : type.members) {
+                extent.alignment = std::max(extent.alignment, alignment(member, measure(member.type)));
+            }
+            extent.alignment = roundAlignment(extent.alignment);
+            extent.size = place(type.members, 0, std::string(), nullptr, &extent.data);
+            // Scalar packing does not pad a struct to its alignment.
+            if (m_packing != kPackingScalar) {
+                extent.size = AlignUp(extent.size, extent.alignment);
+            }
+            return extent;
+        }
+        }
+    }
+
+    LayoutPacking m_packing;
+};
+
+// Largest alignment first, but a member that fits the gap the previous
+// one left (a float after a vec3) goes there instead.
+std::vector<LayoutType::Member> Reorder(const std::vector<LayoutType::Member>& members, const Layouter& layouter) {
+    std::vector<std::pair<Extent, const LayoutType::Member*>> remaining;
+    for (const auto& member : members) {
+        Extent extent = layouter.measure(member.type);
+        extent.alignment = layouter.alignment(member, extent);
+        remaining.emplace_back(extent, &member);
+    }
+    std::stable_sort(remaining.begin(), remaining.end(), [](const std::pair<Extent, const LayoutType::Member*>& a,
+        const std::pair<Extent, const LayoutType::Member*>& b) {
+        return a.first.alignment > b.first.alignment ||
+            (a.first.alignment == b.first.alignment && a.first.size > b.first.size);
+    });
+
+    std::vector<LayoutType::Member> ordered;
+    uint32_t offset = 0;
+    while (!remaining.empty()) {
+        auto next = std::find_if(remaining.begin(), remaining.end(),
+            [&](const std::pair<Extent, const LayoutType::Member*>& candidate) {
+            return AlignUp(offset, candidate.first.alignment) == offset;
+        });
+        if (next == remaining.end()) {
+            next = remaining.begin();
+        }
+        offset = AlignUp(offset, next->first.alignment) + next->first.size;
+        ordered.push_back(*next->second);
+        remaining.erase(next);
+    }
+    return ordered;
+}
+}
+
+BlockLayout LayOutBlock(const std::vector<LayoutType::Member>& members, LayoutPacking packing) {
+    const Layouter layouter(packing);
+    BlockLayout layout;
+    uint32_t data = 0;
+    layout.size = layouter.place(members, 0, std::string(), &layout.members, &data);
+    layout.padding_bytes = layout.size - data;
+
+    const bool explicit_offsets = std::any_of(members.begin(), members.end(), [](const LayoutType::Member& member) {
+        return member.explicit_offset != kNoOffset;
+    });
+    if (!explicit_offsets) {
+        // A runtime-sized array has to stay last.
+        const bool runtime_array = !members.empty() && !members.back().type.array_sizes.empty() &&
+            members.back().type.array_sizes.front() == 0;
+        auto ordered = Reorder(runtime_array ?
+            std::vector<LayoutType::Member>(members.begin(), members.end() - 1) : members, layouter);
+        if (runtime_array) {
+            ordered.push_back(members.back());
+        }
+        const uint32_t size = layouter.place(ordered, 0, std::string(), nullptr);
+        if (size < layout.size) {
+            for (const auto& member : ordered) {
+                layout.suggested_order.push_back(member.name);
+            }
+            layout.suggested_size = size;
+        }
+    }
+    return layout;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Lays out the members of a uniform or storage block the way std140, std430
+// or scalar packing does, independent of glslang: offsets, sizes and strides
+// of every member, the bytes lost to padding and a member order that wastes
+// less. The caller checks the result against the offsets glslang assigned.
+
+enum LayoutPacking {
+    kPackingStd140,
+    kPackingStd430,
+    kPackingScalar
+};
+
+struct LayoutType {
+    enum Kind {
+        kScalar,
+        kVector,
+        kMatrix,
+        kStruct
+    };
+
+    struct Member;
+
+    Kind kind = kScalar;
+    uint32_t component_bytes = 4;
+    // Components of a vector, rows of a matrix.
+    uint32_t vector_size = 1;
+    uint32_t columns = 1;
+    bool row_major = false;
+    // Outermost first.
+    std::vector<uint32_t> array_sizes;
+    std::vector<Member> members;
+};
+
+struct LayoutType::Member {
+    std::string name;
+    LayoutType type;
+    // Set by layout(offset = N); 0xFFFFFFFF when the layout picks it.
+    uint32_t explicit_offset = 0xFFFFFFFF;
+    // Set by layout(align = N) on the member or its block; 0 when not.
+    // Moves only the start of the member, not the stride of an array.
+    uint32_t align = 0;
+};
+
+struct MemberLayout {
+    // Members of nested structs are "outer.inner", laid out in the first
+    // element when the outer member is an array.
+    std::string name;
+    uint32_t offset = 0;
+    uint32_t size = 0;
+    // Between elements of the outermost array; 0 unless an array.
+    uint32_t array_stride = 0;
+    // Between columns (rows when row-major); 0 unless a matrix.
+    uint32_t matrix_stride = 0;
+};
+
+struct BlockLayout {
+    std::vector<MemberLayout> members;
+    uint32_t size = 0;
+    // size less the bytes that hold values.
+    uint32_t padding_bytes = 0;
+    // The top-level members in an order giving a smaller block; empty when
+    // the declared order is as small, or offsets are explicit.
+    std::vector<std::string> suggested_order;
+    uint32_t suggested_size = 0;
+};
+
+BlockLayout LayOutBlock(const std::vector<LayoutType::Member>& members, LayoutPacking packing);
@@ -0,0 +1,265 @@
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <cstdio>
+#include "compile_cache.h"
+#include "config.h"
+#include "spv_program.h"
+#include "sha256.h"
+#include "include_cache.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+// Bump whenever the entry layout or anything that shapes the reflection
+// changes, so stale entries are never reused.
+const uint32_t kCacheFormatVersion = 8;
+const char kEntryMagic[4] = { 'S', 'R', 'C', 'E' };
+const char* kEntryExtension = ".entry";
+const char* kTrimLockName = "trim.lock";
+// A trim lock older than this was left behind by a crashed process.
+const auto kStaleLockAge = std::chrono::minutes(10);
+
+void WriteU32(std::ostream& out, uint32_t value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool ReadU32(std::istream& in, uint32_t& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+void HashString(Sha256& hash, const std::string& value) {
+    hash.updateValue(static_cast<uint64_t>(value.size()));
+    hash.update(value);
+}
+}
+
+CompileCache::CompileCache(const std::string& directory, uint64_t max_bytes) :
+    m_directory(directory),
+    m_max_bytes(max_bytes) {
+    std::error_code error;
+    fs::create_directories(m_directory, error);
+    if (error) {
+        throw std::runtime_error("cache directory " + m_directory + " can not be created.");
+    }
+}
+
+std::string CompileCache::computeKey(Config& config, const std::vector<std::vector<ShaderSource>>& sources,
+    const std::set<std::string>& dependencies, const CompileContext& context) const {
+    Sha256 hash;
+    hash.updateValue(kCacheFormatVersion);
+    hash.updateValue(static_cast<uint32_t>(config.getMessages()));
+    hash.updateValue(static_cast<uint32_t>(config.getSource()));
+    hash.updateValue(kDefaultShaderVersion);
+    hash.updateValue(kInputSemanticsVersion);
+    hash.updateValue(kVulkanClientVersion);
+    hash.updateValue(kSpvTargetVersion);
+    hash.updateValue(DefaultTBuiltInResource);
+    hash.updateValue(context.p_spirv_stats != nullptr);
+    // The vertex input is built along with the reflection.
+    const auto& vertex_input = config.getVertexInput();
+    hash.updateValue(vertex_input.compact);
+    hash.updateValue(static_cast<uint64_t>(vertex_input.instanced.size()));
+    for (const auto& name : vertex_input.instanced) {
+        HashString(hash, name);
+    }
+    hash.updateValue(static_cast<uint64_t>(vertex_input.formats.size()));
+    for (const auto& format : vertex_input.formats) {
+        HashString(hash, format.first);
+        HashString(hash, format.second);
+    }
+
+    const auto& stages = config.getStages();
+    for (size_t i = 0; i < stages.size(); ++i) {
+        hash.updateValue(static_cast<uint32_t>(stages[i]));
+        HashString(hash, config.shaderEntrys[stages[i]]);
+        HashString(hash, config.shaderPreambles[stages[i]]);
+        hash.updateValue(static_cast<uint64_t>(sources[i].size()));
+        for (const auto& source : sources[i]) {
+            hash.updateValue(static_cast<uint64_t>(source.size));
+            hash.update(source.data, source.size);
+        }
+    }
+    // Included files by content alone, so checkouts at other paths share
+    // entries.
+    IncludeCache own_cache;
+    auto& include_cache = context.p_include_cache != nullptr ? *context.p_include_cache : own_cache;
+    hash.updateValue(static_cast<uint64_t>(dependencies.size()));
+    for (const auto& path : dependencies) {
+        const auto p_file = include_cache.get(path);
+        hash.updateValue(static_cast<uint64_t>(p_file != nullptr ? p_file->size() : 0));
+        if (p_file != nullptr) {
+            hash.update(p_file->data(), p_file->size());
+        }
+    }
+    return Sha256::toHex(hash.finish());
+}
+
+bool CompileCache::load(const std::string& key, Entry& entry) {
+    const auto path = getEntryPath(key);
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    bool valid = file.is_open();
+    // Sizes read from the entry are checked against what is left of the
+    // file before anything is allocated for them.
+    uint64_t file_size = 0;
+    if (valid) {
+        file_size = static_cast<uint64_t>(file.tellg());
+        file.seekg(0);
+    }
+    auto fits = [&](uint64_t size) {
+        const auto position = file.tellg();
+        return position >= 0 && size <= file_size - static_cast<uint64_t>(position);
+    };
+
+    char magic[sizeof(kEntryMagic)];
+    uint32_t stage_count = 0;
+    valid = valid && file.read(magic, sizeof(magic)) && std::equal(magic, magic + sizeof(magic), kEntryMagic);
+    valid = valid && ReadU32(file, stage_count);
+    for (uint32_t i = 0; valid && i < stage_count; ++i) {
+        uint32_t stage = 0;
+        uint32_t word_count = 0;
+        valid = ReadU32(file, stage) && ReadU32(file, word_count) &&
+            fits(static_cast<uint64_t>(word_count) * sizeof(unsigned int));
+        if (valid) {
+            auto& spirv = entry.spirv[static_cast<VkShaderStageFlagBits>(stage)];
+            spirv.resize(word_count);
+            valid = static_cast<bool>(file.read(reinterpret_cast<char*>(spirv.data()), word_count * sizeof(unsigned int)));
+        }
+    }
+    uint32_t reflection_size = 0;
+    valid = valid && ReadU32(file, reflection_size) && fits(reflection_size);
+    if (valid) {
+        std::string reflection(reflection_size, '\0');
+        valid = static_cast<bool>(file.read(&reflection[0], reflection_size));
+        if (valid) {
+            // A truncated entry (an evicting or crashed writer) is a miss.
+            try {
+                entry.reflection = ParseReflection(nlohmann::json::parse(reflection));
+            }
+            catch (std::exception&) {
+                valid = false;
+            }
+        }
+    }
+    file.close();
+
+    if (!valid) {
+        entry = Entry();
+        ++m_misses;
+        return false;
+    }
+
+    // Touching the entry is what keeps it recently used for trim().
+    std::error_code error;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+    ++m_hits;
+    return true;
+}
+
+void CompileCache::store(const std::string& key, const Entry& entry) {
+    const auto path = getEntryPath(key);
+    std::error_code error;
+    fs::create_directories(fs::path(path).parent_path(), error);
+
+    std::ostringstream temp_name;
+    temp_name << path << ".tmp." << std::hash<std::thread::id>()(std::this_thread::get_id())
+        << "." << m_temp_counter++;
+    const auto temp_path = temp_name.str();
+    {
+        std::ofstream file(temp_path, std::ios::binary);
+        if (!file.is_open()) {
+            return;
+        }
+        file.write(kEntryMagic, sizeof(kEntryMagic));
+        WriteU32(file, static_cast<uint32_t>(entry.spirv.size()));
+        for (const auto& spirv : entry.spirv) {
+            WriteU32(file, static_cast<uint32_t>(spirv.first));
+            WriteU32(file, static_cast<uint32_t>(spirv.second.size()));
+            file.write(reinterpret_cast<const char*>(spirv.second.data()), spirv.second.size() * sizeof(unsigned int));
+        }
+        const auto reflection = SerializeReflection(entry.reflection);
+        WriteU32(file, static_cast<uint32_t>(reflection.size()));
+        file.write(reflection.data(), reflection.size());
+        if (!file.good()) {
+            file.close();
+            fs::remove(temp_path, error);
+            return;
+        }
+    }
+
+    // Readers only ever see complete entries. When another process won the
+    // race the entries are identical, so losing it is harmless.
+    fs::rename(temp_path, path, error);
+    if (error) {
+        fs::remove(temp_path, error);
+        return;
+    }
+    ++m_stores;
+}
+
+void CompileCache::trim() {
+    const auto lock_path = (fs::path(m_directory) / kTrimLockName).string();
+    std::error_code error;
+    auto lock_time = fs::last_write_time(lock_path, error);
+    if (!error && fs::file_time_type::clock::now() - lock_time > kStaleLockAge) {
+        fs::remove(lock_path, error);
+    }
+    FILE* p_lock = std::fopen(lock_path.c_str(), "wx");
+    if (p_lock == nullptr) {
+        return;
+    }
+    std::fclose(p_lock);
+
+    struct EntryFile {
+        fs::path path;
+        fs::file_time_type time;
+        uint64_t size;
+    };
+    std::vector<EntryFile> entries;
+    uint64_t total_size = 0;
+    for (fs::recursive_directory_iterator it(m_directory, error), end; !error && it != end; it.increment(error)) {
+        if (!it->is_regular_file(error) || it->path().extension() != kEntryExtension) {
+            continue;
+        }
+        EntryFile entry_file = { it->path(), it->last_write_time(error), it->file_size(error) };
+        if (!error) {
+            total_size += entry_file.size;
+            entries.push_back(entry_file);
+        }
+        error.clear();
+    }
+
+    if (total_size > m_max_bytes) {
+        std::sort(entries.begin(), entries.end(), [](const EntryFile& a, const EntryFile& b) {
+            return a.time < b.time;
+        });
+        // Trim below the limit so the next few stores do not trigger it again.
+        const uint64_t target = m_max_bytes - m_max_bytes / 10;
+        for (const auto& entry_file : entries) {
+            if (total_size <= target) {
+                break;
+            }
+            if (fs::remove(entry_file.path, error)) {
+                total_size -= entry_file.size;
+                ++m_evictions;
+            }
+        }
+    }
+    fs::remove(lock_path, error);
+}
+
+void CompileCache::writeStatistics(std::ostream& out) const {
+    out << "cache: "
+        << m_hits << " hits, "
+        << m_misses << " misses, "
+        << m_stores << " stores, "
+        << m_evictions << " evictions" << std::endl;
+}
+
+std::string CompileCache::getEntryPath(const std::string& key) const {
+    return (fs::path(m_directory) / key.substr(0, 2) / (key + kEntryExtension)).string();
+}
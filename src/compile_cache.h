@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <set>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <json.hpp>
+#include <vulkan/vulkan.h>
+#include "program_compiler.h"
+
+class Config;
+
+// Content-addressed on-disk cache of compiled programs. An entry holds the
+// SPIR-V of every stage and the reflection ShaderDescriptor produced, keyed
+// by everything that feeds glslang. Entries are published with an atomic
+// rename so several processes can share one directory; the least recently
+// used entries are evicted once the directory grows past its size limit.
+class CompileCache {
+public:
+    using Entry = CompiledProgram;
+
+    CompileCache(const std::string& directory, uint64_t max_bytes);
+
+    // sources holds the loaded source strings of every stage, in the order
+    // of config.getStages(), and dependencies what ScanProgramDependencies
+    // found for them; the options of context that change the output are
+    // part of the key too.
+    std::string computeKey(Config& config, const std::vector<std::vector<ShaderSource>>& sources,
+        const std::set<std::string>& dependencies, const CompileContext& context) const;
+
+    bool load(const std::string& key, Entry& entry);
+    void store(const std::string& key, const Entry& entry);
+
+    // Evicts least recently used entries until the cache fits its limit.
+    // Only one process trims at a time; the others skip.
+    void trim();
+
+    void writeStatistics(std::ostream& out) const;
+
+private:
+    std::string getEntryPath(const std::string& key) const;
+
+    std::string m_directory;
+    uint64_t m_max_bytes;
+    std::atomic<uint64_t> m_hits{ 0 };
+    std::atomic<uint64_t> m_misses{ 0 };
+    std::atomic<uint64_t> m_stores{ 0 };
+    std::atomic<uint64_t> m_evictions{ 0 };
+    std::atomic<uint64_t> m_temp_counter{ 0 };
+};
@@ -0,0 +1,168 @@
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <ShaderLang.h>
+#include "compile_server.h"
+#include "config.h"
+#include "shader_descriptor.h"
+#include "compile_cache.h"
+#include "include_cache.h"
+
+namespace {
+// main trims the cache when the process exits; a server, which may run
+// for days, trims it after this many requests as well.
+const uint64_t kTrimInterval = 256;
+}
+
+CompileServer::CompileServer(const std::string& socket_path, uint32_t jobs, const CompileContext& context) :
+    m_socket_path(socket_path),
+    m_jobs(jobs > 0 ? jobs : std::max(1u, std::thread::hardware_concurrency())),
+    m_context(context) {
+
+}
+
+void CompileServer::run() {
+    m_listener = LocalSocket::listen(m_socket_path);
+    std::cout << "listening on " << m_socket_path << " with " << m_jobs << " jobs." << std::endl;
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < m_jobs; ++i) {
+        workers.emplace_back(&CompileServer::work, this);
+    }
+
+    while (!m_stopping) {
+        auto p_connection = std::make_shared<Connection>();
+        p_connection->socket = m_listener.accept();
+        if (!p_connection->socket.isValid()) {
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_connections_mutex);
+            m_connections.push_back(p_connection);
+            ++m_reader_count;
+        }
+        std::thread(&CompileServer::serve, this, p_connection).detach();
+    }
+    stop();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    std::unique_lock<std::mutex> lock(m_connections_mutex);
+    m_connections_changed.wait(lock, [&]() { return m_reader_count == 0; });
+    m_listener.close();
+    std::remove(m_socket_path.c_str());
+}
+
+void CompileServer::serve(std::shared_ptr<Connection> p_connection) {
+    Frame frame;
+    while (!m_stopping && ReadFrame(p_connection->socket, frame)) {
+        if (frame.header.count("command") > 0 && frame.header["command"] == "shutdown") {
+            stop();
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            m_queue.push_back({ p_connection, std::move(frame) });
+        }
+        m_queue_changed.notify_one();
+    }
+
+    std::lock_guard<std::mutex> lock(m_connections_mutex);
+    m_connections.erase(std::remove_if(m_connections.begin(), m_connections.end(),
+        [](const std::weak_ptr<Connection>& p) { return p.expired(); }), m_connections.end());
+    --m_reader_count;
+    m_connections_changed.notify_all();
+}
+
+void CompileServer::work() {
+    glslang::InitializeProcess();
+    while (true) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(m_queue_mutex);
+            m_queue_changed.wait(lock, [&]() { return m_stopping || !m_queue.empty(); });
+            if (m_stopping) {
+                break;
+            }
+            request = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        auto response = compile(request.frame.header);
+        {
+            std::lock_guard<std::mutex> lock(request.p_connection->write_mutex);
+            WriteFrame(request.p_connection->socket, response);
+        }
+        // As watch mode does between rounds: mapped sources would otherwise
+        // stay mapped, and locked on Windows, for the server's lifetime.
+        if (m_context.p_include_cache != nullptr) {
+            m_context.p_include_cache->clear();
+        }
+        if (m_context.p_cache != nullptr && ++m_compiled % kTrimInterval == 0) {
+            m_context.p_cache->trim();
+        }
+    }
+    glslang::FinalizeProcess();
+}
+
+Frame CompileServer::compile(const nlohmann::json& request) {
+    Frame response;
+    response.header["id"] = request.count("id") > 0 ? request["id"] : nlohmann::json();
+    std::ostringstream log;
+    bool succeeded = false;
+    try {
+        if (request.count("config") == 0) {
+            throw std::runtime_error("config must exists.");
+        }
+        Config config(request["config"]);
+        CompiledProgram compiled;
+        succeeded = BuildProgram(config, m_context, compiled, log);
+        if (succeeded) {
+            nlohmann::json binaries = nlohmann::json::array();
+            for (auto stage : config.getStages()) {
+                const auto& spirv = compiled.spirv.at(stage);
+                nlohmann::json binary;
+                binary["path"] = config.getShaderBinFilename(stage);
+                binary["stage"] = stage;
+                binary["offset"] = response.payload.size();
+                binary["size"] = spirv.size() * sizeof(unsigned int);
+                binaries.push_back(binary);
+                response.payload.append(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(unsigned int));
+            }
+            ShaderDescriptor shader_descriptor;
+            shader_descriptor.loadReflection(compiled.reflection, config);
+            shader_descriptor.hashModules(compiled.spirv);
+            response.header["binaries"] = binaries;
+            response.header["descriptor_path"] = config.getShaderDescriptorFilename();
+            // The header is a JSON document itself, so the .sd is embedded as one.
+            response.header["descriptor"] = nlohmann::json::parse(shader_descriptor.toJSON(true));
+        }
+    }
+    catch (std::exception& error) {
+        log << error.what() << std::endl;
+        succeeded = false;
+    }
+    response.header["succeeded"] = succeeded;
+    response.header["log"] = log.str();
+    return response;
+}
+
+void CompileServer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_queue_mutex);
+        m_stopping = true;
+    }
+    m_queue_changed.notify_all();
+    m_listener.shutdown();
+
+    std::lock_guard<std::mutex> lock(m_connections_mutex);
+    for (auto& p_weak : m_connections) {
+        if (auto p_connection = p_weak.lock()) {
+            p_connection->socket.shutdown();
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include "local_socket.h"
+#include "server_protocol.h"
+#include "program_compiler.h"
+
+// Long-running compile server. Workers keep their glslang thread contexts
+// (and glslang's builtin symbol tables) warm between requests; every client
+// connection may pipeline any number of requests, which are compiled
+// concurrently and answered as they finish.
+class CompileServer {
+public:
+    CompileServer(const std::string& socket_path, uint32_t jobs, const CompileContext& context);
+
+    // Serves until a client sends the shutdown command.
+    void run();
+
+private:
+    struct Connection {
+        LocalSocket socket;
+        std::mutex write_mutex;
+    };
+
+    struct Request {
+        std::shared_ptr<Connection> p_connection;
+        Frame frame;
+    };
+
+    void serve(std::shared_ptr<Connection> p_connection);
+    void work();
+    Frame compile(const nlohmann::json& request);
+    void stop();
+
+    std::string m_socket_path;
+    uint32_t m_jobs;
+    const CompileContext& m_context;
+    LocalSocket m_listener;
+    std::atomic<bool> m_stopping{ false };
+    // Requests compiled, to trim the cache every kTrimInterval of them.
+    std::atomic<uint64_t> m_compiled{ 0 };
+
+    // Open connections, so stop() can wake up their readers.
+    std::mutex m_connections_mutex;
+    std::condition_variable m_connections_changed;
+    std::vector<std::weak_ptr<Connection>> m_connections;
+    uint32_t m_reader_count = 0;
+
+    std::mutex m_queue_mutex;
+    std::condition_variable m_queue_changed;
+    std::deque<Request> m_queue;
+};
@@ -4,12 +4,16 @@
 #include <fstream>
 #include <vector>
 #include <exception>
+#include <stdexcept>
 #include <map>
 #include <cassert>
+#include <algorithm>
 #include <ShaderLang.h>
 #include <ResourceLimits.h>
 #include <json.hpp>
 #include <vulkan/vulkan.h>
+#include "vertex_input.h"
+#include "spirv_cost.h"
 
 extern const TBuiltInResource DefaultTBuiltInResource;
 
@@ -24,16 +28,12 @@ public:
 
 	Config() = delete;
 
-	Config(char* argv) {
-        using JSON = nlohmann::json;
-        std::string filepath(argv);
-        std::ifstream config_file(filepath);
-        if (!config_file.is_open()) {
-            throw std::exception("file open failed.");
-        }
-        JSON json;
-        config_file >> json;
+	Config(char* argv) : Config(LoadJSON(argv)) {
 
+	}
+
+	Config(const nlohmann::json& json) {
+        using JSON = nlohmann::json;
         if (json.count("sources") == 0) {
             throw std::exception("shader must exists.");
         }
@@ -48,16 +48,33 @@ public:
                 stage = VK_SHADER_STAGE_VERTEX_BIT;
                 m_stages.push_back(stage);
             }
+            else if (obj.first == "compute") {
+                stage = VK_SHADER_STAGE_COMPUTE_BIT;
+                m_stages.push_back(stage);
+            }
             else {
-                assert(false);
+                throw std::runtime_error("sources must be vertex, fragment or compute.");
+            }
+            // An inline "source" (sent to the compile server) takes the
+            // place of reading "path", which then only names the stage.
+            if (obj.second.count("source") > 0) {
+                shaderSources[stage] = obj.second["source"].get<std::string>();
+            }
+            else if (obj.second.count("path") == 0) {
+                throw std::runtime_error("shader path must exists.");
+            }
+            if (obj.second.count("path") > 0) {
+                shaderFilepaths[stage] = obj.second["path"].get<std::string>();
             }
-            shaderFilepaths[stage] = obj.second["path"].get<std::string>();
             if (obj.second.count("entry") == 0) {
                 shaderEntrys[stage] = "main";
             }
             else {
                 shaderEntrys[stage] = obj.second["entry"].get<std::string>();
             }
+            if (obj.second.count("defines") > 0) {
+                addDefines(stage, obj.second["defines"]);
+            }
         }
         
         if (json.count("vulkan_define") > 0) {
@@ -77,6 +94,13 @@ public:
             spv_path = "output.spv";
         }
 
+        if (json.count("name") > 0) {
+            m_name = json["name"].get<std::string>();
+        }
+        else {
+            m_name = spv_path;
+        }
+
         if (json.count("descriptor") > 0) {
             sd_path = json["descriptor"].get<std::string>();
         }
@@ -84,6 +108,50 @@ public:
             sd_path = "output.sd";
         }
 
+        // Make/Ninja depfile of the .sd, written with --depfiles.
+        if (json.count("depfile") > 0) {
+            m_depfile_path = json["depfile"].get<std::string>();
+        }
+        else {
+            m_depfile_path = sd_path + ".d";
+        }
+
+        // C++ header embedding the program, written with --cpp-headers.
+        if (json.count("header") > 0) {
+            m_header_path = json["header"].get<std::string>();
+        }
+        else {
+            m_header_path = sd_path + ".h";
+        }
+
+        // Where #include <name>, and an #include "name" not found next to
+        // its includer, is looked for.
+        if (json.count("include_paths") > 0) {
+            for (const auto& path : json["include_paths"]) {
+                m_include_paths.push_back(path.get<std::string>());
+            }
+        }
+
+        if (json.count("descriptor_format") > 0) {
+            setDescriptorFormat(json["descriptor_format"].get<std::string>());
+        }
+
+        if (json.count("max_shared_memory") > 0) {
+            m_max_shared_memory = json["max_shared_memory"].get<uint32_t>();
+        }
+
+        if (json.count("vertex_input") > 0) {
+            setVertexInput(json["vertex_input"]);
+        }
+
+        if (json.count("cost_budget") > 0) {
+            setCostBudget(json["cost_budget"]);
+        }
+
+        if (isCompute() && m_stages.size() > 1) {
+            throw std::runtime_error("a compute shader can not share a program with other stages.");
+        }
+
         switch (m_language_def)
         {
         case VULKAN:
@@ -102,6 +170,83 @@ public:
 
 	};
 
+    static nlohmann::json LoadJSON(const std::string& filepath) {
+        std::ifstream config_file(filepath);
+        if (!config_file.is_open()) {
+            throw std::exception("file open failed.");
+        }
+        nlohmann::json json;
+        config_file >> json;
+        return json;
+    }
+
+    // "json" (the default), "compact" (JSON without whitespace) or
+    // "binary", see binary_descriptor.h.
+    void setDescriptorFormat(const std::string& format) {
+        if (format == "json" || format == "compact") {
+            m_binary_descriptor = false;
+            m_compact_descriptor = format == "compact";
+        }
+        else if (format == "binary") {
+            m_binary_descriptor = true;
+            m_compact_descriptor = false;
+        }
+        else {
+            throw std::runtime_error("descriptor_format must be json, compact or binary.");
+        }
+    }
+
+    // One combination of the "defines" matrix: the value of every define,
+    // and the preamble that declares them for each stage using them.
+    struct Permutation {
+        std::string name;
+        std::vector<std::pair<std::string, std::string>> defines;
+        std::map<VkShaderStageFlagBits, std::string> preambles;
+    };
+
+    bool hasPermutations() const {
+        return !m_defines.empty();
+    }
+
+    // The cartesian product of the define values, the first define varying
+    // slowest. A define listed by several stages takes the same value in
+    // all of them.
+    std::vector<Permutation> getPermutations() const {
+        std::vector<Permutation> permutations(1);
+        for (const auto& define : m_defines) {
+            std::vector<Permutation> expanded;
+            for (const auto& permutation : permutations) {
+                for (const auto& value : define.values) {
+                    Permutation next = permutation;
+                    next.name += (next.name.empty() ? "" : ",") + define.name + "=" + value;
+                    next.defines.emplace_back(define.name, value);
+                    for (auto stage : define.stages) {
+                        next.preambles[stage] += "#define " + define.name + " " + value + "\n";
+                    }
+                    expanded.push_back(next);
+                }
+            }
+            permutations.swap(expanded);
+        }
+        return permutations;
+    }
+
+    // Makes this config compile one permutation, to outputs and an archive
+    // name of its own.
+    void setPermutation(const Permutation& permutation, size_t index) {
+        shaderPreambles = permutation.preambles;
+        spv_path += "." + std::to_string(index);
+        m_name += "#" + permutation.name;
+    }
+
+    bool isBinaryDescriptor() const {
+        return m_binary_descriptor;
+    }
+
+    bool isCompactDescriptor() const {
+        return m_compact_descriptor;
+    }
+
 	bool isVulkanDef() const {
         return m_language_def == VULKAN;
 	}
@@ -117,7 +262,12 @@ public:
         return glslang::EShSourceGlsl;
     }
 
+    // Identifies the program in an archive; "name", or else the "spv" path.
+    std::string getName() const { return m_name; }
 	std::string getShaderDescriptorFilename() const { return sd_path; }
+    std::string getDepfileFilename() const { return m_depfile_path; }
+    std::string getHeaderFilename() const { return m_header_path; }
+    const std::vector<std::string>& getIncludePaths() const { return m_include_paths; }
 	std::string getShaderBinFilename(VkShaderStageFlagBits stage) const {
         std::string app = "";
         switch (stage)
@@ -149,14 +299,121 @@ public:
         return spv_path + "." + app + ".sr";
     }
     const std::vector<VkShaderStageFlagBits>& getStages() { return m_stages; }
+    bool isCompute() const {
+        return std::find(m_stages.begin(), m_stages.end(), VK_SHADER_STAGE_COMPUTE_BIT) != m_stages.end();
+    }
+    // Workgroup memory a compute program may use, in bytes; 0 for no limit.
+    uint32_t getMaxSharedMemory() const { return m_max_shared_memory; }
     EShMessages getMessages() const { return m_messages; }
+    const VertexInputOptions& getVertexInput() const { return m_vertex_input; }
+    // The limits of each stage's metrics, see spirv_cost.h.
+    const std::map<VkShaderStageFlagBits, std::map<std::string, uint32_t>>& getCostBudget() const { return m_cost_budget; }
 
     std::map<VkShaderStageFlagBits, std::string> shaderFilepaths;
     std::map<VkShaderStageFlagBits, std::string> shaderEntrys;
+    std::map<VkShaderStageFlagBits, std::string> shaderSources;
+    // Set by setPermutation(); parsed ahead of the stage's sources.
+    std::map<VkShaderStageFlagBits, std::string> shaderPreambles;
 private:
+    struct Define {
+        std::string name;
+        std::vector<std::string> values;
+        std::vector<VkShaderStageFlagBits> stages;
+    };
+
+    // "defines": { "MAX_LIGHT": [1, 2, 4], "USE_FOG": [false, true], "QUALITY": 2 }
+    void addDefines(VkShaderStageFlagBits stage, const nlohmann::json& defines) {
+        for (auto it = defines.begin(); it != defines.end(); ++it) {
+            std::vector<std::string> values;
+            const auto& json_values = it.value().is_array() ? it.value() : nlohmann::json::array({ it.value() });
+            for (const auto& value : json_values) {
+                if (value.is_string()) {
+                    values.push_back(value.get<std::string>());
+                }
+                else if (value.is_boolean()) {
+                    values.push_back(value.get<bool>() ? "1" : "0");
+                }
+                else {
+                    values.push_back(value.dump());
+                }
+            }
+            if (values.empty()) {
+                throw std::runtime_error("a define needs at least one value.");
+            }
+
+            auto shared = std::find_if(m_defines.begin(), m_defines.end(),
+                [&](const Define& define) { return define.name == it.key(); });
+            if (shared == m_defines.end()) {
+                m_defines.push_back({ it.key(), values, { stage } });
+            }
+            else if (shared->values == values) {
+                shared->stages.push_back(stage);
+            }
+            else {
+                throw std::runtime_error("a define shared by stages must have the same values.");
+            }
+        }
+    }
+
+    // "vertex_input": { "instanced": ["in_world"], "compact": true, "formats": { "in_normal": "snorm8" } }
+    void setVertexInput(const nlohmann::json& vertex_input) {
+        if (vertex_input.count("instanced") > 0) {
+            for (const auto& name : vertex_input["instanced"]) {
+                m_vertex_input.instanced.insert(name.get<std::string>());
+            }
+        }
+        if (vertex_input.count("compact") > 0) {
+            m_vertex_input.compact = vertex_input["compact"].get<bool>();
+        }
+        if (vertex_input.count("formats") > 0) {
+            for (auto it = vertex_input["formats"].begin(); it != vertex_input["formats"].end(); ++it) {
+                const auto format = it.value().get<std::string>();
+                if (!VertexInputOptions::isFormat(format)) {
+                    throw std::runtime_error("vertex_input formats must be float, half, unorm8, snorm8, unorm16 or snorm16.");
+                }
+                m_vertex_input.formats[it.key()] = format;
+            }
+        }
+    }
+
+    // "cost_budget": { "fragment": { "alu": 400, "texture_samples": 4, "dynamic_loops": 0 } }
+    void setCostBudget(const nlohmann::json& cost_budget) {
+        for (auto stage = cost_budget.begin(); stage != cost_budget.end(); ++stage) {
+            auto flag = VK_SHADER_STAGE_ALL;
+            if (stage.key() == "vertex") {
+                flag = VK_SHADER_STAGE_VERTEX_BIT;
+            }
+            else if (stage.key() == "fragment") {
+                flag = VK_SHADER_STAGE_FRAGMENT_BIT;
+            }
+            else if (stage.key() == "compute") {
+                flag = VK_SHADER_STAGE_COMPUTE_BIT;
+            }
+            else {
+                throw std::runtime_error("cost_budget stages must be vertex, fragment or compute.");
+            }
+            for (auto limit = stage.value().begin(); limit != stage.value().end(); ++limit) {
+                if (!IsCostMetric(limit.key())) {
+                    throw std::runtime_error("cost_budget metrics must be alu, transcendental, texture_samples, image_reads, branches, dynamic_loops or registers.");
+                }
+                m_cost_budget[flag][limit.key()] = limit.value().get<uint32_t>();
+            }
+        }
+    }
+
+    std::vector<Define> m_defines;
     LanguageDef m_language_def;
     std::string spv_path;
     std::string sd_path;
+    std::string m_depfile_path;
+    std::string m_header_path;
+    std::vector<std::string> m_include_paths;
+    std::string m_name;
+    bool m_binary_descriptor = false;
+    bool m_compact_descriptor = false;
+    uint32_t m_max_shared_memory = 0;
+    VertexInputOptions m_vertex_input;
+    std::map<VkShaderStageFlagBits, std::map<std::string, uint32_t>> m_cost_budget;
     EShMessages m_messages = (EShMessages)(EShMsgDefault);
     std::vector<VkShaderStageFlagBits> m_stages;
 };
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include "content_hash.h"
+#include "sha256.h"
+
+namespace {
+ContentHash Truncate(const Sha256::Digest& digest) {
+    ContentHash hash;
+    std::copy(digest.begin(), digest.begin() + hash.bytes.size(), hash.bytes.begin());
+    return hash;
+}
+}
+
+std::string ContentHash::toHex() const {
+    return Sha256::toHex(bytes.data(), bytes.size());
+}
+
+ContentHash HashSpirv(const std::vector<unsigned int>& spirv) {
+    Sha256 hash;
+    hash.update(spirv.data(), spirv.size() * sizeof(unsigned int));
+    return Truncate(hash.finish());
+}
+
+ContentHash HashLayout(const ProgramReflection& reflection, uint32_t stages) {
+    // Bindings are sorted by name; a renamed one must not change the hash.
+    std::vector<const ReflectedBinding*> bindings;
+    for (const auto& binding : reflection.bindings) {
+        bindings.push_back(&binding);
+    }
+    std::sort(bindings.begin(), bindings.end(), [](const ReflectedBinding* a, const ReflectedBinding* b) {
+        return a->set != b->set ? a->set < b->set : a->binding < b->binding;
+    });
+
+    Sha256 hash;
+    hash.updateValue(stages);
+    hash.updateValue(static_cast<uint32_t>(bindings.size()));
+    for (const auto p_binding : bindings) {
+        hash.updateValue(p_binding->set);
+        hash.updateValue(p_binding->binding);
+        hash.updateValue(p_binding->type);
+        hash.updateValue(p_binding->count);
+    }
+    hash.updateValue(static_cast<uint32_t>(reflection.push_constant_ranges.size()));
+    for (const auto& range : reflection.push_constant_ranges) {
+        hash.updateValue(range.offset);
+        hash.updateValue(range.size);
+        hash.updateValue(range.stages);
+    }
+    hash.updateValue(static_cast<uint32_t>(reflection.vertex_bindings.size()));
+    for (const auto& binding : reflection.vertex_bindings) {
+        hash.updateValue(binding.binding);
+        hash.updateValue(binding.stride);
+        hash.updateValue(binding.input_rate);
+    }
+    hash.updateValue(static_cast<uint32_t>(reflection.vertex_attributes.size()));
+    for (const auto& attribute : reflection.vertex_attributes) {
+        hash.updateValue(attribute.location);
+        hash.updateValue(attribute.binding);
+        hash.updateValue(attribute.format);
+        hash.updateValue(attribute.offset);
+    }
+    return Truncate(hash.finish());
+}
+
+ContentHash HashPipeline(const std::map<VkShaderStageFlagBits, ContentHash>& spvs, const ContentHash& layout) {
+    Sha256 hash;
+    hash.updateValue(static_cast<uint32_t>(spvs.size()));
+    for (const auto& spv : spvs) {
+        hash.updateValue(static_cast<uint32_t>(spv.first));
+        hash.update(spv.second.bytes.data(), spv.second.bytes.size());
+    }
+    hash.update(layout.bytes.data(), layout.bytes.size());
+    return Truncate(hash.finish());
+}
+
+ProgramHashes HashProgram(const std::map<std::string, uint32_t>& spv_paths,
+    const std::map<VkShaderStageFlagBits, std::vector<unsigned int>>& spirv, const ProgramReflection& reflection) {
+    ProgramHashes hashes;
+    std::map<VkShaderStageFlagBits, ContentHash> stage_hashes;
+    uint32_t stages = 0;
+    for (const auto& path : spv_paths) {
+        const auto stage = static_cast<VkShaderStageFlagBits>(path.second);
+        const auto hash = HashSpirv(spirv.at(stage));
+        hashes.spvs[path.first] = hash;
+        stage_hashes[stage] = hash;
+        stages |= stage;
+    }
+    hashes.layout = HashLayout(reflection, stages);
+    hashes.pipeline = HashPipeline(stage_hashes, hashes.layout);
+    return hashes;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+#include "reflection.h"
+
+// Stable 128-bit hashes a runtime can key VkPipelineCache entries and
+// dedupe pipelines by without hashing anything itself: the first 16
+// bytes of a SHA-256, written as 32 hex digits.
+struct ContentHash {
+    std::array<uint8_t, 16> bytes = {};
+
+    std::string toHex() const;
+};
+
+// Over the module words exactly as written to the .sr (before any .sr
+// encoding, after post-processing).
+ContentHash HashSpirv(const std::vector<unsigned int>& spirv);
+
+// Over what decides whether two programs can share a pipeline layout and
+// vertex input state, names left out: the set, binding, type and count of
+// every binding in set and binding order, stages (VkShaderStageFlags),
+// the push constant ranges and the vertex bindings and attributes.
+ContentHash HashLayout(const ProgramReflection& reflection, uint32_t stages);
+
+// Over the module of every stage, in stage order, and the layout.
+ContentHash HashPipeline(const std::map<VkShaderStageFlagBits, ContentHash>& spvs, const ContentHash& layout);
+
+// The hashes written into a .sd, or into one of its permutations.
+struct ProgramHashes {
+    // By .sr path, as in "spvs".
+    std::map<std::string, ContentHash> spvs;
+    ContentHash layout;
+    ContentHash pipeline;
+};
+
+// spv_paths maps the .sr path of every stage to the stage, as "spvs" does.
+ProgramHashes HashProgram(const std::map<std::string, uint32_t>& spv_paths,
+    const std::map<VkShaderStageFlagBits, std::vector<unsigned int>>& spirv, const ProgramReflection& reflection);
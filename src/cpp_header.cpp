@@ -0,0 +1,289 @@
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cctype>
+#include "cpp_header.h"
+#include "content_hash.h"
+#include "vertex_input.h"
+
+namespace {
+const char* kTypes =
+    "#ifndef SHADER_RETRIEVER_EMBEDDED_TYPES\n"
+    "#define SHADER_RETRIEVER_EMBEDDED_TYPES\n"
+    "namespace shader_retriever {\n"
+    "// The code of a VkShaderModuleCreateInfo, and the stage and entry point\n"
+    "// of a VkPipelineShaderStageCreateInfo.\n"
+    "struct Stage {\n"
+    "    VkShaderStageFlagBits stage;\n"
+    "    const uint32_t* code;\n"
+    "    // In bytes, as VkShaderModuleCreateInfo::codeSize.\n"
+    "    size_t code_size;\n"
+    "    const char* entry;\n"
+    "};\n"
+    "\n"
+    "// The bindings of one descriptor set, and the names the shader gives them.\n"
+    "struct DescriptorSet {\n"
+    "    const VkDescriptorSetLayoutBinding* bindings;\n"
+    "    const char* const* names;\n"
+    "    uint32_t binding_count;\n"
+    "};\n"
+    "\n"
+    "// A vertex shader input; location is UINT32_MAX without layout(location).\n"
+    "struct Attribute {\n"
+    "    const char* name;\n"
+    "    uint32_t location;\n"
+    "};\n"
+    "}\n"
+    "#endif\n";
+
+const char* StageArrayName(VkShaderStageFlagBits stage) {
+    switch (stage) {
+    case VK_SHADER_STAGE_VERTEX_BIT:
+        return "kVertexSpirv";
+    case VK_SHADER_STAGE_FRAGMENT_BIT:
+        return "kFragmentSpirv";
+    case VK_SHADER_STAGE_COMPUTE_BIT:
+        return "kComputeSpirv";
+    default:
+        return "kSpirv";
+    }
+}
+
+std::string StageFlagsSource(uint32_t stages) {
+    const std::pair<uint32_t, const char*> names[] = {
+        { VK_SHADER_STAGE_VERTEX_BIT, "VK_SHADER_STAGE_VERTEX_BIT" },
+        { VK_SHADER_STAGE_FRAGMENT_BIT, "VK_SHADER_STAGE_FRAGMENT_BIT" },
+        { VK_SHADER_STAGE_COMPUTE_BIT, "VK_SHADER_STAGE_COMPUTE_BIT" },
+    };
+    std::string source;
+    for (const auto& name : names) {
+        if (stages & name.first) {
+            source += (source.empty() ? "" : " | ") + std::string(name.second);
+            stages &= ~name.first;
+        }
+    }
+    if (stages != 0 || source.empty()) {
+        source += (source.empty() ? "" : " | ") + std::to_string(stages) + "u";
+    }
+    return source;
+}
+
+std::string DescriptorTypeSource(uint32_t type) {
+    const char* names[] = {
+        "VK_DESCRIPTOR_TYPE_SAMPLER",
+        "VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER",
+        "VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE",
+        "VK_DESCRIPTOR_TYPE_STORAGE_IMAGE",
+        "VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER",
+        "VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER",
+        "VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER",
+        "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER",
+        "VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC",
+        "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC",
+        "VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT",
+    };
+    if (type < sizeof(names) / sizeof(names[0])) {
+        return names[type];
+    }
+    return "static_cast<VkDescriptorType>(" + std::to_string(type) + ")";
+}
+
+std::string StringLiteral(const std::string& value) {
+    std::string literal = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            literal += '\\';
+        }
+        literal += c;
+    }
+    return literal + "\"";
+}
+
+// Writes "inline constexpr type name[] = { ... };" and its count, or a null
+// pointer for an empty list.
+void WriteList(std::ostream& out, const std::string& type, const std::string& name, const std::string& count_name,
+    const std::vector<std::string>& items) {
+    if (items.empty()) {
+        out << "inline constexpr const " << type << "* " << name << " = nullptr;\n";
+    }
+    else {
+        out << "inline constexpr " << type << " " << name << "[] = {\n";
+        for (const auto& item : items) {
+            out << "    " << item << ",\n";
+        }
+        out << "};\n";
+    }
+    out << "inline constexpr uint32_t " << count_name << " = " << items.size() << ";\n";
+}
+}
+
+CppHeaderWriter::CppHeaderWriter(const std::string& name_space, const std::string& source) :
+    m_namespace(toIdentifier(name_space)),
+    m_source(source) {
+
+}
+
+void CppHeaderWriter::addProgram(const std::string& sub_namespace, const std::string& comment,
+    const std::map<VkShaderStageFlagBits, std::vector<unsigned int>>& spirv,
+    const std::map<VkShaderStageFlagBits, std::string>& entries, const ProgramReflection& reflection) {
+    std::ostringstream out;
+    const std::string nested = sub_namespace.empty() ? "" : toIdentifier(sub_namespace);
+    const std::string prefix = nested.empty() ? "" : nested + "::";
+    out << "\n";
+    if (!comment.empty()) {
+        out << "// " << comment << "\n";
+    }
+    if (!nested.empty()) {
+        out << "namespace " << nested << " {\n";
+    }
+
+    std::vector<std::string> stages;
+    std::map<VkShaderStageFlagBits, ContentHash> module_hashes;
+    uint32_t stage_flags = 0;
+    for (const auto& module : spirv) {
+        const char* array_name = StageArrayName(module.first);
+        const auto hash = HashSpirv(module.second);
+        module_hashes[module.first] = hash;
+        stage_flags |= module.first;
+        const auto added = m_modules.emplace(hash.toHex(), prefix + array_name);
+        if (!added.second) {
+            out << "inline constexpr const auto& " << array_name << " = " << added.first->second << ";\n";
+        }
+        else {
+            out << "alignas(4) inline constexpr uint32_t " << array_name << "[] = {";
+            for (size_t i = 0; i < module.second.size(); ++i) {
+                out << (i % 8 == 0 ? "\n    " : " ") << "0x" << std::hex << std::setw(8) << std::setfill('0')
+                    << module.second[i] << std::dec << ",";
+            }
+            out << "\n};\n";
+        }
+        const auto entry = entries.find(module.first);
+        stages.push_back("{ " + StageFlagsSource(module.first) + ", " + array_name + ", sizeof(" + array_name + "), " +
+            StringLiteral(entry != entries.end() ? entry->second : "main") + " }");
+    }
+    WriteList(out, "shader_retriever::Stage", "kStages", "kStageCount", stages);
+
+    // A binding glslang left without a set, binding or type can not be
+    // part of a layout.
+    std::vector<const ReflectedBinding*> bindings;
+    for (const auto& binding : reflection.bindings) {
+        if (binding.set != kReflectionAbsent && binding.binding != kReflectionAbsent && binding.type != kReflectionAbsent) {
+            bindings.push_back(&binding);
+        }
+    }
+    std::sort(bindings.begin(), bindings.end(), [](const ReflectedBinding* a, const ReflectedBinding* b) {
+        return a->set != b->set ? a->set < b->set : a->binding < b->binding;
+    });
+    std::vector<std::string> sets;
+    for (uint32_t set = 0; set < reflection.sets_count; ++set) {
+        std::vector<std::string> layout_bindings;
+        std::vector<std::string> names;
+        for (const auto p_binding : bindings) {
+            if (p_binding->set == set) {
+                layout_bindings.push_back("{ " + std::to_string(p_binding->binding) + ", " +
+                    DescriptorTypeSource(p_binding->type) + ", " + std::to_string(p_binding->count) + ", " +
+                    StageFlagsSource(stage_flags) + ", nullptr }");
+                names.push_back(StringLiteral(p_binding->name));
+            }
+        }
+        if (layout_bindings.empty()) {
+            sets.push_back("{ nullptr, nullptr, 0 }");
+            continue;
+        }
+        const auto set_name = "kSet" + std::to_string(set);
+        WriteList(out, "VkDescriptorSetLayoutBinding", set_name + "Bindings", set_name + "BindingCount", layout_bindings);
+        out << "inline constexpr const char* " << set_name << "Names[] = {\n";
+        for (const auto& name : names) {
+            out << "    " << name << ",\n";
+        }
+        out << "};\n";
+        sets.push_back("{ " + set_name + "Bindings, " + set_name + "Names, " + std::to_string(layout_bindings.size()) + " }");
+    }
+    WriteList(out, "shader_retriever::DescriptorSet", "kSets", "kSetCount", sets);
+
+    std::vector<std::string> pool_sizes;
+    for (uint32_t type = 0; type < reflection.descriptor_pool.size(); ++type) {
+        if (reflection.descriptor_pool[type] > 0) {
+            pool_sizes.push_back("{ " + DescriptorTypeSource(type) + ", " + std::to_string(reflection.descriptor_pool[type]) + " }");
+        }
+    }
+    WriteList(out, "VkDescriptorPoolSize", "kPoolSizes", "kPoolSizeCount", pool_sizes);
+
+    std::vector<std::string> push_constant_ranges;
+    for (const auto& range : reflection.push_constant_ranges) {
+        push_constant_ranges.push_back("{ " + StageFlagsSource(range.stages) + ", " + std::to_string(range.offset) + ", " +
+            std::to_string(range.size) + " }");
+    }
+    WriteList(out, "VkPushConstantRange", "kPushConstantRanges", "kPushConstantRangeCount", push_constant_ranges);
+
+    std::vector<std::string> vertex_bindings;
+    for (const auto& binding : reflection.vertex_bindings) {
+        vertex_bindings.push_back("{ " + std::to_string(binding.binding) + ", " + std::to_string(binding.stride) + ", " +
+            (binding.input_rate == VK_VERTEX_INPUT_RATE_INSTANCE ? "VK_VERTEX_INPUT_RATE_INSTANCE" : "VK_VERTEX_INPUT_RATE_VERTEX") +
+            " }");
+    }
+    WriteList(out, "VkVertexInputBindingDescription", "kVertexBindings", "kVertexBindingCount", vertex_bindings);
+    std::vector<std::string> vertex_attributes;
+    for (const auto& attribute : reflection.vertex_attributes) {
+        vertex_attributes.push_back("{ " + std::to_string(attribute.location) + ", " + std::to_string(attribute.binding) + ", " +
+            VertexFormatName(attribute.format) + ", " + std::to_string(attribute.offset) + " }");
+    }
+    WriteList(out, "VkVertexInputAttributeDescription", "kVertexAttributes", "kVertexAttributeCount", vertex_attributes);
+
+    std::vector<std::string> attributes;
+    for (const auto& attribute : reflection.attributes) {
+        if (std::string(attribute.name).compare(0, 3, "gl_") != 0) {
+            attributes.push_back("{ " + StringLiteral(attribute.name) + ", " + std::to_string(attribute.qualifier.location) + "u }");
+        }
+    }
+    WriteList(out, "shader_retriever::Attribute", "kAttributes", "kAttributeCount", attributes);
+
+    if (reflection.compute.local_size_x > 0) {
+        out << "inline constexpr uint32_t kLocalSize[3] = { " << reflection.compute.local_size_x << ", "
+            << reflection.compute.local_size_y << ", " << reflection.compute.local_size_z << " };\n";
+        out << "inline constexpr uint32_t kSharedMemoryBytes = " << reflection.compute.shared_memory_bytes << ";\n";
+    }
+
+    // The "layout_hash" and "pipeline_hash" of the .sd.
+    const auto layout_hash = HashLayout(reflection, stage_flags);
+    out << "inline constexpr char kLayoutHash[] = \"" << layout_hash.toHex() << "\";\n";
+    out << "inline constexpr char kPipelineHash[] = \"" << HashPipeline(module_hashes, layout_hash).toHex() << "\";\n";
+
+    if (!nested.empty()) {
+        out << "}\n";
+    }
+    m_body += out.str();
+}
+
+void CppHeaderWriter::addAlias(const std::string& sub_namespace, const std::string& target, const std::string& comment) {
+    m_body += "\n";
+    if (!comment.empty()) {
+        m_body += "// " + comment + "\n";
+    }
+    m_body += "namespace " + toIdentifier(sub_namespace) + " = " + toIdentifier(target) + ";\n";
+}
+
+std::string CppHeaderWriter::finish() const {
+    std::string header = "// Generated by ShaderRetriever from " + m_source + "; do not edit.\n"
+        "#pragma once\n"
+        "#include <cstddef>\n"
+        "#include <cstdint>\n"
+        "#include <vulkan/vulkan.h>\n"
+        "\n";
+    header += kTypes;
+    header += "\nnamespace " + m_namespace + " {";
+    header += m_body;
+    header += "}\n";
+    return header;
+}
+
+std::string CppHeaderWriter::toIdentifier(const std::string& name) {
+    std::string identifier;
+    for (char c : name) {
+        identifier += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+    if (identifier.empty() || std::isdigit(static_cast<unsigned char>(identifier[0]))) {
+        identifier = "shader_" + identifier;
+    }
+    return identifier;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <map>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "reflection.h"
+
+// Generates a C++ header that compiles programs into an executable, for
+// builds that must not read files or parse JSON at startup. Each program
+// gets the SPIR-V of every stage as an alignas(4) uint32_t array and
+// constexpr Vulkan structs for what its .sd reflects: the bindings of each
+// set as VkDescriptorSetLayoutBinding, the pool sizes of one instance of
+// every set, the VkPushConstantRange list and the vertex input state.
+// Every list X comes with kXCount; an empty one is a null pointer.
+class CppHeaderWriter {
+public:
+    // Everything goes into namespace name_space, made an identifier;
+    // source names what the header was generated from.
+    CppHeaderWriter(const std::string& name_space, const std::string& source);
+
+    // Adds a program. Its declarations go straight into the header's
+    // namespace with sub_namespace empty (one program per header), or else
+    // into a nested namespace. A module already added is referenced
+    // rather than embedded again.
+    void addProgram(const std::string& sub_namespace, const std::string& comment,
+        const std::map<VkShaderStageFlagBits, std::vector<unsigned int>>& spirv,
+        const std::map<VkShaderStageFlagBits, std::string>& entries, const ProgramReflection& reflection);
+    // Makes sub_namespace another name of an added program.
+    void addAlias(const std::string& sub_namespace, const std::string& target, const std::string& comment);
+
+    std::string finish() const;
+
+    // name with every character an identifier can not hold replaced.
+    static std::string toIdentifier(const std::string& name);
+
+private:
+    std::string m_namespace;
+    std::string m_source;
+    std::string m_body;
+    // Hash of every module added to the qualified name of its array.
+    std::map<std::string, std::string> m_modules;
+};
@@ -0,0 +1,72 @@
+#include <fstream>
+#include <streambuf>
+#include <filesystem>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstring>
+#include "file_utils.h"
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+std::atomic<uint64_t> g_temp_counter{ 0 };
+
+// Unique to this write: several workers, or processes, may write the same
+// output at once, and each must rename only its own complete file.
+std::string TempPath(const std::string& path) {
+#ifdef _WIN32
+    const auto pid = GetCurrentProcessId();
+#else
+    const auto pid = getpid();
+#endif
+    std::ostringstream temp_path;
+    temp_path << path << ".tmp." << pid << "." << std::hash<std::thread::id>()(std::this_thread::get_id())
+        << "." << g_temp_counter++;
+    return temp_path.str();
+}
+
+bool HasContent(const std::string& path, const void* data, size_t size) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open() || static_cast<size_t>(file.tellg()) != size) {
+        return false;
+    }
+    file.seekg(0);
+    std::string content(size, '\0');
+    return file.read(&content[0], size) && std::memcmp(content.data(), data, size) == 0;
+}
+}
+
+bool WriteOutputFile(const std::string& path, const void* data, size_t size, bool only_if_changed) {
+    if (only_if_changed && HasContent(path, data, size)) {
+        return true;
+    }
+
+    const auto temp_path = TempPath(path);
+    std::error_code error;
+    {
+        std::ofstream file(temp_path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        file.write(static_cast<const char*>(data), size);
+        if (!file.good()) {
+            file.close();
+            fs::remove(temp_path, error);
+            return false;
+        }
+    }
+    fs::rename(temp_path, path, error);
+    if (error) {
+        fs::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
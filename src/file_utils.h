@@ -0,0 +1,8 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+// Writes through a temporary file renamed over path, so readers never see
+// a partially written output. With only_if_changed an output whose content
+// is already identical is left alone, keeping its timestamp.
+bool WriteOutputFile(const std::string& path, const void* data, size_t size, bool only_if_changed = false);
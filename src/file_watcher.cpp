@@ -0,0 +1,153 @@
+#include <filesystem>
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+#include "file_watcher.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+#ifdef _WIN32
+struct FileWatcher::Directory {
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    OVERLAPPED overlapped = {};
+    alignas(DWORD) char buffer[16 * 1024];
+
+    bool request() {
+        return ReadDirectoryChangesW(handle, buffer, sizeof(buffer), FALSE,
+            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+            nullptr, &overlapped, nullptr) != FALSE;
+    }
+};
+
+FileWatcher::FileWatcher() {
+
+}
+
+FileWatcher::~FileWatcher() {
+    for (auto& directory : m_directories) {
+        CancelIo(directory.second->handle);
+        CloseHandle(directory.second->handle);
+        CloseHandle(directory.second->overlapped.hEvent);
+        delete directory.second;
+    }
+}
+
+void FileWatcher::addDirectory(const std::string& directory) {
+    auto p_directory = new Directory;
+    p_directory->handle = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    p_directory->overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    if (p_directory->handle == INVALID_HANDLE_VALUE || !p_directory->request()) {
+        delete p_directory;
+        throw std::runtime_error(directory + " can not be watched.");
+    }
+    m_directories[directory] = p_directory;
+}
+
+bool FileWatcher::wait(std::set<std::string>& changed, int timeout_ms) {
+    // More directories than WaitForMultipleObjects takes are common, so
+    // completed requests are polled instead.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    const auto size_before = changed.size();
+    while (true) {
+        for (auto& directory : m_directories) {
+            auto p_directory = directory.second;
+            DWORD size = 0;
+            if (!GetOverlappedResult(p_directory->handle, &p_directory->overlapped, &size, FALSE)) {
+                continue;
+            }
+            for (DWORD offset = 0; size > 0;) {
+                auto p_info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(p_directory->buffer + offset);
+                std::wstring name(p_info->FileName, p_info->FileNameLength / sizeof(WCHAR));
+                collect(directory.first, fs::path(name).string(), changed);
+                if (p_info->NextEntryOffset == 0) {
+                    break;
+                }
+                offset += p_info->NextEntryOffset;
+            }
+            ResetEvent(p_directory->overlapped.hEvent);
+            p_directory->request();
+        }
+        if (changed.size() != size_before || (timeout_ms >= 0 && std::chrono::steady_clock::now() >= deadline)) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return changed.size() != size_before;
+}
+#else
+struct FileWatcher::Directory {
+
+};
+
+FileWatcher::FileWatcher() {
+    m_inotify = inotify_init1(IN_CLOEXEC);
+    if (m_inotify < 0) {
+        throw std::runtime_error("inotify can not be initialized.");
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    for (auto& directory : m_directories) {
+        delete directory.second;
+    }
+    close(m_inotify);
+}
+
+void FileWatcher::addDirectory(const std::string& directory) {
+    int watch = inotify_add_watch(m_inotify, directory.c_str(),
+        IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+    if (watch < 0) {
+        throw std::runtime_error(directory + " can not be watched.");
+    }
+    m_watch_directories[watch] = directory;
+    m_directories[directory] = new Directory;
+}
+
+bool FileWatcher::wait(std::set<std::string>& changed, int timeout_ms) {
+    const auto size_before = changed.size();
+    pollfd fd = { m_inotify, POLLIN, 0 };
+    if (poll(&fd, 1, timeout_ms) <= 0) {
+        return false;
+    }
+
+    alignas(inotify_event) char buffer[16 * 1024];
+    auto size = read(m_inotify, buffer, sizeof(buffer));
+    for (ssize_t offset = 0; offset < size;) {
+        auto p_event = reinterpret_cast<const inotify_event*>(buffer + offset);
+        auto directory = m_watch_directories.find(p_event->wd);
+        if (directory != m_watch_directories.end() && p_event->len > 0) {
+            collect(directory->second, p_event->name, changed);
+        }
+        offset += sizeof(inotify_event) + p_event->len;
+    }
+    return changed.size() != size_before;
+}
+#endif
+
+void FileWatcher::watch(const std::string& path) {
+    if (m_files.count(path) > 0) {
+        return;
+    }
+    const auto directory = fs::path(path).parent_path().string();
+    if (m_directories.count(directory) == 0) {
+        addDirectory(directory);
+    }
+    // Only once its directory is watched, so a failed watch is retried.
+    m_files.insert(path);
+}
+
+void FileWatcher::collect(const std::string& directory, const std::string& name, std::set<std::string>& changed) {
+    const auto path = (fs::path(directory) / name).lexically_normal().string();
+    if (m_files.count(path) > 0) {
+        changed.insert(path);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <set>
+#include <map>
+#include <vector>
+
+// Reports changes to a set of files. Directories are watched rather than
+// the files themselves, so editors that save through a rename are seen too.
+// Uses inotify on Linux and ReadDirectoryChangesW on Windows.
+class FileWatcher {
+public:
+    FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+    ~FileWatcher();
+
+    // path must be absolute and normalized; changes are reported the same way.
+    // Throws when its directory can not be watched, e.g. does not exist yet.
+    void watch(const std::string& path);
+
+    // Waits up to timeout_ms (forever when negative) for changes of watched
+    // files and adds them to changed. Returns false when nothing changed.
+    bool wait(std::set<std::string>& changed, int timeout_ms);
+
+private:
+    struct Directory;
+
+    void addDirectory(const std::string& directory);
+    void collect(const std::string& directory, const std::string& name, std::set<std::string>& changed);
+
+    std::set<std::string> m_files;
+    std::map<std::string, Directory*> m_directories;
+#ifndef _WIN32
+    int m_inotify = -1;
+    std::map<int, std::string> m_watch_directories;
+#endif
+};
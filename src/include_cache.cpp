@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include "include_cache.h"
+#include "file_utils.h"
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+// The name of an "#include" line and whether it is a local ("") one.
+bool ParseIncludeLine(const std::string& line, std::string& header_name, bool& local) {
+    auto begin = line.find_first_not_of(" \t");
+    if (begin == std::string::npos || line[begin] != '#') {
+        return false;
+    }
+    begin = line.find_first_not_of(" \t", begin + 1);
+    if (begin == std::string::npos || line.compare(begin, 7, "include") != 0) {
+        return false;
+    }
+    auto open = line.find_first_of("\"<", begin + 7);
+    if (open == std::string::npos) {
+        return false;
+    }
+    local = line[open] == '"';
+    auto close = line.find(local ? '"' : '>', open + 1);
+    if (close == std::string::npos) {
+        return false;
+    }
+    header_name = line.substr(open + 1, close - open - 1);
+    return true;
+}
+
+// A space or '#' in a depfile path is escaped with a backslash, '$' by
+// doubling it.
+std::string EscapeDepfilePath(const std::string& path) {
+    std::string escaped;
+    for (char c : fs::path(path).generic_string()) {
+        if (c == ' ' || c == '#') {
+            escaped += '\\';
+        }
+        else if (c == '$') {
+            escaped += '$';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+}
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& path) {
+    std::shared_ptr<MappedFile> p_file(new MappedFile());
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    LARGE_INTEGER size;
+    bool valid = GetFileSizeEx(file, &size) != 0;
+    if (valid && size.QuadPart > 0) {
+        // The view keeps the file mapped after both handles are closed.
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        valid = mapping != nullptr;
+        if (valid) {
+            p_file->m_p_view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            valid = p_file->m_p_view != nullptr;
+            CloseHandle(mapping);
+        }
+        if (valid) {
+            p_file->m_size = static_cast<size_t>(size.QuadPart);
+        }
+    }
+    CloseHandle(file);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    bool valid = fstat(fd, &info) == 0;
+    if (valid && info.st_size > 0) {
+        void* p_view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        valid = p_view != MAP_FAILED;
+        if (valid) {
+            p_file->m_p_view = p_view;
+            p_file->m_size = static_cast<size_t>(info.st_size);
+        }
+    }
+    close(fd);
+#endif
+    if (!valid) {
+        return nullptr;
+    }
+    return p_file;
+}
+
+MappedFile::~MappedFile() {
+    if (m_p_view == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(m_p_view);
+#else
+    munmap(m_p_view, m_size);
+#endif
+}
+
+std::shared_ptr<const MappedFile> IncludeCache::get(const std::string& path) {
+    const auto start = std::chrono::steady_clock::now();
+    std::error_code error;
+    const auto write_time = fs::last_write_time(path, error);
+    if (error) {
+        return nullptr;
+    }
+    const auto size = fs::file_size(path, error);
+    if (error) {
+        return nullptr;
+    }
+
+    std::shared_ptr<const MappedFile> p_file;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& entry = m_files[path];
+        if (entry.p_file == nullptr || entry.write_time != write_time || entry.size != size) {
+            entry.p_file = MappedFile::open(path);
+            entry.write_time = write_time;
+            entry.size = size;
+            if (entry.p_file != nullptr) {
+                ++m_mapped_files;
+                m_mapped_bytes += entry.p_file->size();
+            }
+        }
+        p_file = entry.p_file;
+    }
+    if (p_file != nullptr) {
+        m_read_bytes += p_file->size();
+        m_read_ns += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+    return p_file;
+}
+
+void IncludeCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_files.clear();
+}
+
+void IncludeCache::writeStatistics(std::ostream& out) const {
+    const double read_mb = m_read_bytes / (1024.0 * 1024.0);
+    const double read_seconds = m_read_ns / 1e9;
+    const auto precision = out.precision();
+    out << "sources: " << m_mapped_files << " files mapped ("
+        << std::fixed << std::setprecision(1) << m_mapped_bytes / (1024.0 * 1024.0) << " MB), "
+        << read_mb << " MB read at " << (read_seconds > 0.0 ? read_mb / read_seconds : 0.0) << " MB/s." << std::endl;
+    out.unsetf(std::ios::floatfield);
+    out.precision(precision);
+}
+
+std::string AbsolutePath(const std::string& path) {
+    std::error_code error;
+    return fs::absolute(path, error).lexically_normal().string();
+}
+
+std::string ResolveInclude(const std::string& header_name, const std::string& includer_dir,
+    const std::vector<std::string>& include_paths, bool local) {
+    std::error_code error;
+    if (local) {
+        const auto path = fs::path(includer_dir) / header_name;
+        if (fs::is_regular_file(path, error)) {
+            return AbsolutePath(path.string());
+        }
+    }
+    for (const auto& directory : include_paths) {
+        const auto path = fs::path(directory) / header_name;
+        if (fs::is_regular_file(path, error)) {
+            return AbsolutePath(path.string());
+        }
+    }
+    return "";
+}
+
+ShaderIncluder::ShaderIncluder(IncludeCache* p_cache, const std::vector<std::string>& include_paths,
+    const std::string& source_path) :
+    m_p_cache(p_cache != nullptr ? p_cache : &m_own_cache),
+    m_include_paths(include_paths),
+    m_source_path(source_path) {
+
+}
+
+glslang::TShader::Includer::IncludeResult* ShaderIncluder::includeSystem(const char* header_name,
+    const char* includer_name, size_t) {
+    return include(header_name, includer_name, false);
+}
+
+glslang::TShader::Includer::IncludeResult* ShaderIncluder::includeLocal(const char* header_name,
+    const char* includer_name, size_t) {
+    return include(header_name, includer_name, true);
+}
+
+glslang::TShader::Includer::IncludeResult* ShaderIncluder::include(const char* header_name,
+    const char* includer_name, bool local) {
+    // The stage's own strings have no name; an included file is named by
+    // the path returned for it here.
+    const std::string includer = includer_name != nullptr && *includer_name != '\0' ? includer_name : m_source_path;
+    const auto path = ResolveInclude(header_name, fs::path(includer).parent_path().string(), m_include_paths, local);
+    if (path.empty()) {
+        return nullptr;
+    }
+    auto p_file = m_p_cache->get(path);
+    if (p_file == nullptr) {
+        return nullptr;
+    }
+    m_dependencies.insert(path);
+    // The mapping lives as long as glslang holds the result.
+    return new IncludeResult(path, p_file->data(), p_file->size(), new std::shared_ptr<const MappedFile>(p_file));
+}
+
+void ShaderIncluder::releaseInclude(IncludeResult* result) {
+    if (result != nullptr) {
+        delete static_cast<std::shared_ptr<const MappedFile>*>(result->userData);
+        delete result;
+    }
+}
+
+void ScanIncludes(const char* text, size_t size, const std::string& includer,
+    const std::vector<std::string>& include_paths, std::set<std::string>& files, IncludeCache& cache) {
+    const auto includer_dir = fs::path(includer).parent_path().string();
+    const char* end = text + size;
+    for (const char* line = text; line < end;) {
+        const char* line_end = std::find(line, end, '\n');
+        std::string header_name;
+        bool local = false;
+        if (ParseIncludeLine(std::string(line, line_end), header_name, local)) {
+            const auto path = ResolveInclude(header_name, includer_dir, include_paths, local);
+            if (!path.empty() && files.insert(path).second) {
+                const auto p_file = cache.get(path);
+                if (p_file != nullptr) {
+                    ScanIncludes(p_file->data(), p_file->size(), path, include_paths, files, cache);
+                }
+            }
+        }
+        line = line_end == end ? end : line_end + 1;
+    }
+}
+
+void ScanIncludes(const std::string& path, const std::vector<std::string>& include_paths,
+    std::set<std::string>& files, IncludeCache& cache) {
+    const auto normalized = AbsolutePath(path);
+    if (!files.insert(normalized).second) {
+        return;
+    }
+    const auto p_file = cache.get(normalized);
+    if (p_file != nullptr) {
+        ScanIncludes(p_file->data(), p_file->size(), normalized, include_paths, files, cache);
+    }
+}
+
+bool WriteDepfile(const std::string& path, const std::string& target, const std::set<std::string>& dependencies,
+    bool only_if_changed) {
+    std::string content = EscapeDepfilePath(target) + ":";
+    for (const auto& dependency : dependencies) {
+        content += " \\\n  " + EscapeDepfilePath(dependency);
+    }
+    content += "\n";
+    return WriteOutputFile(path, content.data(), content.size(), only_if_changed);
+}
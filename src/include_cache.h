@@ -0,0 +1,116 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <ostream>
+#include <filesystem>
+#include <cstddef>
+#include <cstdint>
+#include <ShaderLang.h>
+
+// A whole file mapped read-only. Rewriting a file in place while it is
+// mapped is undefined on POSIX and refused on Windows, which is why
+// IncludeCache::clear() exists.
+class MappedFile {
+public:
+    // Null when path can not be opened or mapped; an empty file maps to
+    // an empty string.
+    static std::shared_ptr<const MappedFile> open(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const char* data() const { return m_p_view != nullptr ? static_cast<const char*>(m_p_view) : ""; }
+    size_t size() const { return m_size; }
+
+private:
+    MappedFile() = default;
+
+    void* m_p_view = nullptr;
+    size_t m_size = 0;
+};
+
+// Every stage source and #included file the programs of a run read,
+// mapped once and shared by all their stages, on any thread. A file whose
+// size or write time changed since it was mapped is mapped again.
+class IncludeCache {
+public:
+    // path must be absolute and normalized, as ResolveInclude() returns it.
+    std::shared_ptr<const MappedFile> get(const std::string& path);
+
+    // Unmaps every file; those a compile still holds stay valid until it
+    // is done. Watch mode calls this between rounds, and the server after
+    // every request, so the files can be edited.
+    void clear();
+
+    // Files mapped, bytes handed out and the rate get() handed them out at.
+    void writeStatistics(std::ostream& out) const;
+
+private:
+    struct Entry {
+        std::shared_ptr<const MappedFile> p_file;
+        std::filesystem::file_time_type write_time;
+        uintmax_t size = 0;
+    };
+
+    std::mutex m_mutex;
+    std::map<std::string, Entry> m_files;
+    std::atomic<uint64_t> m_mapped_files{ 0 };
+    std::atomic<uint64_t> m_mapped_bytes{ 0 };
+    std::atomic<uint64_t> m_read_bytes{ 0 };
+    std::atomic<uint64_t> m_read_ns{ 0 };
+};
+
+// Absolute and lexically normalized, the form every dependency is kept in.
+std::string AbsolutePath(const std::string& path);
+
+// The file #include "header_name" (local) or #include <header_name> of a
+// file in includer_dir means: next to the includer for a local include,
+// then in include_paths in order. Absolute and normalized; empty when
+// there is no such file.
+std::string ResolveInclude(const std::string& header_name, const std::string& includer_dir,
+    const std::vector<std::string>& include_paths, bool local);
+
+// Resolves the #includes of one stage for glslang (the source needs
+// #extension GL_GOOGLE_include_directive), and records the files they
+// read. Includes of the stage's own strings resolve next to source_path.
+class ShaderIncluder : public glslang::TShader::Includer {
+public:
+    // Without p_cache, files are mapped for this stage alone.
+    ShaderIncluder(IncludeCache* p_cache, const std::vector<std::string>& include_paths, const std::string& source_path);
+
+    IncludeResult* includeSystem(const char* header_name, const char* includer_name, size_t depth) override;
+    IncludeResult* includeLocal(const char* header_name, const char* includer_name, size_t depth) override;
+    void releaseInclude(IncludeResult* result) override;
+
+    const std::set<std::string>& getDependencies() const { return m_dependencies; }
+
+private:
+    IncludeResult* include(const char* header_name, const char* includer_name, bool local);
+
+    IncludeCache m_own_cache;
+    IncludeCache* m_p_cache;
+    std::vector<std::string> m_include_paths;
+    std::string m_source_path;
+    std::set<std::string> m_dependencies;
+};
+
+// Adds the files text includes to files, transitively, without running
+// the preprocessor: an #include in a disabled #if block counts too, one
+// that does not resolve is left out. includer names the file text is from.
+void ScanIncludes(const char* text, size_t size, const std::string& includer,
+    const std::vector<std::string>& include_paths, std::set<std::string>& files, IncludeCache& cache);
+
+// The same for the file at path, which is added as well.
+void ScanIncludes(const std::string& path, const std::vector<std::string>& include_paths,
+    std::set<std::string>& files, IncludeCache& cache);
+
+// Writes a Make/Ninja depfile saying target depends on every file of
+// dependencies.
+bool WriteDepfile(const std::string& path, const std::string& target, const std::set<std::string>& dependencies,
+    bool only_if_changed = false);
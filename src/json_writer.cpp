@@ -0,0 +1,84 @@
+#include <cstdio>
+#include "json_writer.h"
+
+void JsonWriter::key(const char* name, size_t size) {
+    beginItem();
+    writeString(name, size);
+    m_out += m_compact ? ":" : ": ";
+    m_after_key = true;
+}
+
+void JsonWriter::value(const char* value, size_t size) {
+    beginItem();
+    writeString(value, size);
+}
+
+void JsonWriter::value(bool value) {
+    number(value ? "true" : "false");
+}
+
+void JsonWriter::number(const std::string& text) {
+    beginItem();
+    m_out += text;
+}
+
+void JsonWriter::open(char bracket) {
+    beginItem();
+    m_out += bracket;
+    m_counts.push_back(0);
+}
+
+void JsonWriter::close(char bracket) {
+    const size_t count = m_counts.back();
+    m_counts.pop_back();
+    if (!m_compact && count > 0) {
+        m_out += '\n';
+        m_out.append(m_counts.size() * 4, ' ');
+    }
+    m_out += bracket;
+}
+
+void JsonWriter::beginItem() {
+    if (m_after_key) {
+        // The value of a key; the key already did the separating.
+        m_after_key = false;
+        return;
+    }
+    if (m_counts.empty()) {
+        return;
+    }
+    if (m_counts.back()++ > 0) {
+        m_out += ',';
+    }
+    if (!m_compact) {
+        m_out += '\n';
+        m_out.append(m_counts.size() * 4, ' ');
+    }
+}
+
+void JsonWriter::writeString(const char* value, size_t size) {
+    m_out += '"';
+    for (size_t i = 0; i < size; ++i) {
+        const char c = value[i];
+        switch (c) {
+        case '"': m_out += "\\\""; break;
+        case '\\': m_out += "\\\\"; break;
+        case '\b': m_out += "\\b"; break;
+        case '\f': m_out += "\\f"; break;
+        case '\n': m_out += "\\n"; break;
+        case '\r': m_out += "\\r"; break;
+        case '\t': m_out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+                m_out += escaped;
+            }
+            else {
+                m_out += c;
+            }
+            break;
+        }
+    }
+    m_out += '"';
+}
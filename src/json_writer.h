@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+// Streams JSON text into a string without building a document. Keys are
+// written in the order they are given, so callers emit them sorted to get
+// the order nlohmann::json always used. The indented form is byte for byte
+// what nlohmann::json::dump(4) writes; the compact form has no whitespace.
+class JsonWriter {
+public:
+    JsonWriter(std::string& out, bool compact) : m_out(out), m_compact(compact) {}
+
+    void beginObject() { open('{'); }
+    void endObject() { close('}'); }
+    void beginArray() { open('['); }
+    void endArray() { close(']'); }
+
+    void key(const char* name, size_t size);
+    void key(const char* name) { key(name, std::strlen(name)); }
+    void key(const std::string& name) { key(name.data(), name.size()); }
+
+    void value(const char* value, size_t size);
+    void value(const char* value) { this->value(value, std::strlen(value)); }
+    void value(const std::string& value) { this->value(value.data(), value.size()); }
+    void value(bool value);
+    void value(uint32_t value) { number(std::to_string(value)); }
+    void value(uint64_t value) { number(std::to_string(value)); }
+    void value(int32_t value) { number(std::to_string(value)); }
+    void value(int64_t value) { number(std::to_string(value)); }
+    void null() { number("null"); }
+
+private:
+    void open(char bracket);
+    void close(char bracket);
+    // Separator and indentation before an array element or a key.
+    void beginItem();
+    void number(const std::string& text);
+    void writeString(const char* value, size_t size);
+
+    std::string& m_out;
+    bool m_compact;
+    // Items written so far at every open level.
+    std::vector<size_t> m_counts;
+    bool m_after_key = false;
+};
@@ -0,0 +1,460 @@
+#include <fstream>
+#include <algorithm>
+#include <set>
+#include <vulkan/vulkan.h>
+#include "layout_planner.h"
+#include "json_writer.h"
+
+namespace {
+const uint32_t kNoSet = 0xFFFFFFFF;
+// VkPhysicalDeviceLimits::maxPushConstantsSize is at least this much.
+const uint32_t kGuaranteedPushConstantBytes = 128;
+// The largest minUniformBufferOffsetAlignment allowed; a block updated per
+// draw takes this much of a dynamic uniform buffer at least.
+const uint32_t kMaxUniformBufferAlignment = 256;
+
+using SetLayout = LayoutPlanner::SetLayout;
+
+// Every binding of part is in whole, with the same descriptor type.
+bool IsContained(const SetLayout& part, const SetLayout& whole) {
+    return std::includes(whole.begin(), whole.end(), part.begin(), part.end());
+}
+
+// VkDescriptorPoolCreateInfo::maxSets and the pool sizes by type.
+struct PoolSizes {
+    uint32_t max_sets = 0;
+    std::map<uint32_t, uint32_t> counts;
+
+    void add(const SetLayout& set, uint32_t instances) {
+        max_sets += instances;
+        for (const auto& binding : set) {
+            if (binding.type < VK_DESCRIPTOR_TYPE_MAX_ENUM) {
+                counts[binding.type] += binding.count * instances;
+            }
+        }
+    }
+};
+
+uint32_t GetRate(const std::map<std::string, uint32_t>& update_rates, const std::string& block) {
+    auto found = update_rates.find(block);
+    return found != update_rates.end() ? found->second : 1;
+}
+
+uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+uint32_t GetInstances(const std::map<std::string, uint32_t>& instances, const std::string& program) {
+    auto found = instances.find(program);
+    if (found == instances.end()) {
+        found = instances.find(program.substr(0, program.find('#')));
+    }
+    return found != instances.end() ? found->second : 1;
+}
+
+void WritePoolSizes(JsonWriter& writer, const PoolSizes& pool) {
+    writer.beginObject();
+    writer.key("max_sets");
+    writer.value(pool.max_sets);
+    writer.key("pool_sizes");
+    writer.beginArray();
+    for (const auto& count : pool.counts) {
+        writer.beginObject();
+        writer.key("descriptor_count");
+        writer.value(count.second);
+        writer.key("type");
+        writer.value(count.first);
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+}
+
+bool WriteFile(const std::string& path, const std::string& out) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write(out.data(), out.size());
+    return file.good();
+}
+
+struct CanonicalLayout {
+    SetLayout bindings;
+    uint32_t stages = 0;
+    uint32_t programs = 0;
+};
+}
+
+void LayoutPlanner::add(const std::string& program, const ProgramReflection& reflection, uint32_t stages) {
+    Program planned;
+    planned.stages = stages;
+    for (const auto& binding : reflection.bindings) {
+        if (binding.set == kReflectionAbsent || binding.binding == kReflectionAbsent) {
+            continue;
+        }
+        if (binding.set >= planned.sets.size()) {
+            planned.sets.resize(binding.set + 1);
+        }
+        planned.sets[binding.set].push_back({ binding.binding, binding.type, binding.count });
+    }
+    for (auto& set : planned.sets) {
+        std::sort(set.begin(), set.end());
+    }
+    for (const auto& push_constant : reflection.push_constants) {
+        planned.push_constants.emplace_back(push_constant.stage, push_constant.block_size);
+    }
+    std::sort(planned.push_constants.begin(), planned.push_constants.end());
+    for (const auto& range : reflection.push_constant_ranges) {
+        planned.push_constant_bytes = std::max(planned.push_constant_bytes, range.offset + range.size);
+    }
+    for (const auto& block : reflection.uniform_blocks) {
+        planned.blocks.push_back({ block.name, block.block_size, block.padding_bytes, block.suggested_size });
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_programs[program] = planned;
+}
+
+bool LayoutPlanner::writeFile(const std::string& path, const std::vector<std::vector<std::string>>& draw_groups,
+    std::ostream& log) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Largest layouts first, so every smaller one finds the layout that
+    // contains it; an empty set stays a layout of its own.
+    std::map<SetLayout, uint32_t> distinct;
+    for (const auto& program : m_programs) {
+        for (const auto& set : program.second.sets) {
+            distinct.emplace(set, kNoSet);
+        }
+    }
+    std::vector<const SetLayout*> by_size;
+    for (const auto& layout : distinct) {
+        by_size.push_back(&layout.first);
+    }
+    std::stable_sort(by_size.begin(), by_size.end(), [](const SetLayout* a, const SetLayout* b) {
+        return a->size() > b->size();
+    });
+    std::vector<CanonicalLayout> canonical;
+    for (const auto* layout : by_size) {
+        uint32_t id = 0;
+        while (id < canonical.size() && (layout->empty() != canonical[id].bindings.empty() ||
+            !IsContained(*layout, canonical[id].bindings))) {
+            ++id;
+        }
+        if (id == canonical.size()) {
+            canonical.push_back({ *layout });
+        }
+        distinct[*layout] = id;
+    }
+
+    std::map<std::string, std::vector<uint32_t>> program_sets;
+    std::vector<std::set<uint32_t>> layouts_per_set;
+    std::vector<uint32_t> programs_per_set;
+    for (const auto& program : m_programs) {
+        auto& ids = program_sets[program.first];
+        for (size_t set = 0; set < program.second.sets.size(); ++set) {
+            const uint32_t id = distinct[program.second.sets[set]];
+            ids.push_back(id);
+            canonical[id].stages |= program.second.stages;
+            ++canonical[id].programs;
+            if (set >= layouts_per_set.size()) {
+                layouts_per_set.resize(set + 1);
+                programs_per_set.resize(set + 1, 0);
+            }
+            layouts_per_set[set].insert(id);
+            ++programs_per_set[set];
+        }
+    }
+
+    log << m_programs.size() << " programs, " << distinct.size() << " distinct set layouts, "
+        << canonical.size() << " after unification." << std::endl;
+    // Sets that change less often belong at lower numbers, where they stay
+    // bound across pipeline switches.
+    for (size_t set = 1; set < layouts_per_set.size(); ++set) {
+        if (layouts_per_set[set].size() < layouts_per_set[set - 1].size()) {
+            log << "set " << set << " has " << layouts_per_set[set].size() << " layouts and set " << set - 1
+                << " has " << layouts_per_set[set - 1].size() << ", consider swapping them." << std::endl;
+        }
+    }
+
+    // The first set whose layout differs within a group, kNoSet when the
+    // programs are compatible for every set.
+    std::vector<uint32_t> first_incompatible(draw_groups.size(), kNoSet);
+    for (size_t g = 0; g < draw_groups.size(); ++g) {
+        const Program* p_first = nullptr;
+        bool push_constants_differ = false;
+        std::vector<uint32_t> group_sets;
+        for (const auto& name : draw_groups[g]) {
+            auto found = m_programs.find(name);
+            if (found == m_programs.end()) {
+                log << "draw group " << g << ": " << name << " is not in the batch." << std::endl;
+                continue;
+            }
+            if (p_first == nullptr) {
+                p_first = &found->second;
+            }
+            else if (found->second.push_constants != p_first->push_constants) {
+                push_constants_differ = true;
+            }
+            const auto& ids = program_sets[name];
+            for (size_t set = 0; set < ids.size(); ++set) {
+                if (set >= group_sets.size()) {
+                    group_sets.push_back(ids[set]);
+                }
+                else if (group_sets[set] != ids[set]) {
+                    first_incompatible[g] = std::min(first_incompatible[g], static_cast<uint32_t>(set));
+                }
+            }
+        }
+        if (push_constants_differ) {
+            first_incompatible[g] = 0;
+            log << "draw group " << g << ": push constants differ, every switch rebinds all sets." << std::endl;
+        }
+        else if (first_incompatible[g] != kNoSet) {
+            log << "draw group " << g << ": set " << first_incompatible[g]
+                << " layouts differ, every switch rebinds the sets from there on." << std::endl;
+        }
+    }
+
+    std::string out;
+    JsonWriter writer(out, false);
+    writer.beginObject();
+    writer.key("draw_groups");
+    writer.beginArray();
+    for (size_t g = 0; g < draw_groups.size(); ++g) {
+        writer.beginObject();
+        writer.key("compatible");
+        writer.value(first_incompatible[g] == kNoSet);
+        if (first_incompatible[g] != kNoSet) {
+            writer.key("first_incompatible_set");
+            writer.value(first_incompatible[g]);
+        }
+        writer.key("programs");
+        writer.beginArray();
+        for (const auto& name : draw_groups[g]) {
+            writer.value(name);
+        }
+        writer.endArray();
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.key("layouts");
+    writer.beginArray();
+    for (const auto& layout : canonical) {
+        writer.beginObject();
+        writer.key("bindings");
+        writer.beginArray();
+        for (const auto& binding : layout.bindings) {
+            writer.beginObject();
+            writer.key("binding");
+            writer.value(binding.binding);
+            writer.key("count");
+            writer.value(binding.count);
+            writer.key("type");
+            writer.value(binding.type);
+            writer.endObject();
+        }
+        writer.endArray();
+        writer.key("programs");
+        writer.value(layout.programs);
+        writer.key("stages");
+        writer.value(layout.stages);
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.key("programs");
+    writer.beginObject();
+    for (const auto& program : program_sets) {
+        writer.key(program.first);
+        writer.beginObject();
+        writer.key("sets");
+        writer.beginArray();
+        for (auto id : program.second) {
+            writer.value(id);
+        }
+        writer.endArray();
+        writer.endObject();
+    }
+    writer.endObject();
+    writer.key("sets");
+    writer.beginArray();
+    for (size_t set = 0; set < layouts_per_set.size(); ++set) {
+        writer.beginObject();
+        writer.key("layouts");
+        writer.value(static_cast<uint32_t>(layouts_per_set[set].size()));
+        writer.key("programs");
+        writer.value(programs_per_set[set]);
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+    return WriteFile(path, out);
+}
+
+bool LayoutPlanner::writePoolSizes(const std::string& path, const std::map<std::string, uint32_t>& instances) const {
+    std::vector<PoolSizes> sets;
+    PoolSizes total;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& program : m_programs) {
+            const uint32_t count = GetInstances(instances, program.first);
+            for (size_t set = 0; set < program.second.sets.size(); ++set) {
+                // A skipped set number is never allocated.
+                if (program.second.sets[set].empty()) {
+                    continue;
+                }
+                if (set >= sets.size()) {
+                    sets.resize(set + 1);
+                }
+                sets[set].add(program.second.sets[set], count);
+                total.add(program.second.sets[set], count);
+            }
+        }
+    }
+
+    std::string out;
+    JsonWriter writer(out, false);
+    writer.beginObject();
+    writer.key("sets");
+    writer.beginArray();
+    for (const auto& set : sets) {
+        WritePoolSizes(writer, set);
+    }
+    writer.endArray();
+    writer.key("total");
+    WritePoolSizes(writer, total);
+    writer.endObject();
+    return WriteFile(path, out);
+}
+
+bool LayoutPlanner::writePaddingReport(const std::string& path, const std::map<std::string, uint32_t>& update_rates,
+    std::ostream& log) const {
+    // A block shared by several programs is reported once.
+    std::map<BlockPadding, uint32_t> blocks;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& program : m_programs) {
+            for (const auto& block : program.second.blocks) {
+                ++blocks[block];
+            }
+        }
+    }
+
+    struct Entry {
+        const BlockPadding* p_block;
+        uint32_t programs;
+        uint32_t update_rate;
+        uint64_t score;
+    };
+    std::vector<Entry> entries;
+    uint64_t total_padding = 0;
+    for (const auto& block : blocks) {
+        const uint32_t update_rate = GetRate(update_rates, block.first.name);
+        entries.push_back({ &block.first, block.second, update_rate,
+            static_cast<uint64_t>(block.first.padding_bytes) * update_rate });
+        total_padding += block.first.padding_bytes;
+    }
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.score > b.score;
+    });
+    log << entries.size() << " uniform blocks, " << total_padding << " bytes of padding." << std::endl;
+
+    std::string out;
+    JsonWriter writer(out, false);
+    writer.beginArray();
+    for (const auto& entry : entries) {
+        writer.beginObject();
+        writer.key("block_size");
+        writer.value(entry.p_block->size);
+        writer.key("name");
+        writer.value(entry.p_block->name);
+        writer.key("padding_bytes");
+        writer.value(entry.p_block->padding_bytes);
+        writer.key("programs");
+        writer.value(entry.programs);
+        writer.key("score");
+        writer.value(entry.score);
+        if (entry.p_block->suggested_size > 0) {
+            writer.key("suggested_size");
+            writer.value(entry.p_block->suggested_size);
+        }
+        writer.key("update_rate");
+        writer.value(entry.update_rate);
+        writer.endObject();
+    }
+    writer.endArray();
+    return WriteFile(path, out);
+}
+
+bool LayoutPlanner::writePushConstantReport(const std::string& path, const std::map<std::string, uint32_t>& update_rates,
+    std::ostream& log) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string out;
+    JsonWriter writer(out, false);
+    writer.beginObject();
+    uint32_t candidate_count = 0;
+    for (const auto& program : m_programs) {
+        const uint32_t used = program.second.push_constant_bytes;
+        const bool over_limit = used > kGuaranteedPushConstantBytes;
+        if (over_limit) {
+            log << program.first << " uses " << used << " bytes of push constants, more than the "
+                << kGuaranteedPushConstantBytes << " every device supports." << std::endl;
+        }
+
+        std::vector<const BlockPadding*> blocks;
+        for (const auto& block : program.second.blocks) {
+            blocks.push_back(&block);
+        }
+        std::stable_sort(blocks.begin(), blocks.end(), [&](const BlockPadding* a, const BlockPadding* b) {
+            const uint32_t rate_a = GetRate(update_rates, a->name);
+            const uint32_t rate_b = GetRate(update_rates, b->name);
+            return rate_a > rate_b || (rate_a == rate_b && a->size < b->size);
+        });
+        // Promoted blocks go after the ranges in use, each 16-byte aligned
+        // as a std430 struct of vectors could need.
+        uint32_t end = AlignUp(used, 16);
+        std::vector<const BlockPadding*> candidates;
+        for (const auto* p_block : blocks) {
+            if (end + p_block->size <= kGuaranteedPushConstantBytes) {
+                candidates.push_back(p_block);
+                end = AlignUp(end + p_block->size, 16);
+            }
+        }
+        if (candidates.empty() && !over_limit) {
+            continue;
+        }
+        candidate_count += static_cast<uint32_t>(candidates.size());
+
+        writer.key(program.first);
+        writer.beginObject();
+        writer.key("candidates");
+        writer.beginArray();
+        uint32_t saved = 0;
+        for (const auto* p_block : candidates) {
+            const uint32_t buffer_bytes = AlignUp(p_block->size, kMaxUniformBufferAlignment);
+            saved += buffer_bytes;
+            writer.beginObject();
+            writer.key("block_size");
+            writer.value(p_block->size);
+            writer.key("buffer_bytes_per_draw");
+            writer.value(buffer_bytes);
+            writer.key("name");
+            writer.value(p_block->name);
+            writer.key("update_rate");
+            writer.value(GetRate(update_rates, p_block->name));
+            writer.endObject();
+        }
+        writer.endArray();
+        writer.key("over_limit");
+        writer.value(over_limit);
+        writer.key("push_constant_bytes");
+        writer.value(used);
+        writer.key("saved_bytes_per_draw");
+        writer.value(saved);
+        writer.endObject();
+    }
+    writer.endObject();
+    log << candidate_count << " uniform blocks could be push constants." << std::endl;
+    return WriteFile(path, out);
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <tuple>
+#include <cstdint>
+#include "reflection.h"
+
+// Looks at the descriptor set layouts of every program of a batch at once.
+// A set layout is its bindings; layouts that are identical, or contained
+// in a larger one, share one canonical layout, so the runtime creates a
+// single VkDescriptorSetLayout for all of them. Programs drawn together
+// are checked for pipeline layout compatibility: a bound set survives a
+// pipeline switch only while push constants and every set up to it have
+// the same layouts. The padding of uniform blocks is ranked over the
+// batch too, and small uniform blocks that would fit in push constants
+// are pointed out. Thread-safe.
+class LayoutPlanner {
+public:
+    struct Binding {
+        uint32_t binding;
+        // VkDescriptorType
+        uint32_t type;
+        uint32_t count;
+
+        bool operator<(const Binding& other) const {
+            return std::tie(binding, type, count) < std::tie(other.binding, other.type, other.count);
+        }
+        bool operator==(const Binding& other) const {
+            return binding == other.binding && type == other.type && count == other.count;
+        }
+    };
+    // Sorted by binding.
+    using SetLayout = std::vector<Binding>;
+
+    // stages are the VkShaderStageFlags of the program.
+    void add(const std::string& program, const ProgramReflection& reflection, uint32_t stages);
+
+    // Writes the shared layout table and the findings to path, and the
+    // findings to log too. draw_groups name programs drawn together.
+    bool writeFile(const std::string& path, const std::vector<std::vector<std::string>>& draw_groups,
+        std::ostream& log) const;
+    // Writes the VkDescriptorPoolSize table of every set number, and of all
+    // of them together, for instances of each program allocating their
+    // sets at the same time. A permutation ("name#permutation") without
+    // an entry of its own takes the count of its program; the default is 1.
+    bool writePoolSizes(const std::string& path, const std::map<std::string, uint32_t>& instances) const;
+    // Writes the uniform blocks of the batch, those with the most padding
+    // bytes times their update rate (by block name, 1 by default) first.
+    bool writePaddingReport(const std::string& path, const std::map<std::string, uint32_t>& update_rates,
+        std::ostream& log) const;
+    // Writes, for every program, the push constant bytes it uses against
+    // the 128 every device supports, and the uniform blocks that fit in
+    // what is left, the most often updated (see writePaddingReport) first.
+    bool writePushConstantReport(const std::string& path, const std::map<std::string, uint32_t>& update_rates,
+        std::ostream& log) const;
+
+private:
+    struct BlockPadding {
+        std::string name;
+        uint32_t size;
+        uint32_t padding_bytes;
+        // 0 when the declared order is the best one found.
+        uint32_t suggested_size;
+
+        bool operator<(const BlockPadding& other) const {
+            return std::tie(name, size, padding_bytes, suggested_size) <
+                std::tie(other.name, other.size, other.padding_bytes, other.suggested_size);
+        }
+    };
+
+    struct Program {
+        // Indexed by set; sets a program skips are empty layouts.
+        std::vector<SetLayout> sets;
+        // (stage, block size) of every push constant block, sorted.
+        std::vector<std::pair<uint32_t, uint32_t>> push_constants;
+        uint32_t stages = 0;
+        std::vector<BlockPadding> blocks;
+        // The end of the last push constant range.
+        uint32_t push_constant_bytes = 0;
+    };
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Program> m_programs;
+};
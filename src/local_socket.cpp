@@ -0,0 +1,146 @@
+#include <cstring>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include "local_socket.h"
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifdef _WIN32
+const int kShutdownBoth = SD_BOTH;
+
+void InitializeSockets() {
+    static std::once_flag initialized;
+    std::call_once(initialized, []() {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+            throw std::runtime_error("Winsock can not be initialized.");
+        }
+    });
+}
+
+void CloseSocketHandle(LocalSocket::Handle handle) {
+    closesocket(static_cast<SOCKET>(handle));
+}
+#else
+const int kShutdownBoth = SHUT_RDWR;
+
+void InitializeSockets() {
+
+}
+
+void CloseSocketHandle(LocalSocket::Handle handle) {
+    ::close(handle);
+}
+#endif
+
+sockaddr_un MakeAddress(const std::string& path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("socket path " + path + " is too long.");
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+    return address;
+}
+}
+
+#ifdef _WIN32
+const LocalSocket::Handle LocalSocket::kInvalidHandle = INVALID_SOCKET;
+#else
+const LocalSocket::Handle LocalSocket::kInvalidHandle = -1;
+#endif
+
+LocalSocket::LocalSocket(LocalSocket&& other) : m_handle(other.m_handle) {
+    other.m_handle = kInvalidHandle;
+}
+
+LocalSocket& LocalSocket::operator=(LocalSocket&& other) {
+    if (this != &other) {
+        close();
+        m_handle = other.m_handle;
+        other.m_handle = kInvalidHandle;
+    }
+    return *this;
+}
+
+LocalSocket LocalSocket::listen(const std::string& path) {
+    InitializeSockets();
+    auto address = MakeAddress(path);
+    LocalSocket result(::socket(AF_UNIX, SOCK_STREAM, 0));
+    if (!result.isValid()) {
+        throw std::runtime_error("socket can not be created.");
+    }
+    // A previous server that did not shut down cleanly leaves the file behind.
+    std::remove(path.c_str());
+    if (::bind(result.m_handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(result.m_handle, SOMAXCONN) != 0) {
+        throw std::runtime_error("socket " + path + " can not be bound.");
+    }
+    return result;
+}
+
+LocalSocket LocalSocket::connect(const std::string& path) {
+    InitializeSockets();
+    auto address = MakeAddress(path);
+    LocalSocket result(::socket(AF_UNIX, SOCK_STREAM, 0));
+    if (!result.isValid()) {
+        throw std::runtime_error("socket can not be created.");
+    }
+    if (::connect(result.m_handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        throw std::runtime_error("server " + path + " can not be reached.");
+    }
+    return result;
+}
+
+LocalSocket LocalSocket::accept() {
+    return LocalSocket(::accept(m_handle, nullptr, nullptr));
+}
+
+bool LocalSocket::sendAll(const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        auto sent = ::send(m_handle, bytes, static_cast<int>(size), 0);
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool LocalSocket::receiveAll(void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        auto received = ::recv(m_handle, bytes, static_cast<int>(size), 0);
+        if (received <= 0) {
+            return false;
+        }
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+void LocalSocket::shutdown() {
+    if (isValid()) {
+        ::shutdown(m_handle, kShutdownBoth);
+    }
+}
+
+void LocalSocket::close() {
+    if (isValid()) {
+        CloseSocketHandle(m_handle);
+        m_handle = kInvalidHandle;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// A stream socket on a local (AF_UNIX) address. Windows provides AF_UNIX
+// through Winsock since Windows 10 1803.
+class LocalSocket {
+public:
+#ifdef _WIN32
+    using Handle = uintptr_t;
+#else
+    using Handle = int;
+#endif
+
+    LocalSocket() = default;
+    LocalSocket(const LocalSocket&) = delete;
+    LocalSocket& operator=(const LocalSocket&) = delete;
+    LocalSocket(LocalSocket&& other);
+    LocalSocket& operator=(LocalSocket&& other);
+    ~LocalSocket() { close(); }
+
+    // Both throw std::runtime_error on failure.
+    static LocalSocket listen(const std::string& path);
+    static LocalSocket connect(const std::string& path);
+
+    // Returns an invalid socket once the listening socket is closed.
+    LocalSocket accept();
+
+    bool sendAll(const void* data, size_t size);
+    // Returns false on error or when the peer closed the connection.
+    bool receiveAll(void* data, size_t size);
+
+    // Wakes up a thread blocked in accept() or receiveAll() on this socket.
+    void shutdown();
+    void close();
+    bool isValid() const { return m_handle != kInvalidHandle; }
+
+private:
+    static const Handle kInvalidHandle;
+
+    explicit LocalSocket(Handle handle) : m_handle(handle) {}
+
+    Handle m_handle = kInvalidHandle;
+};
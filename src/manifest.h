@@ -0,0 +1,89 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <stdexcept>
+#include <json.hpp>
+#include "config.h"
+
+// A batch of programs compiled in one process. Each entry of "programs" is
+// either the path of an input.conf-style file or the config object itself.
+//
+// {
+//     "jobs": 32,
+//     "max_memory_mb": 8192,
+//     "programs": [ "a/input.conf", { "sources": { ... } } ],
+//     "draw_groups": [ [ "a.spv", "b.spv" ] ],
+//     "instances": { "a.spv": 64 },
+//     "update_rates": { "Lights": 60 }
+// }
+//
+// "draw_groups" and "instances" name programs by their config's "name"
+// (the "spv" path by default). Each draw group lists programs usually
+// drawn together, whose pipeline layouts --layout-table checks for
+// compatibility; "instances" are the descriptor sets each program
+// allocates at once, for --pool-sizes. "update_rates" weigh the padding
+// of uniform blocks, by block name, for --padding-report and
+// --push-constant-report.
+class Manifest {
+public:
+    struct Program {
+        // The config path, or "programs[<index>]" for inline configs.
+        std::string name;
+        nlohmann::json config;
+    };
+
+    Manifest() = delete;
+
+    Manifest(const std::string& filepath) {
+        using JSON = nlohmann::json;
+        JSON json = Config::LoadJSON(filepath);
+
+        if (json.count("programs") == 0 || !json["programs"].is_array()) {
+            throw std::runtime_error("programs must exists.");
+        }
+
+        if (json.count("jobs") > 0) {
+            jobs = json["jobs"].get<uint32_t>();
+        }
+        if (json.count("max_memory_mb") > 0) {
+            max_memory_mb = json["max_memory_mb"].get<uint32_t>();
+        }
+        if (json.count("draw_groups") > 0) {
+            draw_groups = json["draw_groups"].get<std::vector<std::vector<std::string>>>();
+        }
+        if (json.count("instances") > 0) {
+            instances = json["instances"].get<std::map<std::string, uint32_t>>();
+        }
+        if (json.count("update_rates") > 0) {
+            update_rates = json["update_rates"].get<std::map<std::string, uint32_t>>();
+        }
+
+        const auto& programs = json["programs"];
+        for (size_t i = 0; i < programs.size(); ++i) {
+            Program program;
+            if (programs[i].is_string()) {
+                program.name = programs[i].get<std::string>();
+            }
+            else {
+                program.name = "programs[" + std::to_string(i) + "]";
+                program.config = programs[i];
+            }
+            m_programs.push_back(program);
+        }
+    }
+
+    Manifest(const std::vector<Program>& programs) : m_programs(programs) {
+
+    }
+
+    const std::vector<Program>& getPrograms() const { return m_programs; }
+
+    uint32_t jobs = 0;
+    uint32_t max_memory_mb = 0;
+    std::vector<std::vector<std::string>> draw_groups;
+    std::map<std::string, uint32_t> instances;
+    std::map<std::string, uint32_t> update_rates;
+private:
+    std::vector<Program> m_programs;
+};
@@ -0,0 +1,199 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+class Options {
+public:
+    Options() = delete;
+
+    Options(int argc, char** argv) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg(argv[i]);
+            if (arg == "--batch") {
+                manifest_path = nextArgument(argc, argv, i);
+            }
+            else if (arg == "--server") {
+                server_path = nextArgument(argc, argv, i);
+            }
+            else if (arg == "--watch") {
+                watch = true;
+            }
+            else if (arg == "-j" || arg == "--jobs") {
+                jobs = parseCount(nextArgument(argc, argv, i));
+            }
+            else if (arg == "--max-memory") {
+                max_memory_mb = parseCount(nextArgument(argc, argv, i));
+            }
+            else if (arg == "--cache") {
+                cache_path = nextArgument(argc, argv, i);
+            }
+            else if (arg == "--cache-size") {
+                cache_size_mb = parseCount(nextArgument(argc, argv, i));
+            }
+            else if (arg == "--archive") {
+                archive_path = nextArgument(argc, argv, i);
+            }
+            else if (arg == "--strip-spirv") {
+                strip_spirv = true;
+            }
+            else if (arg == "--spirv-encoding") {
+                spirv_encoding = nextArgument(argc, argv, i);
+            }
+            else if (arg == "--trace") {
+                trace_path = nextArgument(argc, argv, i);
+            }
+            else if (arg == "--trace-summary") {
+                trace_summary = parseCount(nextArgument(argc, argv, i));
+            }
+            else if (arg == "--codec-benchmark") {
+                codec_benchmark = true;
+            }
+            else if (arg == "--layout-table") {
+                layout_table_path = nextArgument(argc, argv, i);
+            }
+            else if (arg == "--pool-sizes") {
+                pool_sizes_path = nextArgument(argc, argv, i);
+            }
+            else if (arg == "--padding-report") {
+                padding_report_path = nextArgument(argc, argv, i);
+            }
+            else if (arg == "--push-constant-report") {
+                push_constant_report_path = nextArgument(argc, argv, i);
+            }
+            else if (arg == "--cpp-headers") {
+                cpp_headers = true;
+            }
+            else if (arg == "--depfiles") {
+                depfiles = true;
+            }
+            else if (arg == "--descriptor-format") {
+                descriptor_format = nextArgument(argc, argv, i);
+            }
+            else if (!arg.empty() && arg[0] == '-') {
+                throw std::runtime_error("unknown option " + arg + ".");
+            }
+            else if (codec_benchmark) {
+                benchmark_paths.push_back(arg);
+            }
+            else if (config_path.empty()) {
+                config_path = arg;
+            }
+            else {
+                throw std::runtime_error("only one config can be specified.");
+            }
+        }
+
+        if (codec_benchmark) {
+            if (benchmark_paths.empty() || !config_path.empty() || isBatch() || isServer()) {
+                throw std::runtime_error("--codec-benchmark takes .sr files only.");
+            }
+            return;
+        }
+        int mode_count = !config_path.empty() + !manifest_path.empty() + !server_path.empty();
+        if (mode_count != 1) {
+            throw std::runtime_error("exactly one of a config, --batch or --server must be specified.");
+        }
+        if (!spirv_encoding.empty() && spirv_encoding != "raw" && spirv_encoding != "compact" && spirv_encoding != "entropy") {
+            throw std::runtime_error("--spirv-encoding must be raw, compact or entropy.");
+        }
+        if (!descriptor_format.empty() && descriptor_format != "json" && descriptor_format != "compact" &&
+            descriptor_format != "binary") {
+            throw std::runtime_error("--descriptor-format must be json, compact or binary.");
+        }
+        if (cpp_headers && isServer()) {
+            throw std::runtime_error("--cpp-headers can not be used with --server.");
+        }
+        if (depfiles && (!archive_path.empty() || isServer())) {
+            throw std::runtime_error("--depfiles can not be used with --archive or --server.");
+        }
+        if (!archive_path.empty() && isServer()) {
+            throw std::runtime_error("--archive can not be used with --server.");
+        }
+        if ((!trace_path.empty() || trace_summary > 0) && (watch || isServer())) {
+            throw std::runtime_error("--trace and --trace-summary need a config or a --batch manifest without --watch.");
+        }
+        if (isPlanningLayouts() && (!isBatch() || watch)) {
+            throw std::runtime_error("--layout-table, --pool-sizes, --padding-report and --push-constant-report "
+                "need a --batch manifest without --watch.");
+        }
+        if (watch && isServer()) {
+            throw std::runtime_error("--watch needs a config or a --batch manifest.");
+        }
+    }
+
+    bool isBatch() const { return !manifest_path.empty(); }
+    bool isServer() const { return !server_path.empty(); }
+    bool isPlanningLayouts() const {
+        return !layout_table_path.empty() || !pool_sizes_path.empty() || !padding_report_path.empty() ||
+            !push_constant_report_path.empty();
+    }
+
+    static const char* usage() {
+        return
+            "ShaderRetriever [--watch] <config> [-j <jobs>]\n"
+            "ShaderRetriever [--watch] --batch <manifest> [-j <jobs>] [--max-memory <MB>]\n"
+            "ShaderRetriever --server <socket path> [-j <jobs>]\n"
+            "ShaderRetriever --codec-benchmark <file.sr>...\n"
+            "options:\n"
+            "  --watch                            recompile programs whose sources change until stopped\n"
+            "  --cache <directory>                reuse compiled programs whose inputs did not change\n"
+            "  --cache-size <MB>                  evict least recently used cache entries above this size\n"
+            "  --descriptor-format <json|compact|binary>\n"
+            "                                     format of every .sd, overriding the configs\n"
+            "  --cpp-headers                      also write every program as a C++ header embedding SPIR-V and reflection\n"
+            "  --depfiles                         write a Make/Ninja depfile of its sources and includes with every .sd\n"
+            "  --archive <file>                   add or update the programs in one packed archive\n"
+            "  --layout-table <file>              unify the set layouts of a batch into one shared table\n"
+            "  --pool-sizes <file>                descriptor pool sizes for the manifest's instance counts\n"
+            "  --padding-report <file>            rank uniform blocks by padding bytes times update rate\n"
+            "  --push-constant-report <file>      push constant use, and uniform blocks that would fit there\n"
+            "  --trace <file>                     record every phase of every program as a Chrome trace\n"
+            "  --trace-summary <N>                print the N slowest programs and phases at the end\n"
+            "  --strip-spirv                      strip debug info and unused declarations, renumber IDs\n"
+            "  --spirv-encoding <raw|compact|entropy>\n"
+            "                                     encoding of every .sr, compact ones are read with CsDecode()";
+    }
+
+    std::string config_path;
+    std::string manifest_path;
+    std::string server_path;
+    bool watch = false;
+    // 0 means "take it from the manifest, or the hardware concurrency".
+    uint32_t jobs = 0;
+    uint32_t max_memory_mb = 0;
+    std::string cache_path;
+    uint32_t cache_size_mb = 1024;
+    std::string descriptor_format;
+    bool depfiles = false;
+    bool cpp_headers = false;
+    std::string archive_path;
+    std::string layout_table_path;
+    std::string pool_sizes_path;
+    std::string padding_report_path;
+    std::string push_constant_report_path;
+    bool strip_spirv = false;
+    std::string spirv_encoding;
+    std::string trace_path;
+    uint32_t trace_summary = 0;
+    bool codec_benchmark = false;
+    std::vector<std::string> benchmark_paths;
+
+private:
+    static std::string nextArgument(int argc, char** argv, int& i) {
+        if (i + 1 >= argc) {
+            throw std::runtime_error(std::string(argv[i]) + " requires an argument.");
+        }
+        return argv[++i];
+    }
+
+    static uint32_t parseCount(const std::string& value) {
+        try {
+            return static_cast<uint32_t>(std::stoul(value));
+        }
+        catch (std::exception&) {
+            throw std::runtime_error("invalid number " + value + ".");
+        }
+    }
+};
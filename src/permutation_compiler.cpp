@@ -0,0 +1,237 @@
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <ShaderLang.h>
+#include "permutation_compiler.h"
+#include "config.h"
+#include "spv_program.h"
+#include "shader_descriptor.h"
+#include "shader_archive_writer.h"
+#include "sha256.h"
+#include "include_cache.h"
+#include "cpp_header.h"
+#include "batch_compiler.h"
+
+namespace {
+// Hashes the preprocessed text of every stage, so permutations whose
+// defines make no difference end up with the same key.
+bool PreprocessedKey(Config& config, const std::vector<std::vector<ShaderSource>>& stage_sources,
+    IncludeCache* p_include_cache, std::string& key, std::ostream& log) {
+    const auto& stages = config.getStages();
+    Sha256 hash;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const auto sh_stage = VKStageFlagToEShStage(stages[i]);
+        glslang::TShader shader(sh_stage);
+        std::vector<const char*> c_srcs;
+        std::vector<int> lengths;
+        for (const auto& source : stage_sources[i]) {
+            c_srcs.push_back(source.data);
+            lengths.push_back(static_cast<int>(source.size));
+        }
+        shader.setStringsWithLengths(c_srcs.data(), lengths.data(), static_cast<int>(c_srcs.size()));
+        shader.setPreamble(config.shaderPreambles[stages[i]].c_str());
+        shader.setEntryPoint(config.shaderEntrys[stages[i]].c_str());
+
+        std::string preprocessed;
+        ShaderIncluder includer(p_include_cache, config.getIncludePaths(), config.shaderFilepaths[stages[i]]);
+        if (!PreprocessShader(&shader, sh_stage, config, preprocessed, log, &includer)) {
+            return false;
+        }
+        hash.updateValue(static_cast<uint32_t>(stages[i]));
+        hash.update(config.shaderEntrys[stages[i]]);
+        hash.updateValue(static_cast<uint64_t>(preprocessed.size()));
+        hash.update(preprocessed);
+    }
+    key = Sha256::toHex(hash.finish());
+    return true;
+}
+
+std::string ModuleKey(VkShaderStageFlagBits stage, const std::vector<unsigned int>& spirv) {
+    Sha256 hash;
+    hash.updateValue(static_cast<uint32_t>(stage));
+    hash.update(spirv.data(), spirv.size() * sizeof(unsigned int));
+    return Sha256::toHex(hash.finish());
+}
+}
+
+bool CompilePermutations(Config& config, const CompileContext& context, std::ostream& log) {
+    const auto permutations = config.getPermutations();
+    std::vector<std::vector<ShaderSource>> stage_sources;
+    if (!LoadProgramSources(config, context.p_include_cache, stage_sources, log)) {
+        return false;
+    }
+
+    std::vector<std::unique_ptr<Config>> configs;
+    std::map<std::string, size_t> first_with_key;
+    // The permutation whose build each one uses: itself, or the first one
+    // with the same preprocessed text.
+    std::vector<size_t> built_by(permutations.size());
+    std::vector<size_t> builds;
+    for (size_t i = 0; i < permutations.size(); ++i) {
+        configs.emplace_back(new Config(config));
+        configs[i]->setPermutation(permutations[i], i);
+
+        std::string key;
+        if (!PreprocessedKey(*configs[i], stage_sources, context.p_include_cache, key, log)) {
+            log << config.getName() << " failed to preprocess " << permutations[i].name << std::endl;
+            return false;
+        }
+        auto first = first_with_key.emplace(key, i);
+        built_by[i] = first.first->second;
+        if (first.second) {
+            builds.push_back(i);
+        }
+    }
+
+    std::vector<CompiledProgram> compiled(permutations.size());
+    std::vector<std::ostringstream> logs(builds.size());
+    std::vector<char> succeeded(builds.size(), 0);
+    std::atomic<size_t> next_build(0);
+    auto work = [&]() {
+        for (size_t b = next_build++; b < builds.size(); b = next_build++) {
+            const size_t i = builds[b];
+            try {
+                succeeded[b] = BuildProgram(*configs[i], context, compiled[i], logs[b]);
+            }
+            catch (std::exception& error) {
+                logs[b] << error.what() << std::endl;
+            }
+        }
+    };
+    // This thread builds too, on the job slot and memory its caller holds;
+    // each helper takes an idle slot and the memory of one build, and is
+    // not started when either is short.
+    const uint64_t helper_memory = EstimateCompileMemory(config);
+    std::vector<std::thread> helpers;
+    while (context.p_job_slots != nullptr && helpers.size() + 1 < builds.size() &&
+        context.p_job_slots->tryAcquire()) {
+        if (context.p_memory_budget != nullptr && !context.p_memory_budget->tryAcquire(helper_memory)) {
+            context.p_job_slots->release();
+            break;
+        }
+        helpers.emplace_back([&]() {
+            glslang::InitializeProcess();
+            work();
+            glslang::FinalizeProcess();
+            if (context.p_memory_budget != nullptr) {
+                context.p_memory_budget->release(helper_memory);
+            }
+            context.p_job_slots->release();
+        });
+    }
+    work();
+    for (auto& helper : helpers) {
+        helper.join();
+    }
+
+    bool all_succeeded = true;
+    for (size_t b = 0; b < builds.size(); ++b) {
+        log << logs[b].str();
+        if (!succeeded[b]) {
+            log << config.getName() << " failed to compile " << permutations[builds[b]].name << std::endl;
+            all_succeeded = false;
+        }
+    }
+    if (!all_succeeded) {
+        return false;
+    }
+
+    std::map<std::string, std::string> module_paths;
+    std::map<std::string, uint32_t> layout_indices;
+    std::vector<ProgramReflection> layouts;
+    std::vector<DescriptorPermutation> descriptor_permutations(permutations.size());
+    for (size_t i = 0; i < permutations.size(); ++i) {
+        const auto& program = compiled[built_by[i]];
+        auto& permutation = descriptor_permutations[i];
+        permutation.name = permutations[i].name;
+        permutation.defines.insert(permutations[i].defines.begin(), permutations[i].defines.end());
+        if (built_by[i] != i) {
+            permutation.alias_of = static_cast<uint32_t>(built_by[i]);
+        }
+
+        for (auto stage : config.getStages()) {
+            const auto& spirv = program.spirv.at(stage);
+            auto module = module_paths.emplace(ModuleKey(stage, spirv), configs[i]->getShaderBinFilename(stage));
+            if (module.second && context.p_archive == nullptr &&
+                !WriteSpirvFile(module.first->second, spirv, context)) {
+                log << module.first->second << " can not be written!" << std::endl;
+                return false;
+            }
+            permutation.spvs[module.first->second] = stage;
+        }
+        permutation.hashes = HashProgram(permutation.spvs, program.spirv, program.reflection);
+
+        permutation.costs = program.reflection.costs;
+        auto layout_reflection = program.reflection;
+        layout_reflection.costs.clear();
+        const auto layout = layout_indices.emplace(SerializeReflection(layout_reflection),
+            static_cast<uint32_t>(layouts.size()));
+        if (layout.second) {
+            layouts.push_back(layout_reflection);
+        }
+        permutation.layout = layout.first->second;
+        PlanLayouts(*configs[i], context, program.reflection);
+
+        if (context.p_archive != nullptr) {
+            ShaderDescriptor shader_descriptor;
+            shader_descriptor.loadReflection(program.reflection, *configs[i]);
+            shader_descriptor.hashModules(program.spirv);
+            context.p_archive->put(configs[i]->getName(), program.spirv, shader_descriptor.toBinary());
+        }
+    }
+    log << config.getName() << ": " << permutations.size() << " permutations, " << builds.size() << " compiled, "
+        << module_paths.size() << " modules, " << layouts.size() << " layouts" << std::endl;
+    if (context.write_cpp_headers) {
+        // One namespace per permutation, p<index> as in the .sd; one built
+        // by another permutation is a namespace alias of that one.
+        CppHeaderWriter writer(config.getName(), config.getName());
+        for (size_t i = 0; i < permutations.size(); ++i) {
+            const auto sub_namespace = "p" + std::to_string(i);
+            if (built_by[i] != i) {
+                writer.addAlias(sub_namespace, "p" + std::to_string(built_by[i]), permutations[i].name);
+            }
+            else {
+                writer.addProgram(sub_namespace, permutations[i].name, compiled[i].spirv, configs[i]->shaderEntrys,
+                    compiled[i].reflection);
+            }
+        }
+        if (!WriteCppHeader(config.getHeaderFilename(), writer, context, log)) {
+            return false;
+        }
+    }
+    if (context.p_archive != nullptr) {
+        return true;
+    }
+
+    // The first permutation's modules are always its own, so its .sd is
+    // the one a config without defines would have had.
+    if (!context.descriptor_format.empty()) {
+        config.setDescriptorFormat(context.descriptor_format);
+    }
+    ShaderDescriptor shader_descriptor;
+    shader_descriptor.loadReflection(compiled[0].reflection, *configs[0]);
+    shader_descriptor.hashModules(compiled[0].spirv);
+    shader_descriptor.setPermutations(descriptor_permutations, layouts);
+    if (config.isBinaryDescriptor()) {
+        shader_descriptor.writeBinaryFile(config.getShaderDescriptorFilename(), context.keep_unchanged_outputs);
+    }
+    else {
+        shader_descriptor.writeFile(config.getShaderDescriptorFilename(), context.keep_unchanged_outputs,
+            config.isCompactDescriptor());
+    }
+    if (context.write_depfiles) {
+        // Defines may include different files in each permutation.
+        std::set<std::string> dependencies;
+        for (auto b : builds) {
+            dependencies.insert(compiled[b].dependencies.begin(), compiled[b].dependencies.end());
+        }
+        if (!WriteDepfile(config.getDepfileFilename(), config.getShaderDescriptorFilename(), dependencies,
+            context.keep_unchanged_outputs)) {
+            log << config.getDepfileFilename() << " can not be written!" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
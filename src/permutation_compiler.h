@@ -0,0 +1,14 @@
+#pragma once
+#include <ostream>
+#include <iostream>
+#include "program_compiler.h"
+
+class Config;
+
+// Compiles every permutation of the config's define matrix. Permutations
+// whose preprocessed stages are identical are built once, the others
+// concurrently on the job slots the context has idle; identical SPIR-V modules are written once, named after the
+// first permutation producing them. The .sd describes the first
+// permutation as usual, and lists under "permutations" the defines, the
+// .sr files and the index into "layouts" of every permutation.
+bool CompilePermutations(Config& config, const CompileContext& context, std::ostream& log = std::cout);
@@ -0,0 +1,376 @@
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <memory>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <ShaderLang.h>
+#include <GlslangToSpv.h>
+#include <json.hpp>
+#include "phase_benchmark.h"
+#include "shader_generator.h"
+#include "config.h"
+#include "spv_program.h"
+#include "shader_descriptor.h"
+#include "program_compiler.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+const double kMinBenchmarkSeconds = 0.2;
+// A phase this much slower than its baseline is timer noise, not a
+// regression.
+const double kMinRegressionSeconds = 1e-6;
+const uint32_t kScales[] = { 1, 4, 16 };
+
+// Allocations made by the current thread so far, see operator new below.
+thread_local uint64_t t_allocations = 0;
+
+enum Phase {
+    kParse,
+    kLink,
+    kMapIO,
+    kBuildReflection,
+    kDescriptor,
+    kGlslangToSpv,
+    kWrite,
+    kPhaseCount
+};
+
+const char* const kPhaseNames[kPhaseCount] = {
+    "parse", "link", "mapIO", "buildReflection", "descriptor", "GlslangToSpv", "write"
+};
+
+struct PhaseResult {
+    double seconds = 0.0;
+    uint64_t allocations = 0;
+};
+
+struct CaseResult {
+    std::string name;
+    size_t iterations = 0;
+    PhaseResult phases[kPhaseCount];
+};
+
+// Adds the time and the allocations of its scope to a phase.
+class PhaseTimer {
+public:
+    explicit PhaseTimer(PhaseResult& result) :
+        m_result(result), m_allocations(t_allocations), m_begin(Clock::now()) {}
+    ~PhaseTimer() {
+        const std::chrono::duration<double> elapsed = Clock::now() - m_begin;
+        m_result.seconds += elapsed.count();
+        m_result.allocations += t_allocations - m_allocations;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    PhaseResult& m_result;
+    uint64_t m_allocations;
+    Clock::time_point m_begin;
+};
+
+struct BenchmarkCase {
+    std::string name;
+    SyntheticShaderParams params;
+};
+
+// Every size on its own at every scale, then all of them at once.
+std::vector<BenchmarkCase> MakeCases() {
+    const std::pair<const char*, uint32_t SyntheticShaderParams::*> sizes[] = {
+        { "uniform_blocks", &SyntheticShaderParams::uniform_blocks },
+        { "samplers", &SyntheticShaderParams::samplers },
+        { "attributes", &SyntheticShaderParams::attributes },
+        { "struct_depth", &SyntheticShaderParams::struct_depth },
+        { "loops", &SyntheticShaderParams::loops },
+        { "includes", &SyntheticShaderParams::includes },
+    };
+    std::vector<BenchmarkCase> cases;
+    for (const auto& size : sizes) {
+        for (auto scale : kScales) {
+            BenchmarkCase benchmark_case;
+            benchmark_case.name = std::string(size.first) + "=" + std::to_string(scale);
+            benchmark_case.params.*size.second = scale;
+            cases.push_back(benchmark_case);
+        }
+    }
+    for (auto scale : kScales) {
+        BenchmarkCase benchmark_case;
+        benchmark_case.name = "all=" + std::to_string(scale);
+        for (const auto& size : sizes) {
+            benchmark_case.params.*size.second = scale;
+        }
+        cases.push_back(benchmark_case);
+    }
+    return cases;
+}
+
+std::string Join(const std::vector<std::string>& sources) {
+    std::string joined;
+    for (const auto& source : sources) {
+        joined += source;
+    }
+    return joined;
+}
+
+// Only names the stages and the outputs; the sources are handed to glslang
+// as the separate strings the generator made.
+nlohmann::json MakeConfig(const SyntheticProgram& program, const std::string& directory) {
+    nlohmann::json config;
+    config["sources"]["vertex"]["path"] = "synthetic.vert";
+    config["sources"]["vertex"]["source"] = Join(program.vertex);
+    config["sources"]["fragment"]["path"] = "synthetic.frag";
+    config["sources"]["fragment"]["source"] = Join(program.fragment);
+    config["vulkan_define"] = true;
+    config["spv"] = (fs::path(directory) / "synthetic").string();
+    config["descriptor"] = (fs::path(directory) / "synthetic.sd").string();
+    return config;
+}
+
+bool CheckProgram(bool succeeded, glslang::TProgram& program, std::ostream& log) {
+    if (!succeeded) {
+        log << program.getInfoLog() << std::endl;
+        log << program.getInfoDebugLog() << std::endl;
+    }
+    return succeeded;
+}
+
+// The steps of BuildProgram and WriteProgram, each phase timed on its own.
+bool CompileOnce(Config& config, const SyntheticProgram& synthetic, CaseResult& result, std::ostream& log) {
+    const auto& stages = config.getStages();
+    std::vector<std::unique_ptr<glslang::TShader>> p_shaders(stages.size());
+    {
+        PhaseTimer timer(result.phases[kParse]);
+        for (size_t i = 0; i < stages.size(); ++i) {
+            const auto sh_stage = VKStageFlagToEShStage(stages[i]);
+            const auto& sources = stages[i] == VK_SHADER_STAGE_VERTEX_BIT ? synthetic.vertex : synthetic.fragment;
+            std::vector<const char*> c_srcs;
+            for (const auto& s : sources) {
+                c_srcs.push_back(s.c_str());
+            }
+            p_shaders[i].reset(new glslang::TShader(sh_stage));
+            p_shaders[i]->setStrings(c_srcs.data(), static_cast<int>(c_srcs.size()));
+            p_shaders[i]->setEntryPoint(config.shaderEntrys[stages[i]].c_str());
+            if (!ConfigureShader(p_shaders[i].get(), sh_stage, config, log)) {
+                return false;
+            }
+        }
+    }
+
+    glslang::TProgram program;
+    for (auto& p_shader : p_shaders) {
+        program.addShader(p_shader.get());
+    }
+    {
+        PhaseTimer timer(result.phases[kLink]);
+        if (!CheckProgram(program.link(config.getMessages()), program, log)) {
+            return false;
+        }
+    }
+    {
+        PhaseTimer timer(result.phases[kMapIO]);
+        if (!CheckProgram(program.mapIO(), program, log)) {
+            return false;
+        }
+    }
+    {
+        PhaseTimer timer(result.phases[kBuildReflection]);
+        if (!CheckProgram(program.buildReflection(), program, log)) {
+            return false;
+        }
+    }
+
+    ShaderDescriptor shader_descriptor;
+    {
+        PhaseTimer timer(result.phases[kDescriptor]);
+        shader_descriptor.buildPushConstants(program, config);
+        shader_descriptor.processProgram(program, config);
+    }
+
+    std::map<VkShaderStageFlagBits, std::vector<unsigned int>> spirv;
+    {
+        PhaseTimer timer(result.phases[kGlslangToSpv]);
+        for (auto stage : stages) {
+            glslang::GlslangToSpv(*program.getIntermediate(VKStageFlagToEShStage(stage)), spirv[stage]);
+        }
+    }
+
+    {
+        PhaseTimer timer(result.phases[kWrite]);
+        for (auto stage : stages) {
+            if (!WriteSpirvFile(config.getShaderBinFilename(stage), spirv[stage], CompileContext())) {
+                log << config.getShaderBinFilename(stage) << " can not be written!" << std::endl;
+                return false;
+            }
+        }
+        shader_descriptor.writeFile(config.getShaderDescriptorFilename());
+    }
+    return true;
+}
+
+bool RunCase(const BenchmarkCase& benchmark_case, const std::string& directory, CaseResult& result, std::ostream& log) {
+    const auto synthetic = GenerateSyntheticProgram(benchmark_case.params);
+    Config config(MakeConfig(synthetic, directory));
+    result.name = benchmark_case.name;
+
+    // One untimed compile first, so one-off initialization is not counted.
+    CaseResult warm_up;
+    if (!CompileOnce(config, synthetic, warm_up, log)) {
+        return false;
+    }
+    double seconds = 0.0;
+    do {
+        if (!CompileOnce(config, synthetic, result, log)) {
+            return false;
+        }
+        ++result.iterations;
+        seconds = 0.0;
+        for (const auto& phase : result.phases) {
+            seconds += phase.seconds;
+        }
+    } while (seconds < kMinBenchmarkSeconds);
+    return true;
+}
+
+void WriteCase(std::ostream& out, const CaseResult& result) {
+    double seconds = 0.0;
+    for (const auto& phase : result.phases) {
+        seconds += phase.seconds;
+    }
+    out << result.name << ": " << result.iterations << " iterations, "
+        << result.iterations / seconds << " shaders/s" << std::endl;
+    for (int p = 0; p < kPhaseCount; ++p) {
+        const auto& phase = result.phases[p];
+        out << "    " << std::left << std::setw(16) << kPhaseNames[p] << std::right
+            << std::setw(12) << phase.seconds / result.iterations * 1e6 << " us "
+            << std::setw(12) << result.iterations / phase.seconds << " shaders/s "
+            << std::setw(10) << phase.allocations / result.iterations << " allocations" << std::endl;
+    }
+}
+
+// Per shader: { case: { phase: { "seconds", "allocations" } } }.
+nlohmann::json MakeReport(const std::vector<CaseResult>& results) {
+    nlohmann::json report = nlohmann::json::object();
+    for (const auto& result : results) {
+        for (int p = 0; p < kPhaseCount; ++p) {
+            auto& phase = report[result.name][kPhaseNames[p]];
+            phase["seconds"] = result.phases[p].seconds / result.iterations;
+            phase["allocations"] = result.phases[p].allocations / result.iterations;
+        }
+    }
+    return report;
+}
+
+// Reports every phase worse than its baseline by more than threshold
+// percent; returns false if there is one.
+bool CompareWithBaseline(const nlohmann::json& report, const nlohmann::json& baseline, uint32_t threshold, std::ostream& out) {
+    const double factor = 1.0 + threshold / 100.0;
+    bool passed = true;
+    for (auto it = report.begin(); it != report.end(); ++it) {
+        if (baseline.count(it.key()) == 0) {
+            continue;
+        }
+        const auto& baseline_case = baseline[it.key()];
+        for (auto phase = it.value().begin(); phase != it.value().end(); ++phase) {
+            if (baseline_case.count(phase.key()) == 0) {
+                continue;
+            }
+            const auto& before = baseline_case[phase.key()];
+            const auto& after = phase.value();
+            const double seconds_before = before["seconds"].get<double>();
+            const double seconds_after = after["seconds"].get<double>();
+            if (seconds_after > seconds_before * factor && seconds_after - seconds_before > kMinRegressionSeconds) {
+                out << "regression: " << it.key() << " " << phase.key() << " "
+                    << seconds_before * 1e6 << " -> " << seconds_after * 1e6 << " us" << std::endl;
+                passed = false;
+            }
+            const uint64_t allocations_before = before["allocations"].get<uint64_t>();
+            const uint64_t allocations_after = after["allocations"].get<uint64_t>();
+            if (allocations_after > allocations_before * factor) {
+                out << "regression: " << it.key() << " " << phase.key() << " "
+                    << allocations_before << " -> " << allocations_after << " allocations" << std::endl;
+                passed = false;
+            }
+        }
+    }
+    return passed;
+}
+}
+
+// Replaces the global allocation functions to count allocations per
+// thread. Only ShaderRetrieverBenchmark links this file, so the compiler
+// itself keeps the default ones.
+void* operator new(std::size_t size) {
+    ++t_allocations;
+    if (void* p = std::malloc(size > 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    ++t_allocations;
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+bool RunPhaseBenchmark(const PhaseBenchmarkOptions& options, std::ostream& out) {
+    nlohmann::json baseline;
+    if (!options.baseline_path.empty()) {
+        std::ifstream baseline_file(options.baseline_path);
+        if (!baseline_file.is_open()) {
+            out << options.baseline_path << " can not be loaded!" << std::endl;
+            return false;
+        }
+        baseline_file >> baseline;
+    }
+
+    const auto directory = (fs::temp_directory_path() / "shader_retriever_benchmark").string();
+    fs::create_directories(directory);
+
+    std::vector<CaseResult> results;
+    bool succeeded = true;
+    out << std::fixed << std::setprecision(2);
+    for (const auto& benchmark_case : MakeCases()) {
+        std::ostringstream log;
+        CaseResult result;
+        if (!RunCase(benchmark_case, directory, result, log)) {
+            out << log.str() << benchmark_case.name << " failed to compile!" << std::endl;
+            succeeded = false;
+            break;
+        }
+        WriteCase(out, result);
+        results.push_back(result);
+    }
+    out.unsetf(std::ios::floatfield);
+    std::error_code error;
+    fs::remove_all(directory, error);
+    if (!succeeded) {
+        return false;
+    }
+
+    const auto report = MakeReport(results);
+    if (!options.save_baseline_path.empty()) {
+        std::ofstream report_file(options.save_baseline_path);
+        report_file << report.dump(4) << std::endl;
+        if (!report_file.good()) {
+            out << options.save_baseline_path << " can not be written!" << std::endl;
+            return false;
+        }
+    }
+    if (!options.baseline_path.empty()) {
+        return CompareWithBaseline(report, baseline, options.regression_threshold, out);
+    }
+    return true;
+}
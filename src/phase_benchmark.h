@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+struct PhaseBenchmarkOptions {
+    // A report written by an earlier run to compare against, if not empty.
+    std::string baseline_path;
+    // Where to write this run's report, if not empty.
+    std::string save_baseline_path;
+    // How much slower (or more allocating) than the baseline a phase may
+    // get before it is reported as a regression, in percent.
+    uint32_t regression_threshold = 10;
+};
+
+// Compiles synthetic programs (see GenerateSyntheticProgram), scaling one
+// of their sizes at a time, and times every phase of a compile on its own:
+// parsing, linking, mapIO, buildReflection, ShaderDescriptor reflection,
+// GlslangToSpv and writing the outputs. Reports the throughput and the
+// allocations of every phase. Returns false if a program fails to compile
+// or a phase regressed against the baseline. Lives in the benchmark
+// executable (benchmark.cpp) only, see operator new in the .cpp.
+bool RunPhaseBenchmark(const PhaseBenchmarkOptions& options, std::ostream& out);
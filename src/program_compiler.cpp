@@ -0,0 +1,315 @@
+#include <iostream>
+#include <fstream>
+#include <exception>
+#include <memory>
+#include <vector>
+#include <ShaderLang.h>
+#include <GlslangToSpv.h>
+#include "program_compiler.h"
+#include "config.h"
+#include "spv_program.h"
+#include "shader_descriptor.h"
+#include "compile_cache.h"
+#include "file_utils.h"
+#include "shader_archive_writer.h"
+#include "spirv_postprocess.h"
+#include "spirv_codec_writer.h"
+#include "permutation_compiler.h"
+#include "tracer.h"
+#include "layout_planner.h"
+#include "spirv_cost.h"
+#include "include_cache.h"
+#include "cpp_header.h"
+
+bool LoadProgramSources(Config& config, IncludeCache* p_cache, std::vector<std::vector<ShaderSource>>& stage_sources,
+    std::ostream& log) {
+    const auto& stages = config.getStages();
+    stage_sources.assign(stages.size(), {});
+    bool loaded = true;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        auto inline_source = config.shaderSources.find(stages[i]);
+        if (inline_source != config.shaderSources.end()) {
+            ShaderSource source;
+            source.data = inline_source->second.data();
+            source.size = inline_source->second.size();
+            stage_sources[i].push_back(source);
+            continue;
+        }
+        loaded = LoadShaderSources({ config.shaderFilepaths[stages[i]] }, stage_sources[i], p_cache, log) && loaded;
+    }
+    return loaded;
+}
+
+std::set<std::string> ScanProgramDependencies(Config& config, const std::vector<std::vector<ShaderSource>>& stage_sources,
+    IncludeCache* p_cache) {
+    IncludeCache own_cache;
+    auto& cache = p_cache != nullptr ? *p_cache : own_cache;
+    std::set<std::string> dependencies;
+    const auto& stages = config.getStages();
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const auto& path = config.shaderFilepaths[stages[i]];
+        if (config.shaderSources.count(stages[i]) == 0) {
+            dependencies.insert(AbsolutePath(path));
+        }
+        for (const auto& source : stage_sources[i]) {
+            ScanIncludes(source.data, source.size, path, config.getIncludePaths(), dependencies, cache);
+        }
+    }
+    return dependencies;
+}
+
+// Fails a compute program whose workgroup memory is over the config's
+// "max_shared_memory", before it ever reaches a device.
+bool CheckSharedMemory(const Config& config, const CompiledProgram& compiled, std::ostream& log) {
+    const uint32_t limit = config.getMaxSharedMemory();
+    const uint32_t used = compiled.reflection.compute.shared_memory_bytes;
+    if (limit > 0 && used > limit) {
+        log << config.getName() << " uses " << used << " bytes of shared memory, "
+            << "max_shared_memory is " << limit << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Fails a program with a stage over any limit of the config's
+// "cost_budget", reporting every metric that is.
+bool CheckCostBudget(const Config& config, const CompiledProgram& compiled, std::ostream& log) {
+    bool within = true;
+    for (const auto& cost : compiled.reflection.costs) {
+        const auto stage = static_cast<VkShaderStageFlagBits>(cost.stage);
+        const auto budget = config.getCostBudget().find(stage);
+        if (budget == config.getCostBudget().end()) {
+            continue;
+        }
+        for (const auto& limit : budget->second) {
+            const uint32_t used = GetCostMetric(cost, limit.first);
+            if (used > limit.second) {
+                log << config.getName() << " " << StageName(stage) << " " << limit.first << " is " << used
+                    << ", cost_budget is " << limit.second << "." << std::endl;
+                within = false;
+            }
+        }
+    }
+    return within;
+}
+
+bool BuildProgram(Config& config, const CompileContext& context, CompiledProgram& compiled, std::ostream& log) {
+    const auto& stages = config.getStages();
+    uint32_t stage_count = config.getStages().size();
+    const auto name = config.getName();
+
+    std::vector<std::vector<ShaderSource>> stage_sources;
+    {
+        TraceSpan span(context.p_tracer, "load_sources", name);
+        if (!LoadProgramSources(config, context.p_include_cache, stage_sources, log)) {
+            return false;
+        }
+    }
+
+    std::string cache_key;
+    if (context.p_cache != nullptr) {
+        TraceSpan span(context.p_tracer, "cache_load", name);
+        auto dependencies = ScanProgramDependencies(config, stage_sources, context.p_include_cache);
+        cache_key = context.p_cache->computeKey(config, stage_sources, dependencies, context);
+        if (context.p_cache->load(cache_key, compiled)) {
+            compiled.dependencies.swap(dependencies);
+            return CheckSharedMemory(config, compiled, log) && CheckCostBudget(config, compiled, log);
+        }
+    }
+
+    std::vector<std::unique_ptr<glslang::TShader>> p_shaders(stage_count);
+    std::vector<std::unique_ptr<ShaderIncluder>> includers(stage_count);
+    for (uint32_t i = 0; i < stage_count; ++i) {
+        auto sh_stage = VKStageFlagToEShStage(stages[i]);
+        glslang::TShader* p_shader = nullptr;
+        CreateShader(sh_stage, p_shader);
+        p_shaders[i].reset(p_shader);
+        if (p_shader == nullptr) {
+            log << "Something is going wrong,"
+                << "memory allocation failed!"
+                << std::endl;
+            return false;
+        }
+
+        std::vector<const char*> c_srcs;
+        std::vector<int> lengths;
+        for (const auto& source : stage_sources[i]) {
+            c_srcs.push_back(source.data);
+            lengths.push_back(static_cast<int>(source.size));
+        }
+        p_shader->setStringsWithLengths(c_srcs.data(), lengths.data(), static_cast<int>(c_srcs.size()));
+        auto preamble = config.shaderPreambles.find(stages[i]);
+        if (preamble != config.shaderPreambles.end()) {
+            p_shader->setPreamble(preamble->second.c_str());
+        }
+        p_shader->setEntryPoint(config.shaderEntrys[stages[i]].c_str());
+        TraceSpan span(context.p_tracer, "parse", name, StageName(stages[i]));
+        includers[i].reset(new ShaderIncluder(context.p_include_cache, config.getIncludePaths(),
+            config.shaderFilepaths[stages[i]]));
+        if (!ConfigureShader(p_shader, sh_stage, config, log, includers[i].get())) {
+            return false;
+        }
+        if (config.shaderSources.count(stages[i]) == 0) {
+            compiled.dependencies.insert(AbsolutePath(config.shaderFilepaths[stages[i]]));
+        }
+        const auto& includes = includers[i]->getDependencies();
+        compiled.dependencies.insert(includes.begin(), includes.end());
+    }
+
+    glslang::TProgram program;
+
+    for (auto& p_shader : p_shaders) {
+        program.addShader(p_shader.get());
+    }
+
+    if (!InitializeProgram(program, config.getMessages(), log, context.p_tracer, name)) {
+        return false;
+    }
+
+    ShaderDescriptor shader_descriptor;
+    {
+        TraceSpan span(context.p_tracer, "push_constants", name);
+        shader_descriptor.buildPushConstants(program, config);
+    }
+    {
+        TraceSpan span(context.p_tracer, "reflection", name);
+        shader_descriptor.processProgram(program, config);
+        compiled.reflection = shader_descriptor.getReflection();
+    }
+
+    for (uint32_t i = 0; i < stage_count; ++i) {
+        TraceSpan span(context.p_tracer, "GlslangToSpv", name, StageName(stages[i]));
+        auto& spirv = compiled.spirv[stages[i]];
+        glslang::GlslangToSpv(*program.getIntermediate(VKStageFlagToEShStage(stages[i])), spirv);
+    }
+
+    {
+        TraceSpan span(context.p_tracer, "cost", name);
+        for (auto stage : stages) {
+            compiled.reflection.costs.push_back(EstimateStageCost(compiled.spirv[stage], stage));
+        }
+        if (!CheckCostBudget(config, compiled, log)) {
+            return false;
+        }
+    }
+
+    if (config.isCompute()) {
+        compiled.reflection.compute.shared_memory_bytes = WorkgroupMemorySize(compiled.spirv[VK_SHADER_STAGE_COMPUTE_BIT]);
+        if (!CheckSharedMemory(config, compiled, log)) {
+            return false;
+        }
+    }
+
+    if (context.p_spirv_stats != nullptr) {
+        const auto kept_names = ReflectedNames(compiled.reflection);
+        for (auto stage : stages) {
+            TraceSpan span(context.p_tracer, "post_process", name, StageName(stage));
+            SpirvPostProcessStats stats;
+            PostProcessSpirv(compiled.spirv[stage], kept_names, stats, log);
+            context.p_spirv_stats->add(stats);
+            log << config.getShaderBinFilename(stage) << ": " << stats.bytes_before << " -> "
+                << stats.bytes_after << " bytes" << std::endl;
+        }
+    }
+
+    if (context.p_cache != nullptr) {
+        TraceSpan span(context.p_tracer, "cache_store", name);
+        context.p_cache->store(cache_key, compiled);
+    }
+    return true;
+}
+
+void PlanLayouts(Config& config, const CompileContext& context, const ProgramReflection& reflection) {
+    if (context.p_layout_planner == nullptr) {
+        return;
+    }
+    uint32_t stages = 0;
+    for (auto stage : config.getStages()) {
+        stages |= stage;
+    }
+    context.p_layout_planner->add(config.getName(), reflection, stages);
+}
+
+bool WriteSpirvFile(const std::string& path, const std::vector<unsigned int>& spirv, const CompileContext& context) {
+    if (context.spirv_encoding == "compact" || context.spirv_encoding == "entropy") {
+        const auto encoded = EncodeCompressedSpirv(spirv, context.spirv_encoding == "entropy");
+        return WriteOutputFile(path, encoded.data(), encoded.size(), context.keep_unchanged_outputs);
+    }
+    return WriteOutputFile(path, spirv.data(), spirv.size() * sizeof(unsigned int), context.keep_unchanged_outputs);
+}
+
+bool WriteCppHeader(const std::string& path, const CppHeaderWriter& writer, const CompileContext& context,
+    std::ostream& log) {
+    const auto header = writer.finish();
+    if (!WriteOutputFile(path, header.data(), header.size(), context.keep_unchanged_outputs)) {
+        log << path << " can not be written!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool WriteProgram(Config& config, const CompileContext& context, const CompiledProgram& compiled, std::ostream& log) {
+    TraceSpan span(context.p_tracer, "write", config.getName());
+    PlanLayouts(config, context, compiled.reflection);
+    if (context.write_cpp_headers) {
+        CppHeaderWriter writer(config.getName(), config.getName());
+        writer.addProgram("", "", compiled.spirv, config.shaderEntrys, compiled.reflection);
+        if (!WriteCppHeader(config.getHeaderFilename(), writer, context, log)) {
+            return false;
+        }
+    }
+    if (context.p_archive != nullptr) {
+        ShaderDescriptor shader_descriptor;
+        shader_descriptor.loadReflection(compiled.reflection, config);
+        shader_descriptor.hashModules(compiled.spirv);
+        context.p_archive->put(config.getName(), compiled.spirv, shader_descriptor.toBinary());
+        return true;
+    }
+
+    if (!context.descriptor_format.empty()) {
+        config.setDescriptorFormat(context.descriptor_format);
+    }
+    for (auto stage : config.getStages()) {
+        if (!WriteSpirvFile(config.getShaderBinFilename(stage), compiled.spirv.at(stage), context)) {
+            log << "Something is going wrong,"
+                << "file can not be loaded!"
+                << std::endl;
+            return false;
+        }
+    }
+
+    ShaderDescriptor shader_descriptor;
+    shader_descriptor.loadReflection(compiled.reflection, config);
+    shader_descriptor.hashModules(compiled.spirv);
+    if (config.isBinaryDescriptor()) {
+        shader_descriptor.writeBinaryFile(config.getShaderDescriptorFilename(), context.keep_unchanged_outputs);
+    }
+    else {
+        shader_descriptor.writeFile(config.getShaderDescriptorFilename(), context.keep_unchanged_outputs,
+            config.isCompactDescriptor());
+    }
+    if (context.write_depfiles && !WriteDepfile(config.getDepfileFilename(), config.getShaderDescriptorFilename(),
+        compiled.dependencies, context.keep_unchanged_outputs)) {
+        log << config.getDepfileFilename() << " can not be written!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CompileProgram(Config& config, const CompileContext& context, std::ostream& log) {
+    bool succeeded = false;
+    {
+        TraceSpan span(context.p_tracer, "program", config.getName());
+        if (config.hasPermutations()) {
+            succeeded = CompilePermutations(config, context, log);
+        }
+        else {
+            CompiledProgram compiled;
+            succeeded = BuildProgram(config, context, compiled, log) && WriteProgram(config, context, compiled, log);
+        }
+    }
+    if (context.p_tracer != nullptr) {
+        context.p_tracer->addMemorySample();
+    }
+    return succeeded;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <ostream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "reflection.h"
+#include "spv_program.h"
+#include <vulkan/vulkan.h>
+
+class Config;
+class CompileCache;
+class ArchiveWriter;
+class SpirvStatistics;
+class Tracer;
+class LayoutPlanner;
+class IncludeCache;
+class CppHeaderWriter;
+class JobSlots;
+class MemoryBudget;
+
+// Process-wide services shared by every program compiled in a run.
+struct CompileContext {
+    CompileCache* p_cache = nullptr;
+    // When set, programs go into the archive instead of .sr and .sd files.
+    ArchiveWriter* p_archive = nullptr;
+    // Leave outputs whose content did not change untouched (watch mode).
+    bool keep_unchanged_outputs = false;
+    // Overrides every config's "descriptor_format" (json, compact or binary)
+    // when not empty.
+    std::string descriptor_format;
+    // When set, every module is post-processed (see PostProcessSpirv) and
+    // the savings are added up here.
+    SpirvStatistics* p_spirv_stats = nullptr;
+    // "compact" or "entropy" writes every .sr in the compressed format of
+    // spirv_codec.h; empty or "raw" writes plain SPIR-V words.
+    std::string spirv_encoding;
+    // When set, every phase of every program is recorded as a span.
+    Tracer* p_tracer = nullptr;
+    // When set, the set layouts of every written program are collected
+    // for the shared layout table.
+    LayoutPlanner* p_layout_planner = nullptr;
+    // When set, #included files are mapped once for every program rather
+    // than once per stage.
+    IncludeCache* p_include_cache = nullptr;
+    // Write a depfile (see Config::getDepfileFilename()) with every .sd.
+    bool write_depfiles = false;
+    // Write a C++ header (see cpp_header.h and Config::getHeaderFilename())
+    // with every program, in archive mode as well.
+    bool write_cpp_headers = false;
+    // The threads and memory every compile of the run shares, which a
+    // program building several variants at once takes its helpers from;
+    // without job slots it builds them one after another.
+    JobSlots* p_job_slots = nullptr;
+    MemoryBudget* p_memory_budget = nullptr;
+};
+
+// The SPIR-V of every stage of a program and the reflection ShaderDescriptor
+// produced for it (without the output file names).
+struct CompiledProgram {
+    std::map<VkShaderStageFlagBits, std::vector<unsigned int>> spirv;
+    ProgramReflection reflection;
+    // Absolute paths of the stage source files and every file they
+    // include: those glslang read when built, those ScanProgramDependencies
+    // finds when taken from the cache.
+    std::set<std::string> dependencies;
+};
+
+// Maps the sources of every stage, in the order of config.getStages(),
+// through p_cache (see LoadShaderSources); inline sources are taken as
+// they are, and must outlive stage_sources along with config.
+bool LoadProgramSources(Config& config, IncludeCache* p_cache, std::vector<std::vector<ShaderSource>>& stage_sources,
+    std::ostream& log = std::cout);
+
+// The stage source files of config and the files their sources include,
+// as absolute paths; see ScanIncludes().
+std::set<std::string> ScanProgramDependencies(Config& config, const std::vector<std::vector<ShaderSource>>& stage_sources,
+    IncludeCache* p_cache);
+
+// Runs one program (every stage of a config) through parse, link, reflection
+// and SPIR-V generation, or takes it from the cache.
+// glslang::InitializeProcess() must have been called on the calling thread.
+// Errors are written to log; returns false when the program failed.
+bool BuildProgram(Config& config, const CompileContext& context, CompiledProgram& compiled, std::ostream& log = std::cout);
+
+// Writes the .sr and .sd outputs of a built program, or puts it into the
+// archive.
+bool WriteProgram(Config& config, const CompileContext& context, const CompiledProgram& compiled, std::ostream& log = std::cout);
+
+// Hands the set layouts of a written program to the context's planner.
+void PlanLayouts(Config& config, const CompileContext& context, const ProgramReflection& reflection);
+
+// Writes one .sr in the encoding context asks for.
+bool WriteSpirvFile(const std::string& path, const std::vector<unsigned int>& spirv, const CompileContext& context);
+
+// Writes the header writer generated, logging when it can not.
+bool WriteCppHeader(const std::string& path, const CppHeaderWriter& writer, const CompileContext& context,
+    std::ostream& log = std::cout);
+
+// BuildProgram followed by WriteProgram, or CompilePermutations when the
+// config has a define matrix.
+bool CompileProgram(Config& config, const CompileContext& context, std::ostream& log = std::cout);
@@ -0,0 +1,568 @@
+#include <algorithm>
+#include <cstring>
+#include "reflection.h"
+
+namespace {
+void WriteOptional(JsonWriter& writer, const char* key, uint32_t value) {
+    if (value != kReflectionAbsent) {
+        writer.key(key);
+        writer.value(value);
+    }
+}
+
+// Writes a group of named entries; a group without entries is null, as in
+// the .sd files the JSON document used to produce.
+template<typename T, typename WriteEntry>
+void WriteGroup(JsonWriter& writer, const std::vector<T>& entries, WriteEntry write_entry) {
+    if (entries.empty()) {
+        writer.null();
+        return;
+    }
+    writer.beginObject();
+    for (const auto& entry : entries) {
+        writer.key(entry.name);
+        writer.beginObject();
+        write_entry(entry);
+        writer.endObject();
+    }
+    writer.endObject();
+}
+
+template<typename T>
+void SortByName(std::vector<T>& entries) {
+    std::stable_sort(entries.begin(), entries.end(), [](const T& a, const T& b) {
+        return std::strcmp(a.name, b.name) < 0;
+    });
+}
+
+// Keeps the last of every run of entries with the same name.
+template<typename T>
+void KeepLast(std::vector<T>& entries) {
+    SortByName(entries);
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (kept > 0 && std::strcmp(entries[kept - 1].name, entries[i].name) == 0) {
+            entries[kept - 1] = entries[i];
+        }
+        else {
+            entries[kept++] = entries[i];
+        }
+    }
+    entries.resize(kept);
+}
+
+void MergeValue(uint32_t& value, uint32_t later) {
+    if (later != kReflectionAbsent) {
+        value = later;
+    }
+}
+
+uint32_t GetOr(const nlohmann::json& object, const char* key) {
+    auto found = object.find(key);
+    return found != object.end() ? found->get<uint32_t>() : kReflectionAbsent;
+}
+
+ReflectedQualifier GetQualifier(const nlohmann::json& object) {
+    ReflectedQualifier qualifier;
+    qualifier.location = GetOr(object, "location");
+    qualifier.binding = GetOr(object, "binding");
+    qualifier.set = GetOr(object, "set");
+    return qualifier;
+}
+
+const nlohmann::json& GetObject(const nlohmann::json& object, const char* key) {
+    static const nlohmann::json empty = nlohmann::json::object();
+    auto found = object.find(key);
+    return found != object.end() && found->is_object() ? *found : empty;
+}
+
+std::vector<ReflectedStageCost> ParseStageCosts(const nlohmann::json& object) {
+    std::vector<ReflectedStageCost> costs;
+    for (const auto& entry : object.value("cost", nlohmann::json::array())) {
+        ReflectedStageCost cost;
+        const auto& alu = GetObject(entry, "alu");
+        cost.compare_ops = alu.value("compare", 0u);
+        cost.conversion_ops = alu.value("conversion", 0u);
+        cost.float_ops = alu.value("float", 0u);
+        cost.integer_ops = alu.value("integer", 0u);
+        cost.transcendental_ops = alu.value("transcendental", 0u);
+        cost.branches = entry["branches"].get<uint32_t>();
+        cost.dynamic_loops = entry["dynamic_loops"].get<uint32_t>();
+        cost.image_reads = entry["image_reads"].get<uint32_t>();
+        cost.registers = entry["registers"].get<uint32_t>();
+        cost.stage = entry["stage"].get<uint32_t>();
+        cost.static_loops = entry["static_loops"].get<uint32_t>();
+        cost.texture_samples = entry["texture_samples"].get<uint32_t>();
+        costs.push_back(cost);
+    }
+    return costs;
+}
+}
+
+void WriteReflectionBindings(JsonWriter& writer, const ProgramReflection& reflection) {
+    writer.key("bindings");
+    if (reflection.bindings.empty()) {
+        writer.null();
+        return;
+    }
+    writer.beginObject();
+    for (const auto& binding : reflection.bindings) {
+        writer.key(binding.name);
+        writer.beginObject();
+        WriteOptional(writer, "binding", binding.binding);
+        writer.key("count");
+        writer.value(binding.count);
+        WriteOptional(writer, "set", binding.set);
+        WriteOptional(writer, "type", binding.type);
+        writer.endObject();
+    }
+    writer.endObject();
+}
+
+void WriteReflectionBrief(JsonWriter& writer, const ProgramReflection& reflection) {
+    writer.key("brief");
+    writer.beginObject();
+    writer.key("attributes_count");
+    writer.value(reflection.attributes_count);
+    writer.key("uniform_blocks_count");
+    writer.value(reflection.uniform_blocks_count);
+    writer.key("uniform_variables_count");
+    writer.value(reflection.uniform_variables_count);
+    writer.endObject();
+}
+
+void WriteReflectionCompute(JsonWriter& writer, const ProgramReflection& reflection) {
+    const auto& compute = reflection.compute;
+    if (!compute.isPresent()) {
+        return;
+    }
+    writer.key("compute");
+    writer.beginObject();
+    writer.key("invocations");
+    writer.value(compute.getInvocations());
+    writer.key("local_size_x");
+    writer.value(compute.local_size_x);
+    writer.key("local_size_y");
+    writer.value(compute.local_size_y);
+    writer.key("local_size_z");
+    writer.value(compute.local_size_z);
+    writer.key("shared_memory_bytes");
+    writer.value(compute.shared_memory_bytes);
+    writer.endObject();
+}
+
+void WriteReflectionCost(JsonWriter& writer, const ProgramReflection& reflection) {
+    WriteStageCosts(writer, reflection.costs);
+}
+
+void WriteStageCosts(JsonWriter& writer, const std::vector<ReflectedStageCost>& costs) {
+    if (costs.empty()) {
+        return;
+    }
+    writer.key("cost");
+    writer.beginArray();
+    for (const auto& cost : costs) {
+        writer.beginObject();
+        writer.key("alu");
+        writer.beginObject();
+        writer.key("compare");
+        writer.value(cost.compare_ops);
+        writer.key("conversion");
+        writer.value(cost.conversion_ops);
+        writer.key("float");
+        writer.value(cost.float_ops);
+        writer.key("integer");
+        writer.value(cost.integer_ops);
+        writer.key("transcendental");
+        writer.value(cost.transcendental_ops);
+        writer.endObject();
+        writer.key("branches");
+        writer.value(cost.branches);
+        writer.key("dynamic_loops");
+        writer.value(cost.dynamic_loops);
+        writer.key("image_reads");
+        writer.value(cost.image_reads);
+        writer.key("registers");
+        writer.value(cost.registers);
+        writer.key("stage");
+        writer.value(cost.stage);
+        writer.key("static_loops");
+        writer.value(cost.static_loops);
+        writer.key("texture_samples");
+        writer.value(cost.texture_samples);
+        writer.endObject();
+    }
+    writer.endArray();
+}
+
+void WriteReflectionDescriptorPool(JsonWriter& writer, const ProgramReflection& reflection) {
+    writer.key("descriptor_pool");
+    writer.beginObject();
+    writer.key("descriptors");
+    writer.beginArray();
+    for (auto count : reflection.descriptor_pool) {
+        writer.value(count);
+    }
+    writer.endArray();
+    writer.key("sets_count");
+    writer.value(reflection.sets_count);
+    writer.endObject();
+}
+
+void WriteReflectionPushConstantRanges(JsonWriter& writer, const ProgramReflection& reflection) {
+    if (reflection.push_constant_ranges.empty()) {
+        return;
+    }
+    writer.key("push_constant_ranges");
+    writer.beginArray();
+    for (const auto& range : reflection.push_constant_ranges) {
+        writer.beginObject();
+        writer.key("offset");
+        writer.value(range.offset);
+        writer.key("size");
+        writer.value(range.size);
+        writer.key("stages");
+        writer.value(range.stages);
+        writer.endObject();
+    }
+    writer.endArray();
+}
+
+void WriteReflectionVariables(JsonWriter& writer, const ProgramReflection& reflection) {
+    writer.key("variables");
+    writer.beginObject();
+    if (reflection.attributes_count > 0) {
+        writer.key("attributes");
+        WriteGroup(writer, reflection.attributes, [&](const ReflectedAttribute& attribute) {
+            if (attribute.array_size > 1) {
+                writer.key("array_size");
+                writer.value(attribute.array_size);
+            }
+            writer.key("basic_type");
+            writer.value(attribute.basic_type);
+            WriteOptional(writer, "binding", attribute.qualifier.binding);
+            WriteOptional(writer, "location", attribute.qualifier.location);
+            if (attribute.matrix_columns > 0) {
+                writer.key("matrix_columns");
+                writer.value(attribute.matrix_columns);
+                writer.key("matrix_rows");
+                writer.value(attribute.matrix_rows);
+            }
+            WriteOptional(writer, "set", attribute.qualifier.set);
+            writer.key("type");
+            writer.value(attribute.type);
+            writer.key("vector_size");
+            writer.value(attribute.vector_size);
+        });
+    }
+    writer.key("push_constants");
+    WriteGroup(writer, reflection.push_constants, [&](const ReflectedPushConstant& push_constant) {
+        writer.key("basic_type");
+        writer.value(push_constant.basic_type);
+        WriteOptional(writer, "binding", push_constant.qualifier.binding);
+        writer.key("block_size");
+        writer.value(push_constant.block_size);
+        WriteOptional(writer, "location", push_constant.qualifier.location);
+        WriteOptional(writer, "set", push_constant.qualifier.set);
+        writer.key("stage");
+        writer.value(push_constant.stage);
+    });
+    if (!reflection.storage_blocks.empty()) {
+        writer.key("storage_blocks");
+        WriteGroup(writer, reflection.storage_blocks, [&](const ReflectedStorageBlock& block) {
+            writer.key("basic_type");
+            writer.value(block.basic_type);
+            WriteOptional(writer, "binding", block.qualifier.binding);
+            writer.key("block_size");
+            writer.value(block.block_size);
+            WriteOptional(writer, "location", block.qualifier.location);
+            WriteOptional(writer, "set", block.qualifier.set);
+        });
+    }
+    if (reflection.uniform_blocks_count > 0) {
+        writer.key("uniform_blocks");
+        WriteGroup(writer, reflection.uniform_blocks, [&](const ReflectedUniformBlock& block) {
+            writer.key("basic_type");
+            writer.value(block.basic_type);
+            WriteOptional(writer, "binding", block.qualifier.binding);
+            writer.key("block_size");
+            writer.value(block.block_size);
+            WriteOptional(writer, "location", block.qualifier.location);
+            writer.key("members");
+            writer.beginArray();
+            for (const auto& member : block.members) {
+                writer.beginObject();
+                if (member.array_stride > 0) {
+                    writer.key("array_stride");
+                    writer.value(member.array_stride);
+                }
+                if (member.matrix_stride > 0) {
+                    writer.key("matrix_stride");
+                    writer.value(member.matrix_stride);
+                }
+                writer.key("name");
+                writer.value(member.name);
+                writer.key("offset");
+                writer.value(member.offset);
+                writer.key("size");
+                writer.value(member.size);
+                writer.endObject();
+            }
+            writer.endArray();
+            WriteOptional(writer, "offset", block.offset);
+            writer.key("padding_bytes");
+            writer.value(block.padding_bytes);
+            WriteOptional(writer, "set", block.qualifier.set);
+            if (!block.suggested_order.empty()) {
+                writer.key("suggested_order");
+                writer.beginArray();
+                for (const char* name : block.suggested_order) {
+                    writer.value(name);
+                }
+                writer.endArray();
+                writer.key("suggested_size");
+                writer.value(block.suggested_size);
+            }
+        });
+    }
+    if (reflection.uniform_variables_count > 0) {
+        writer.key("uniform_variables");
+        WriteGroup(writer, reflection.uniform_variables, [&](const ReflectedUniformVariable& variable) {
+            writer.key("basic_type");
+            writer.value(variable.basic_type);
+            WriteOptional(writer, "binding", variable.qualifier.binding);
+            WriteOptional(writer, "location", variable.qualifier.location);
+            WriteOptional(writer, "offset", variable.offset);
+            if (variable.has_sampler) {
+                writer.key("sampler");
+                writer.beginObject();
+                writer.key("combined");
+                writer.value(variable.sampler.combined);
+                writer.key("dim");
+                writer.value(variable.sampler.dim);
+                writer.key("type");
+                writer.value(variable.sampler.type);
+                writer.endObject();
+            }
+            WriteOptional(writer, "set", variable.qualifier.set);
+        });
+    }
+    writer.endObject();
+}
+
+void WriteReflectionVertexInput(JsonWriter& writer, const ProgramReflection& reflection) {
+    if (reflection.vertex_attributes.empty()) {
+        return;
+    }
+    writer.key("vertex_input");
+    writer.beginObject();
+    writer.key("attributes");
+    writer.beginArray();
+    for (const auto& attribute : reflection.vertex_attributes) {
+        writer.beginObject();
+        writer.key("binding");
+        writer.value(attribute.binding);
+        writer.key("format");
+        writer.value(attribute.format);
+        writer.key("location");
+        writer.value(attribute.location);
+        writer.key("offset");
+        writer.value(attribute.offset);
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.key("bindings");
+    writer.beginArray();
+    for (const auto& binding : reflection.vertex_bindings) {
+        writer.beginObject();
+        writer.key("binding");
+        writer.value(binding.binding);
+        writer.key("input_rate");
+        writer.value(binding.input_rate);
+        writer.key("stride");
+        writer.value(binding.stride);
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+}
+void WriteReflection(JsonWriter& writer, const ProgramReflection& reflection) {
+    writer.beginObject();
+    WriteReflectionBindings(writer, reflection);
+    WriteReflectionBrief(writer, reflection);
+    WriteReflectionCompute(writer, reflection);
+    WriteReflectionCost(writer, reflection);
+    WriteReflectionDescriptorPool(writer, reflection);
+    WriteReflectionPushConstantRanges(writer, reflection);
+    WriteReflectionVariables(writer, reflection);
+    WriteReflectionVertexInput(writer, reflection);
+    writer.endObject();
+}
+
+std::string SerializeReflection(const ProgramReflection& reflection) {
+    std::string out;
+    JsonWriter writer(out, true);
+    WriteReflection(writer, reflection);
+    return out;
+}
+
+const char* ProgramReflection::intern(const char* text) {
+    if (!p_arena) {
+        p_arena = std::make_shared<StringArena>();
+    }
+    return p_arena->intern(text);
+}
+
+void ProgramReflection::finalize() {
+    KeepLast(attributes);
+    KeepLast(uniform_blocks);
+    KeepLast(uniform_variables);
+    KeepLast(push_constants);
+    KeepLast(storage_blocks);
+
+    SortByName(bindings);
+    size_t kept = 0;
+    for (size_t i = 0; i < bindings.size(); ++i) {
+        if (kept > 0 && std::strcmp(bindings[kept - 1].name, bindings[i].name) == 0) {
+            MergeValue(bindings[kept - 1].set, bindings[i].set);
+            MergeValue(bindings[kept - 1].binding, bindings[i].binding);
+            MergeValue(bindings[kept - 1].type, bindings[i].type);
+            bindings[kept - 1].count = std::max(bindings[kept - 1].count, bindings[i].count);
+        }
+        else {
+            bindings[kept++] = bindings[i];
+        }
+    }
+    bindings.resize(kept);
+}
+
+ProgramReflection ParseReflection(const nlohmann::json& json) {
+    ProgramReflection reflection;
+    const auto& variables = GetObject(json, "variables");
+
+    const auto& attributes = GetObject(variables, "attributes");
+    for (auto it = attributes.begin(); it != attributes.end(); ++it) {
+        ReflectedAttribute attribute;
+        attribute.name = reflection.intern(it.key().c_str());
+        attribute.basic_type = reflection.intern(it.value()["basic_type"].get<std::string>().c_str());
+        attribute.type = it.value()["type"].get<uint32_t>();
+        attribute.vector_size = it.value()["vector_size"].get<uint32_t>();
+        attribute.matrix_columns = it.value().value("matrix_columns", 0u);
+        attribute.matrix_rows = it.value().value("matrix_rows", 0u);
+        attribute.array_size = it.value().value("array_size", 1u);
+        attribute.qualifier = GetQualifier(it.value());
+        reflection.attributes.push_back(attribute);
+    }
+    const auto& uniform_blocks = GetObject(variables, "uniform_blocks");
+    for (auto it = uniform_blocks.begin(); it != uniform_blocks.end(); ++it) {
+        ReflectedUniformBlock block;
+        block.name = reflection.intern(it.key().c_str());
+        block.basic_type = reflection.intern(it.value()["basic_type"].get<std::string>().c_str());
+        block.block_size = it.value()["block_size"].get<uint32_t>();
+        block.offset = GetOr(it.value(), "offset");
+        block.qualifier = GetQualifier(it.value());
+        for (const auto& member : it.value().value("members", nlohmann::json::array())) {
+            ReflectedBlockMember reflected;
+            reflected.name = reflection.intern(member["name"].get<std::string>().c_str());
+            reflected.offset = member["offset"].get<uint32_t>();
+            reflected.size = member["size"].get<uint32_t>();
+            reflected.array_stride = member.value("array_stride", 0u);
+            reflected.matrix_stride = member.value("matrix_stride", 0u);
+            block.members.push_back(reflected);
+        }
+        block.padding_bytes = it.value().value("padding_bytes", 0u);
+        for (const auto& name : it.value().value("suggested_order", nlohmann::json::array())) {
+            block.suggested_order.push_back(reflection.intern(name.get<std::string>().c_str()));
+        }
+        block.suggested_size = it.value().value("suggested_size", 0u);
+        reflection.uniform_blocks.push_back(block);
+    }
+    const auto& uniform_variables = GetObject(variables, "uniform_variables");
+    for (auto it = uniform_variables.begin(); it != uniform_variables.end(); ++it) {
+        ReflectedUniformVariable variable;
+        variable.name = reflection.intern(it.key().c_str());
+        variable.basic_type = reflection.intern(it.value()["basic_type"].get<std::string>().c_str());
+        variable.offset = GetOr(it.value(), "offset");
+        variable.qualifier = GetQualifier(it.value());
+        const auto& sampler = GetObject(it.value(), "sampler");
+        if (!sampler.empty()) {
+            variable.has_sampler = true;
+            variable.sampler.dim = sampler["dim"].get<uint32_t>();
+            variable.sampler.type = sampler["type"].get<uint32_t>();
+            variable.sampler.combined = sampler["combined"].get<bool>();
+        }
+        reflection.uniform_variables.push_back(variable);
+    }
+    const auto& push_constants = GetObject(variables, "push_constants");
+    for (auto it = push_constants.begin(); it != push_constants.end(); ++it) {
+        ReflectedPushConstant push_constant;
+        push_constant.name = reflection.intern(it.key().c_str());
+        push_constant.basic_type = reflection.intern(it.value()["basic_type"].get<std::string>().c_str());
+        push_constant.block_size = it.value()["block_size"].get<uint32_t>();
+        push_constant.stage = it.value()["stage"].get<uint32_t>();
+        push_constant.qualifier = GetQualifier(it.value());
+        reflection.push_constants.push_back(push_constant);
+    }
+    const auto& storage_blocks = GetObject(variables, "storage_blocks");
+    for (auto it = storage_blocks.begin(); it != storage_blocks.end(); ++it) {
+        ReflectedStorageBlock block;
+        block.name = reflection.intern(it.key().c_str());
+        block.basic_type = reflection.intern(it.value()["basic_type"].get<std::string>().c_str());
+        block.block_size = it.value()["block_size"].get<uint32_t>();
+        block.qualifier = GetQualifier(it.value());
+        reflection.storage_blocks.push_back(block);
+    }
+    const auto& bindings = GetObject(json, "bindings");
+    for (auto it = bindings.begin(); it != bindings.end(); ++it) {
+        ReflectedBinding binding;
+        binding.name = reflection.intern(it.key().c_str());
+        binding.set = GetOr(it.value(), "set");
+        binding.binding = GetOr(it.value(), "binding");
+        binding.type = GetOr(it.value(), "type");
+        binding.count = it.value().value("count", 1u);
+        reflection.bindings.push_back(binding);
+    }
+    reflection.finalize();
+
+    const auto& brief = GetObject(json, "brief");
+    reflection.attributes_count = brief.value("attributes_count", 0u);
+    reflection.uniform_blocks_count = brief.value("uniform_blocks_count", 0u);
+    reflection.uniform_variables_count = brief.value("uniform_variables_count", 0u);
+    const auto& pool = GetObject(json, "descriptor_pool");
+    if (pool.count("descriptors") > 0) {
+        for (const auto& count : pool["descriptors"]) {
+            reflection.descriptor_pool.push_back(count.get<uint32_t>());
+        }
+    }
+    reflection.sets_count = pool.value("sets_count", 1u);
+    for (const auto& range : json.value("push_constant_ranges", nlohmann::json::array())) {
+        ReflectedPushConstantRange reflected;
+        reflected.offset = range["offset"].get<uint32_t>();
+        reflected.size = range["size"].get<uint32_t>();
+        reflected.stages = range["stages"].get<uint32_t>();
+        reflection.push_constant_ranges.push_back(reflected);
+    }
+    reflection.costs = ParseStageCosts(json);
+    const auto& vertex_input = GetObject(json, "vertex_input");
+    for (const auto& binding : vertex_input.value("bindings", nlohmann::json::array())) {
+        ReflectedVertexBinding reflected;
+        reflected.binding = binding["binding"].get<uint32_t>();
+        reflected.stride = binding["stride"].get<uint32_t>();
+        reflected.input_rate = binding["input_rate"].get<uint32_t>();
+        reflection.vertex_bindings.push_back(reflected);
+    }
+    for (const auto& attribute : vertex_input.value("attributes", nlohmann::json::array())) {
+        ReflectedVertexAttribute reflected;
+        reflected.location = attribute["location"].get<uint32_t>();
+        reflected.binding = attribute["binding"].get<uint32_t>();
+        reflected.format = attribute["format"].get<uint32_t>();
+        reflected.offset = attribute["offset"].get<uint32_t>();
+        reflection.vertex_attributes.push_back(reflected);
+    }
+    const auto& compute = GetObject(json, "compute");
+    reflection.compute.local_size_x = compute.value("local_size_x", 0u);
+    reflection.compute.local_size_y = compute.value("local_size_y", 0u);
+    reflection.compute.local_size_z = compute.value("local_size_z", 0u);
+    reflection.compute.shared_memory_bytes = compute.value("shared_memory_bytes", 0u);
+    return reflection;
+}
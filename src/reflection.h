@@ -0,0 +1,220 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <json.hpp>
+#include "json_writer.h"
+#include "string_arena.h"
+
+// Typed form of what ShaderDescriptor reflects from a linked program, and
+// what the .sd is written from. Names and type strings are interned in an
+// arena shared by the copies of a reflection and freed with the last of
+// them. Every section is sorted by name (see finalize()), the order the
+// JSON form always had. Values missing from the .sd (e.g. a variable
+// without a binding) are kReflectionAbsent.
+
+const uint32_t kReflectionAbsent = 0xFFFFFFFF;
+
+struct ReflectedQualifier {
+    uint32_t location = kReflectionAbsent;
+    uint32_t binding = kReflectionAbsent;
+    uint32_t set = kReflectionAbsent;
+};
+
+struct ReflectedAttribute {
+    const char* name = "";
+    const char* basic_type = "";
+    uint32_t type = 0;
+    uint32_t vector_size = 0;
+    // 0 unless a matrix, whose vector_size is 0.
+    uint32_t matrix_columns = 0;
+    uint32_t matrix_rows = 0;
+    uint32_t array_size = 1;
+    ReflectedQualifier qualifier;
+};
+
+// A member of a block as std140, std430 or scalar packing lays it out, see
+// block_layout.h.
+struct ReflectedBlockMember {
+    const char* name = "";
+    uint32_t offset = 0;
+    uint32_t size = 0;
+    uint32_t array_stride = 0;
+    uint32_t matrix_stride = 0;
+};
+
+struct ReflectedUniformBlock {
+    const char* name = "";
+    const char* basic_type = "";
+    uint32_t block_size = 0;
+    uint32_t offset = kReflectionAbsent;
+    ReflectedQualifier qualifier;
+    // In offset order, nested struct members included.
+    std::vector<ReflectedBlockMember> members;
+    uint32_t padding_bytes = 0;
+    // Top-level member names in an order giving suggested_size, smaller
+    // than block_size; empty when there is nothing to gain.
+    std::vector<const char*> suggested_order;
+    uint32_t suggested_size = 0;
+};
+
+struct ReflectedSampler {
+    uint32_t dim = 0;
+    uint32_t type = 0;
+    bool combined = false;
+};
+
+struct ReflectedUniformVariable {
+    const char* name = "";
+    const char* basic_type = "";
+    uint32_t offset = kReflectionAbsent;
+    bool has_sampler = false;
+    ReflectedSampler sampler;
+    ReflectedQualifier qualifier;
+};
+
+struct ReflectedPushConstant {
+    const char* name = "";
+    const char* basic_type = "";
+    uint32_t block_size = 0;
+    uint32_t stage = 0;
+    ReflectedQualifier qualifier;
+};
+
+// One VkPushConstantRange of the pipeline layout. Ranges do not overlap
+// and every stage is in one of them at most.
+struct ReflectedPushConstantRange {
+    uint32_t offset = 0;
+    uint32_t size = 0;
+    // VkShaderStageFlags
+    uint32_t stages = 0;
+};
+
+// A shader storage block (a "buffer" block).
+struct ReflectedStorageBlock {
+    const char* name = "";
+    const char* basic_type = "";
+    uint32_t block_size = 0;
+    ReflectedQualifier qualifier;
+};
+
+// The workgroup of a compute program; local_size_x is 0 in other programs.
+struct ReflectedCompute {
+    uint32_t local_size_x = 0;
+    uint32_t local_size_y = 0;
+    uint32_t local_size_z = 0;
+    // Workgroup ("shared") variables, laid out as std430 would.
+    uint32_t shared_memory_bytes = 0;
+
+    bool isPresent() const { return local_size_x > 0; }
+    uint32_t getInvocations() const { return local_size_x * local_size_y * local_size_z; }
+};
+
+// Static cost of one stage, see spirv_cost.h. ALU ops are scalar operations;
+// everything inside a loop with a static trip count is counted once per
+// iteration, inside any other loop once.
+struct ReflectedStageCost {
+    // VkShaderStageFlagBits
+    uint32_t stage = 0;
+    uint32_t float_ops = 0;
+    uint32_t integer_ops = 0;
+    uint32_t transcendental_ops = 0;
+    uint32_t conversion_ops = 0;
+    uint32_t compare_ops = 0;
+    uint32_t texture_samples = 0;
+    // Fetches and storage image reads, which skip the sampler.
+    uint32_t image_reads = 0;
+    uint32_t branches = 0;
+    uint32_t static_loops = 0;
+    uint32_t dynamic_loops = 0;
+    // Peak of 32-bit values live at once.
+    uint32_t registers = 0;
+
+    uint32_t getAluOps() const {
+        return float_ops + integer_ops + transcendental_ops + conversion_ops + compare_ops;
+    }
+};
+
+// A VkVertexInputBindingDescription, see vertex_input.h.
+struct ReflectedVertexBinding {
+    uint32_t binding = 0;
+    uint32_t stride = 0;
+    // VkVertexInputRate
+    uint32_t input_rate = 0;
+};
+
+// A VkVertexInputAttributeDescription.
+struct ReflectedVertexAttribute {
+    uint32_t location = 0;
+    uint32_t binding = 0;
+    // VkFormat
+    uint32_t format = 0;
+    uint32_t offset = 0;
+};
+
+struct ReflectedBinding {
+    const char* name = "";
+    uint32_t set = kReflectionAbsent;
+    uint32_t binding = kReflectionAbsent;
+    uint32_t type = kReflectionAbsent;
+    // Descriptors in the binding, more than one for arrays.
+    uint32_t count = 1;
+};
+
+struct ProgramReflection {
+    std::vector<ReflectedAttribute> attributes;
+    std::vector<ReflectedUniformBlock> uniform_blocks;
+    std::vector<ReflectedUniformVariable> uniform_variables;
+    std::vector<ReflectedPushConstant> push_constants;
+    std::vector<ReflectedPushConstantRange> push_constant_ranges;
+    std::vector<ReflectedStorageBlock> storage_blocks;
+    std::vector<ReflectedBinding> bindings;
+    // Live counts glslang reported, push constants and block members
+    // included; a section is only written when its count is not zero.
+    uint32_t attributes_count = 0;
+    uint32_t uniform_blocks_count = 0;
+    uint32_t uniform_variables_count = 0;
+    // Indexed by VkDescriptorType.
+    std::vector<uint32_t> descriptor_pool;
+    uint32_t sets_count = 1;
+    ReflectedCompute compute;
+    // Sorted by binding, and by location; empty when an attribute has no
+    // location.
+    std::vector<ReflectedVertexBinding> vertex_bindings;
+    std::vector<ReflectedVertexAttribute> vertex_attributes;
+    // By stage; empty until the SPIR-V is generated.
+    std::vector<ReflectedStageCost> costs;
+    // Holds every string above; null until something is interned.
+    std::shared_ptr<StringArena> p_arena;
+
+    const char* intern(const char* text);
+    // Sorts every section by name. Of entries with the same name the last
+    // one added wins; bindings are merged, later values replacing earlier
+    // ones.
+    void finalize();
+};
+
+// Writes the sections of a reflection as members of the object being
+// written; key order is the caller's business, see WriteReflection.
+void WriteReflectionBindings(JsonWriter& writer, const ProgramReflection& reflection);
+void WriteReflectionBrief(JsonWriter& writer, const ProgramReflection& reflection);
+// Writes nothing unless the program is a compute program.
+void WriteReflectionCompute(JsonWriter& writer, const ProgramReflection& reflection);
+// Writes nothing without costs.
+void WriteReflectionCost(JsonWriter& writer, const ProgramReflection& reflection);
+// The "cost" array, also written for each permutation.
+void WriteStageCosts(JsonWriter& writer, const std::vector<ReflectedStageCost>& costs);
+void WriteReflectionDescriptorPool(JsonWriter& writer, const ProgramReflection& reflection);
+// Writes nothing without push constants.
+void WriteReflectionPushConstantRanges(JsonWriter& writer, const ProgramReflection& reflection);
+void WriteReflectionVariables(JsonWriter& writer, const ProgramReflection& reflection);
+// Writes nothing without vertex attributes.
+void WriteReflectionVertexInput(JsonWriter& writer, const ProgramReflection& reflection);
+
+// The reflection as one JSON object, the .sd without "spvs".
+void WriteReflection(JsonWriter& writer, const ProgramReflection& reflection);
+std::string SerializeReflection(const ProgramReflection& reflection);
+
+// Reads what WriteReflection wrote (or a whole .sd).
+ProgramReflection ParseReflection(const nlohmann::json& json);
@@ -0,0 +1,61 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <json.hpp>
+#include "local_socket.h"
+
+// Messages between the compile server and its clients are frames of
+//     uint32 header size, uint32 payload size, header, payload
+// in host byte order. The header is compact JSON; the payload carries
+// binary data the header refers to by offset and size.
+//
+// Compile request:  { "id": <n>, "config": { input.conf with optional
+//                     "source" text next to each stage's "path" } }
+// Compile response: { "id": <n>, "succeeded": <bool>, "log": "...",
+//                     "descriptor_path": "...", "descriptor": { .sd },
+//                     "binaries": [ { "path", "stage", "offset", "size" } ] }
+//                   with the SPIR-V of every stage in the payload.
+// Shutdown request: { "id": <n>, "command": "shutdown" }
+// Responses to pipelined requests may arrive out of order; match them by id.
+// Larger frames are refused rather than allocated: the sizes come from the
+// peer.
+const uint32_t kMaxFrameBytes = 256u << 20;
+
+struct Frame {
+    nlohmann::json header;
+    std::string payload;
+};
+
+inline bool WriteFrame(LocalSocket& socket, const Frame& frame) {
+    const auto header = frame.header.dump();
+    const uint32_t sizes[2] = {
+        static_cast<uint32_t>(header.size()),
+        static_cast<uint32_t>(frame.payload.size())
+    };
+    return socket.sendAll(sizes, sizeof(sizes)) &&
+        socket.sendAll(header.data(), header.size()) &&
+        socket.sendAll(frame.payload.data(), frame.payload.size());
+}
+
+inline bool ReadFrame(LocalSocket& socket, Frame& frame) {
+    uint32_t sizes[2];
+    if (!socket.receiveAll(sizes, sizeof(sizes))) {
+        return false;
+    }
+    if (sizes[0] > kMaxFrameBytes || sizes[1] > kMaxFrameBytes - sizes[0]) {
+        return false;
+    }
+    std::string header(sizes[0], '\0');
+    frame.payload.assign(sizes[1], '\0');
+    if (!socket.receiveAll(&header[0], header.size()) ||
+        !socket.receiveAll(&frame.payload[0], frame.payload.size())) {
+        return false;
+    }
+    try {
+        frame.header = nlohmann::json::parse(header);
+    }
+    catch (std::exception&) {
+        return false;
+    }
+    return true;
+}
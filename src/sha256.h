@@ -0,0 +1,32 @@
+#pragma once
+#include <array>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+class Sha256 {
+public:
+    using Digest = std::array<uint8_t, 32>;
+
+    Sha256();
+
+    void update(const void* data, size_t size);
+    void update(const std::string& data) { update(data.data(), data.size()); }
+    // Hashes the value's object representation, so only use it for types
+    // without padding or pointers.
+    template<typename T>
+    void updateValue(const T& value) { update(&value, sizeof(T)); }
+
+    Digest finish();
+
+    static std::string toHex(const uint8_t* data, size_t size);
+    static std::string toHex(const Digest& digest) { return toHex(digest.data(), digest.size()); }
+
+private:
+    void transform(const uint8_t* block);
+
+    uint32_t m_state[8];
+    uint8_t m_buffer[64];
+    size_t m_buffer_size = 0;
+    uint64_t m_length = 0;
+};
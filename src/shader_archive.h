@@ -0,0 +1,165 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "binary_descriptor.h"
+
+// Packs the SPIR-V modules and binary descriptors of many programs into one
+// file that is read in place from a memory-mapped buffer.
+//
+//     ArHeader (updated last, in place)
+//     program data: binary descriptor and SPIR-V of every stage, each
+//                   kArDataAlignment aligned, appended as programs change
+//     index: ArEntry[entry_count], uint32 buckets[bucket_count], names
+//
+// Updating a program appends its data and a new index; the header is then
+// switched to the new index, so the previous index stays valid until that
+// final write. Superseded data is reclaimed when the garbage outgrows the
+// live data and the writer rebuilds the archive.
+
+const uint32_t kArMagic = 0x52415253; // "SRAR"
+const uint32_t kArVersion = 1;
+const uint32_t kArDataAlignment = 16;
+const uint32_t kArMaxStages = 6;
+const uint32_t kArEmptyBucket = 0xFFFFFFFF;
+
+struct ArHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t bucket_count;
+    uint64_t index_offset;
+    uint64_t index_size;
+    // Bytes of program data no longer referenced by the index.
+    uint64_t garbage_size;
+    uint64_t reserved[3];
+};
+
+struct ArBlob {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct ArStage {
+    uint32_t stage;
+    uint32_t reserved;
+    ArBlob spirv;
+};
+
+struct ArEntry {
+    uint64_t name_hash;
+    uint64_t name_offset;
+    uint32_t name_size;
+    uint32_t stage_count;
+    ArBlob descriptor;
+    ArStage stages[kArMaxStages];
+};
+
+// FNV-1a, the hash of the bucket index.
+inline uint64_t ArchiveHashName(const char* name, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<uint8_t>(name[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Read-only view of an archive; it never copies or allocates. The buffer
+// must stay alive and 8-byte aligned while the view is used.
+class ArchiveView {
+public:
+    ArchiveView(const void* data, size_t size) :
+        m_data(static_cast<const uint8_t*>(data)),
+        m_size(size) {
+
+    }
+
+    bool isValid() const {
+        if (m_size < sizeof(ArHeader) || reinterpret_cast<uintptr_t>(m_data) % 8 != 0) {
+            return false;
+        }
+        const auto& h = header();
+        if (h.magic != kArMagic || h.version != kArVersion || h.index_offset % 8 != 0 ||
+            h.index_offset > m_size || h.index_size > m_size - h.index_offset) {
+            return false;
+        }
+        const uint64_t tables_size = static_cast<uint64_t>(h.entry_count) * sizeof(ArEntry) +
+            static_cast<uint64_t>(h.bucket_count) * sizeof(uint32_t);
+        if (tables_size > h.index_size || (h.bucket_count & (h.bucket_count - 1)) != 0) {
+            return false;
+        }
+        for (uint32_t i = 0; i < h.entry_count; ++i) {
+            const auto& e = entries()[i];
+            if (!contains(e.name_offset, e.name_size) || !contains(e.descriptor.offset, e.descriptor.size) ||
+                e.stage_count > kArMaxStages) {
+                return false;
+            }
+            for (uint32_t s = 0; s < e.stage_count; ++s) {
+                if (!contains(e.stages[s].spirv.offset, e.stages[s].spirv.size)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    const ArHeader& header() const { return *reinterpret_cast<const ArHeader*>(m_data); }
+    uint32_t entryCount() const { return header().entry_count; }
+    const ArEntry* entries() const { return reinterpret_cast<const ArEntry*>(m_data + header().index_offset); }
+
+    const ArEntry* find(const char* name) const {
+        const auto& h = header();
+        if (h.bucket_count == 0) {
+            return nullptr;
+        }
+        const size_t name_size = std::strlen(name);
+        const uint64_t hash = ArchiveHashName(name, name_size);
+        const uint32_t mask = h.bucket_count - 1;
+        for (uint32_t bucket = hash & mask, probes = 0; probes < h.bucket_count; bucket = (bucket + 1) & mask, ++probes) {
+            const uint32_t index = buckets()[bucket];
+            if (index == kArEmptyBucket) {
+                return nullptr;
+            }
+            const auto& e = entries()[index];
+            if (e.name_hash == hash && e.name_size == name_size &&
+                std::memcmp(m_data + e.name_offset, name, name_size) == 0) {
+                return &e;
+            }
+        }
+        return nullptr;
+    }
+
+    // Not null-terminated; use entry.name_size.
+    const char* name(const ArEntry& entry) const {
+        return reinterpret_cast<const char*>(m_data + entry.name_offset);
+    }
+
+    SdView descriptor(const ArEntry& entry) const {
+        return SdView(m_data + entry.descriptor.offset, static_cast<size_t>(entry.descriptor.size));
+    }
+
+    // The module of a stage (a VkShaderStageFlagBits), or null.
+    const uint32_t* spirv(const ArEntry& entry, uint32_t stage, size_t& word_count) const {
+        for (uint32_t i = 0; i < entry.stage_count; ++i) {
+            if (entry.stages[i].stage == stage) {
+                word_count = static_cast<size_t>(entry.stages[i].spirv.size / sizeof(uint32_t));
+                return reinterpret_cast<const uint32_t*>(m_data + entry.stages[i].spirv.offset);
+            }
+        }
+        word_count = 0;
+        return nullptr;
+    }
+
+private:
+    const uint32_t* buckets() const {
+        return reinterpret_cast<const uint32_t*>(entries() + header().entry_count);
+    }
+
+    bool contains(uint64_t offset, uint64_t size) const {
+        return offset <= m_size && size <= m_size - offset;
+    }
+
+    const uint8_t* m_data;
+    size_t m_size;
+};
@@ -0,0 +1,221 @@
+#include <filesystem>
+#include <stdexcept>
+#include <cstring>
+#include "shader_archive_writer.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+uint64_t ProgramSize(const ArBlob& descriptor, const std::vector<ArStage>& stages) {
+    uint64_t size = AlignUp(descriptor.size, kArDataAlignment);
+    for (const auto& stage : stages) {
+        size += AlignUp(stage.spirv.size, kArDataAlignment);
+    }
+    return size;
+}
+}
+
+ArchiveWriter::ArchiveWriter(const std::string& path) : m_path(path) {
+    std::memset(&m_header, 0, sizeof(m_header));
+    m_header.magic = kArMagic;
+    m_header.version = kArVersion;
+
+    std::error_code error;
+    if (!fs::exists(m_path, error)) {
+        std::ofstream(m_path, std::ios::binary).write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    }
+    open();
+
+    ArHeader header;
+    if (!m_file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != kArMagic || header.version != kArVersion) {
+        throw std::runtime_error(m_path + " is not a shader archive.");
+    }
+    m_header = header;
+    m_file.seekg(0, std::ios::end);
+    m_end = static_cast<uint64_t>(m_file.tellg());
+
+    // Checked against the file before they size or place anything, as
+    // ArchiveView::isValid() does.
+    if (header.index_offset > m_end || header.index_size > m_end - header.index_offset) {
+        throw std::runtime_error(m_path + " has a truncated index.");
+    }
+    if (static_cast<uint64_t>(header.entry_count) * sizeof(ArEntry) > header.index_size) {
+        throw std::runtime_error(m_path + " has a corrupt index.");
+    }
+    std::vector<uint64_t> index(static_cast<size_t>(AlignUp(header.index_size, 8) / 8));
+    m_file.seekg(header.index_offset);
+    if (!m_file.read(reinterpret_cast<char*>(index.data()), header.index_size)) {
+        throw std::runtime_error(m_path + " has a truncated index.");
+    }
+    const char* p_index = reinterpret_cast<const char*>(index.data());
+    const auto* p_entries = reinterpret_cast<const ArEntry*>(p_index);
+    for (uint32_t i = 0; i < header.entry_count; ++i) {
+        const auto& entry = p_entries[i];
+        if (entry.name_offset < header.index_offset ||
+            entry.name_offset - header.index_offset > header.index_size ||
+            entry.name_size > header.index_size - (entry.name_offset - header.index_offset) ||
+            entry.stage_count > kArMaxStages) {
+            throw std::runtime_error(m_path + " has a corrupt index.");
+        }
+        std::string name(p_index + (entry.name_offset - header.index_offset), entry.name_size);
+        auto& program = m_programs[name];
+        program.descriptor = entry.descriptor;
+        program.stages.assign(entry.stages, entry.stages + entry.stage_count);
+    }
+}
+
+void ArchiveWriter::put(const std::string& name,
+    const std::map<VkShaderStageFlagBits, std::vector<unsigned int>>& spirv,
+    const std::string& descriptor) {
+    if (spirv.size() > kArMaxStages) {
+        throw std::runtime_error(name + " has too many stages for an archive entry.");
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Program program;
+    program.descriptor = append(descriptor.data(), descriptor.size());
+    for (const auto& module : spirv) {
+        ArStage stage = {};
+        stage.stage = module.first;
+        stage.spirv = append(module.second.data(), module.second.size() * sizeof(unsigned int));
+        program.stages.push_back(stage);
+    }
+
+    auto previous = m_programs.find(name);
+    if (previous != m_programs.end()) {
+        m_header.garbage_size += ProgramSize(previous->second.descriptor, previous->second.stages);
+    }
+    m_programs[name] = program;
+}
+
+void ArchiveWriter::commit() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t live_size = 0;
+    for (const auto& program : m_programs) {
+        live_size += ProgramSize(program.second.descriptor, program.second.stages);
+    }
+    if (m_header.garbage_size > live_size) {
+        rebuild();
+    }
+    else {
+        writeIndex();
+    }
+    m_file.flush();
+}
+
+ArBlob ArchiveWriter::append(const void* data, size_t size) {
+    static const char padding[kArDataAlignment] = {};
+    const uint64_t offset = AlignUp(m_end, kArDataAlignment);
+    m_file.seekp(m_end);
+    m_file.write(padding, offset - m_end);
+    m_file.write(static_cast<const char*>(data), size);
+    if (!m_file.good()) {
+        throw std::runtime_error(m_path + " can not be written.");
+    }
+    m_end = offset + size;
+    return { offset, size };
+}
+
+void ArchiveWriter::writeIndex() {
+    uint32_t bucket_count = 1;
+    while (bucket_count < m_programs.size() * 2) {
+        bucket_count *= 2;
+    }
+    const uint64_t index_offset = AlignUp(m_end, 8);
+    const uint64_t names_offset = index_offset + m_programs.size() * sizeof(ArEntry) + bucket_count * sizeof(uint32_t);
+
+    std::vector<ArEntry> entries;
+    std::vector<uint32_t> buckets(bucket_count, kArEmptyBucket);
+    std::string names;
+    for (const auto& program : m_programs) {
+        ArEntry entry = {};
+        entry.name_hash = ArchiveHashName(program.first.data(), program.first.size());
+        entry.name_offset = names_offset + names.size();
+        entry.name_size = static_cast<uint32_t>(program.first.size());
+        entry.descriptor = program.second.descriptor;
+        entry.stage_count = static_cast<uint32_t>(program.second.stages.size());
+        std::copy(program.second.stages.begin(), program.second.stages.end(), entry.stages);
+        names += program.first;
+
+        uint32_t bucket = entry.name_hash & (bucket_count - 1);
+        while (buckets[bucket] != kArEmptyBucket) {
+            bucket = (bucket + 1) & (bucket_count - 1);
+        }
+        buckets[bucket] = static_cast<uint32_t>(entries.size());
+        entries.push_back(entry);
+    }
+
+    static const char padding[8] = {};
+    m_file.seekp(m_end);
+    m_file.write(padding, index_offset - m_end);
+    m_file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ArEntry));
+    m_file.write(reinterpret_cast<const char*>(buckets.data()), buckets.size() * sizeof(uint32_t));
+    m_file.write(names.data(), names.size());
+    m_file.flush();
+
+    // The previous index is garbage from here on; the header switches over
+    // only once the new index is completely on disk.
+    if (m_header.index_size > 0) {
+        m_header.garbage_size += m_header.index_size;
+    }
+    m_header.entry_count = static_cast<uint32_t>(entries.size());
+    m_header.bucket_count = bucket_count;
+    m_header.index_offset = index_offset;
+    m_header.index_size = names_offset + names.size() - index_offset;
+    m_end = index_offset + m_header.index_size;
+    m_file.seekp(0);
+    m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    if (!m_file.good()) {
+        throw std::runtime_error(m_path + " can not be written.");
+    }
+}
+
+void ArchiveWriter::rebuild() {
+    const auto temp_path = m_path + ".tmp";
+    std::fstream source;
+    source.swap(m_file);
+    m_file.open(temp_path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    if (!m_file.is_open()) {
+        throw std::runtime_error(temp_path + " can not be created.");
+    }
+
+    std::memset(&m_header, 0, sizeof(m_header));
+    m_header.magic = kArMagic;
+    m_header.version = kArVersion;
+    m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    m_end = sizeof(m_header);
+
+    std::string buffer;
+    auto copy = [&](const ArBlob& blob) {
+        buffer.resize(static_cast<size_t>(blob.size));
+        source.seekg(blob.offset);
+        source.read(&buffer[0], buffer.size());
+        return append(buffer.data(), buffer.size());
+    };
+    for (auto& program : m_programs) {
+        program.second.descriptor = copy(program.second.descriptor);
+        for (auto& stage : program.second.stages) {
+            stage.spirv = copy(stage.spirv);
+        }
+    }
+    if (!source.good()) {
+        throw std::runtime_error(m_path + " can not be read.");
+    }
+    writeIndex();
+
+    source.close();
+    m_file.close();
+    fs::rename(temp_path, m_path);
+    open();
+}
+
+void ArchiveWriter::open() {
+    m_file.open(m_path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!m_file.is_open()) {
+        throw std::runtime_error(m_path + " can not be opened.");
+    }
+}
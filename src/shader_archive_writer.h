@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <fstream>
+#include <vulkan/vulkan.h>
+#include "shader_archive.h"
+
+// Adds or replaces programs in an archive (see shader_archive.h). Program
+// data is appended as it is put; commit() writes the new index and switches
+// the header to it, so only the changed programs are written. Thread-safe.
+class ArchiveWriter {
+public:
+    // Opens an existing archive, or creates it.
+    explicit ArchiveWriter(const std::string& path);
+
+    // descriptor is a binary .sd, see ShaderDescriptor::toBinary().
+    void put(const std::string& name,
+        const std::map<VkShaderStageFlagBits, std::vector<unsigned int>>& spirv,
+        const std::string& descriptor);
+
+    // Rebuilds the archive instead when superseded data outweighs live data.
+    void commit();
+
+private:
+    struct Program {
+        ArBlob descriptor;
+        std::vector<ArStage> stages;
+    };
+
+    ArBlob append(const void* data, size_t size);
+    void writeIndex();
+    void rebuild();
+    void open();
+
+    std::string m_path;
+    std::fstream m_file;
+    std::mutex m_mutex;
+    ArHeader m_header;
+    uint64_t m_end = 0;
+    std::map<std::string, Program> m_programs;
+};
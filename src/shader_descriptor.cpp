@@ -1,200 +1,460 @@
 #include <iostream>
 #include <fstream>
 #include <exception>
+#include <stdexcept>
+#include <algorithm>
 #include "shader_descriptor.h"
 #include "config.h"
 #include "spv_program.h"
+#include "file_utils.h"
+#include "binary_descriptor_writer.h"
+#include "block_layout.h"
+#include "vertex_input.h"
 
-ShaderDescriptor::ShaderDescriptor() : 
-    m_descriptor_pool(VkDescriptorType::VK_DESCRIPTOR_TYPE_RANGE_SIZE) {
+namespace {
+uint32_t GetComponentBytes(glslang::TBasicType basic_type) {
+    switch (basic_type) {
+    case glslang::EbtDouble:
+    case glslang::EbtInt64:
+    case glslang::EbtUint64:
+        return 8;
+    case glslang::EbtFloat16:
+    case glslang::EbtInt16:
+    case glslang::EbtUint16:
+        return 2;
+    case glslang::EbtInt8:
+    case glslang::EbtUint8:
+        return 1;
+    default:
+        return 4;
+    }
+}
 
+// A member's own layout(row_major) wins over the one of its block.
+bool IsRowMajor(const glslang::TType& type, bool row_major) {
+    const auto matrix = type.getQualifier().layoutMatrix;
+    return matrix == glslang::ElmNone ? row_major : matrix == glslang::ElmRowMajor;
 }
 
-void ShaderDescriptor::buildPushConstants(glslang::TShader* p_shader, Config& config) {
-    glslang::TProgram* p_program = new(std::nothrow)glslang::TProgram;
-    assert(p_program != nullptr);
-    auto sh_stage = p_shader->getStage();
-    auto stage = VK_SHADER_STAGE_ALL;
-    switch (sh_stage)
-    {
-    case EShLangVertex:
-        stage = VK_SHADER_STAGE_VERTEX_BIT;
-        break;
-    case EShLangTessControl:
-        stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
-        break;
-    case EShLangTessEvaluation:
-        stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
-        break;
-    case EShLangGeometry:
-        stage = VK_SHADER_STAGE_GEOMETRY_BIT;
-        break;
-    case EShLangFragment:
-        stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        break;
-    case EShLangCompute:
-        stage = VK_SHADER_STAGE_COMPUTE_BIT;
-        break;
-    default:
-        assert(false);
-        break;
+LayoutType::Member GetLayoutMember(const glslang::TType& type, bool row_major) {
+    LayoutType::Member member;
+    member.name = type.getFieldName().c_str();
+
+    auto& layout = member.type;
+    layout.component_bytes = GetComponentBytes(type.getBasicType());
+    row_major = IsRowMajor(type, row_major);
+    if (type.isStruct()) {
+        layout.kind = LayoutType::kStruct;
+        for (const auto& field : *type.getStruct()) {
+            layout.members.push_back(GetLayoutMember(*field.type, row_major));
+        }
+    }
+    else if (type.isMatrix()) {
+        layout.kind = LayoutType::kMatrix;
+        layout.vector_size = type.getMatrixRows();
+        layout.columns = type.getMatrixCols();
+        layout.row_major = row_major;
     }
-    p_program->addShader(p_shader);
-    bool result = InitializeProgram(*p_program, config.getMessages());
-    assert(result);
+    else if (type.isVector()) {
+        layout.kind = LayoutType::kVector;
+        layout.vector_size = type.getVectorSize();
+    }
+    // A runtime-sized array is 0 long, as glslang counts it.
+    if (type.isArray()) {
+        const auto& sizes = *type.getArraySizes();
+        for (int i = 0; i < sizes.getNumDims(); ++i) {
+            layout.array_sizes.push_back(sizes.getDimSize(i));
+        }
+    }
+    return member;
+}
 
-    JSON uniform_blocks_json;
-    auto uniform_blks_size = p_program->getNumLiveUniformBlocks();
-    for (int i = 0; i < uniform_blks_size; ++i) {
-        JSON uniform_blk_json;
-        uniform_blk_json["block_size"] = p_program->getUniformBlockSize(i);
-        uniform_blk_json["stage"] = stage;
+// Both write nothing until the modules are hashed.
+void WritePipelineHash(JsonWriter& writer, const ProgramHashes& hashes) {
+    if (!hashes.spvs.empty()) {
+        writer.key("pipeline_hash");
+        writer.value(hashes.pipeline.toHex());
+    }
+}
 
-        const auto& type = p_program->getUniformBlockTType(i);
-        writeBasicType(uniform_blk_json, *type);
+void WriteSpvHashes(JsonWriter& writer, const ProgramHashes& hashes) {
+    if (hashes.spvs.empty()) {
+        return;
+    }
+    writer.key("spv_hashes");
+    writer.beginObject();
+    for (const auto& spv : hashes.spvs) {
+        writer.key(spv.first);
+        writer.value(spv.second.toHex());
+    }
+    writer.endObject();
+}
+}
 
-        setQualifier(type, uniform_blk_json, p_program->getUniformBlockName(i));
+ShaderDescriptor::ShaderDescriptor() {
+    m_reflection.descriptor_pool.resize(VkDescriptorType::VK_DESCRIPTOR_TYPE_RANGE_SIZE);
+}
 
-        const auto& qualifier = type->getQualifier();
-        auto name = p_program->getUniformBlockName(i);
-        if (qualifier.layoutPushConstant == false) {
-            continue;
+void ShaderDescriptor::buildPushConstants(const glslang::TProgram& program, Config& config) {
+    // The linked program records which stages reference each block, so the
+    // push constants of every stage come out of the one reflection pass.
+    // A block shared by several stages is reported for the last of them.
+    auto uniform_blks_size = program.getNumLiveUniformBlocks();
+    std::vector<ReflectedPushConstantRange> stage_ranges;
+    for (auto stage : config.getStages()) {
+        auto sh_stage = VKStageFlagToEShStage(stage);
+        for (int i = 0; i < uniform_blks_size; ++i) {
+            const auto& type = program.getUniformBlockTType(i);
+            const auto& qualifier = type->getQualifier();
+            if (qualifier.layoutPushConstant == false) {
+                continue;
+            }
+            if ((program.getUniformBlock(i).stages & (1 << sh_stage)) == 0) {
+                continue;
+            }
+
+            ReflectedPushConstant push_constant;
+            push_constant.block_size = program.getUniformBlockSize(i);
+            push_constant.stage = stage;
+            push_constant.name = m_reflection.intern(program.getUniformBlockName(i));
+            push_constant.basic_type = internBasicType(*type);
+            setQualifier(type, push_constant.qualifier, push_constant.name);
+            m_reflection.push_constants.push_back(push_constant);
+
+            // A stage's range starts at its first member, which may have
+            // been given an offset to leave room for another stage. glslang
+            // assigns every member its offset; without one, cover the block.
+            uint32_t begin = push_constant.block_size;
+            for (const auto& field : *type->getStruct()) {
+                const auto& field_qualifier = field.type->getQualifier();
+                begin = field_qualifier.hasOffset() ?
+                    std::min<uint32_t>(begin, field_qualifier.layoutOffset) : 0;
+            }
+            stage_ranges.push_back({ begin, push_constant.block_size - begin, static_cast<uint32_t>(stage) });
+        }
+    }
+    mergePushConstantRanges(stage_ranges);
+}
+
+void ShaderDescriptor::mergePushConstantRanges(std::vector<ReflectedPushConstantRange>& stage_ranges) {
+    // Overlapping ranges become one covering both, with the stages of both;
+    // a stage must not be in two ranges, and any update of the overlap has
+    // to name every stage that sees it anyway.
+    std::sort(stage_ranges.begin(), stage_ranges.end(),
+        [](const ReflectedPushConstantRange& a, const ReflectedPushConstantRange& b) {
+        return a.offset < b.offset;
+    });
+    auto& ranges = m_reflection.push_constant_ranges;
+    ranges.clear();
+    for (const auto& range : stage_ranges) {
+        if (!ranges.empty() && range.offset < ranges.back().offset + ranges.back().size) {
+            auto& merged = ranges.back();
+            const uint32_t end = std::max(merged.offset + merged.size, range.offset + range.size);
+            merged.size = end - merged.offset;
+            merged.stages |= range.stages;
         }
         else {
-            m_push_constants[p_program->getUniformBlockName(i)] = uniform_blk_json;
+            ranges.push_back(range);
         }
     }
-    for (auto& value : m_descriptor_pool) {
-        value = 0;
-    }
 }
 
 void ShaderDescriptor::processProgram(glslang::TProgram& program, Config& config) {
-    JSON variables;
-    writeAttributesJSON(program, variables, config.isVulkanDef() || config.isHLSLDef());
-    writeUniformBlocksJSON(program, variables);
-    writeUniformVariablesJSON(program, variables);
-    variables["push_constants"] = m_push_constants;
-    m_base["variables"] = variables;
-    
-    JSON brief;
-    brief["attributes_count"] = m_attributes_count;
-    brief["uniform_blocks_count"] = m_uniform_blocks_count;
-    brief["uniform_variables_count"] = m_uniform_variables_count;
-    m_base["brief"] = brief;
-    m_base["descriptor_pool"]["descriptors"] = m_descriptor_pool;
-    m_base["descriptor_pool"]["sets_count"] = m_max_set;
-
-    const auto& stages = config.getStages();
-    uint32_t stage_count = config.getStages().size();
-
-    JSON spv_desc;
-    for (auto s : stages) {
-        spv_desc[config.getShaderBinFilename(s)] = s;
-    }
-    m_base["spvs"] = spv_desc;
-    m_base["bindings"] = m_bindings;
-}
-
-void ShaderDescriptor::writeFile(std::string filename) {
-    std::ofstream sd_file(filename);
-    if (!sd_file.is_open()) {
+    reflectAttributes(program, config.isVulkanDef() || config.isHLSLDef());
+    reflectUniformBlocks(program);
+    reflectUniformVariables(program);
+    reflectStorageBlocks(program);
+    if (config.isCompute()) {
+        reflectCompute(program);
+    }
+    m_reflection.finalize();
+    BuildVertexInput(m_reflection, config.getVertexInput());
+    writeSpvs(config);
+}
+
+void ShaderDescriptor::writeBinaryFile(std::string filename, bool only_if_changed) {
+    const auto sd_data = toBinary();
+    if (!WriteOutputFile(filename, sd_data.data(), sd_data.size(), only_if_changed)) {
+        throw std::runtime_error("Something is going wrong, file can not be loaded!");
+    }
+}
+
+void ShaderDescriptor::loadReflection(const ProgramReflection& reflection, Config& config) {
+    m_reflection = reflection;
+    writeSpvs(config);
+}
+
+void ShaderDescriptor::hashModules(const std::map<VkShaderStageFlagBits, std::vector<unsigned int>>& spirv) {
+    m_hashes = HashProgram(m_spvs, spirv, m_reflection);
+}
+
+void ShaderDescriptor::setPermutations(const std::vector<DescriptorPermutation>& permutations, const std::vector<ProgramReflection>& layouts) {
+    m_permutations = permutations;
+    m_layouts = layouts;
+}
+
+void ShaderDescriptor::writeFile(std::string filename, bool only_if_changed, bool compact) {
+    const auto sd_text = toJSON(compact);
+    if (!WriteOutputFile(filename, sd_text.data(), sd_text.size(), only_if_changed)) {
         throw std::exception("Something is going wrong, file can not be loaded!");
     }
-    sd_file << std::setw(4) << m_base;
-    sd_file.close();
 }
 
-void ShaderDescriptor::setQualifier(const glslang::TType* type, JSON& json, const char* variable_name) {
+std::string ShaderDescriptor::toJSON(bool compact) const {
+    // Top-level keys in sorted order, as nlohmann::json wrote them.
+    std::string out;
+    JsonWriter writer(out, compact);
+    writer.beginObject();
+    WriteReflectionBindings(writer, m_reflection);
+    WriteReflectionBrief(writer, m_reflection);
+    WriteReflectionCompute(writer, m_reflection);
+    WriteReflectionCost(writer, m_reflection);
+    WriteReflectionDescriptorPool(writer, m_reflection);
+    if (!m_hashes.spvs.empty()) {
+        writer.key("layout_hash");
+        writer.value(m_hashes.layout.toHex());
+    }
+    if (!m_permutations.empty()) {
+        writer.key("layouts");
+        writer.beginArray();
+        for (const auto& layout : m_layouts) {
+            WriteReflection(writer, layout);
+        }
+        writer.endArray();
+        writer.key("permutations");
+        writer.beginArray();
+        for (const auto& permutation : m_permutations) {
+            writer.beginObject();
+            if (permutation.alias_of != kReflectionAbsent) {
+                writer.key("alias_of");
+                writer.value(permutation.alias_of);
+            }
+            WriteStageCosts(writer, permutation.costs);
+            writer.key("defines");
+            writer.beginObject();
+            for (const auto& define : permutation.defines) {
+                writer.key(define.first);
+                writer.value(define.second);
+            }
+            writer.endObject();
+            writer.key("layout");
+            writer.value(permutation.layout);
+            if (!permutation.hashes.spvs.empty()) {
+                writer.key("layout_hash");
+                writer.value(permutation.hashes.layout.toHex());
+            }
+            writer.key("name");
+            writer.value(permutation.name);
+            WritePipelineHash(writer, permutation.hashes);
+            WriteSpvHashes(writer, permutation.hashes);
+            writer.key("spvs");
+            writer.beginObject();
+            for (const auto& spv : permutation.spvs) {
+                writer.key(spv.first);
+                writer.value(spv.second);
+            }
+            writer.endObject();
+            writer.endObject();
+        }
+        writer.endArray();
+    }
+    WritePipelineHash(writer, m_hashes);
+    WriteReflectionPushConstantRanges(writer, m_reflection);
+    WriteSpvHashes(writer, m_hashes);
+    writer.key("spvs");
+    writer.beginObject();
+    for (const auto& spv : m_spvs) {
+        writer.key(spv.first);
+        writer.value(spv.second);
+    }
+    writer.endObject();
+    WriteReflectionVariables(writer, m_reflection);
+    WriteReflectionVertexInput(writer, m_reflection);
+    writer.endObject();
+    return out;
+}
+
+std::string ShaderDescriptor::toBinary() const {
+    return EncodeBinaryDescriptor(m_reflection, m_spvs, m_hashes);
+}
+
+void ShaderDescriptor::setQualifier(const glslang::TType* type, ReflectedQualifier& reflected, const char* variable_name,
+    uint32_t count) {
     const auto& qualifier = type->getQualifier();
+    ReflectedBinding binding;
     if (qualifier.hasBinding()) {
-        json["binding"] = qualifier.layoutBinding;
-        m_bindings[variable_name]["set"] = 0;
-        m_bindings[variable_name]["binding"] = qualifier.layoutBinding;
-        m_bindings[variable_name]["type"] = getDescriptorType(*type);
+        reflected.binding = qualifier.layoutBinding;
+        binding.set = 0;
+        binding.binding = qualifier.layoutBinding;
+        binding.type = getDescriptorType(*type);
+        binding.count = count;
     }
     if (qualifier.hasLocation())
-        json["location"] = qualifier.layoutLocation;
+        reflected.location = qualifier.layoutLocation;
     if (qualifier.hasSet()) {
-        if (qualifier.layoutSet + 1 > m_max_set) {
-            m_max_set = qualifier.layoutSet + 1;
+        if (qualifier.layoutSet + 1 > m_reflection.sets_count) {
+            m_reflection.sets_count = qualifier.layoutSet + 1;
         }
-        json["set"] = qualifier.layoutSet;
-        m_bindings[variable_name]["set"] = qualifier.layoutSet;
+        reflected.set = qualifier.layoutSet;
+        binding.set = qualifier.layoutSet;
+    }
+    // Bindings of the same name are merged by ProgramReflection::finalize().
+    if (qualifier.hasBinding() || qualifier.hasSet()) {
+        binding.name = variable_name;
+        m_reflection.bindings.push_back(binding);
+    }
+}
+
+const char* ShaderDescriptor::internBasicType(const glslang::TType& type) {
+    // Only sampler types need the TString; the others are static names.
+    if (type.getBasicType() == glslang::EbtSampler) {
+        return m_reflection.intern(type.getBasicTypeString().c_str());
     }
+    return m_reflection.intern(glslang::TType::getBasicString(type.getBasicType()));
 }
 
 int ShaderDescriptor::getTypeDef(const bool vulkan_def, const int attri_type) {
     return vulkan_def ? AttributeGL2Vulkan(attri_type) : attri_type;
 }
 
-void ShaderDescriptor::writeBasicType(JSON& j, const glslang::TType& type) {
+void ShaderDescriptor::countDescriptor(const glslang::TType& type, uint32_t count) {
     const auto desc_type = getDescriptorType(type);
     if(desc_type != VK_DESCRIPTOR_TYPE_MAX_ENUM)
-        ++m_descriptor_pool[desc_type];
-    j["basic_type"] = type.getBasicTypeString().c_str();
+        m_reflection.descriptor_pool[desc_type] += count;
 }
 
-void ShaderDescriptor::writeAttributesJSON(const glslang::TProgram& program, JSON& config_json, const bool vulkan_def) {
-    JSON attributes_json;
+void ShaderDescriptor::reflectAttributes(const glslang::TProgram& program, const bool vulkan_def) {
     auto attributes_size = program.getNumLiveAttributes();
     for (int i = 0; i < attributes_size; ++i) {
-        JSON attri_json;
-        auto attribute_type = program.getAttributeType(i);
-        attri_json["type"] = getTypeDef(vulkan_def, attribute_type);
+        ReflectedAttribute attribute;
+        attribute.type = getTypeDef(vulkan_def, program.getAttributeType(i));
 
         const auto& type = program.getAttributeTType(i);
-        writeBasicType(attri_json, *type);
-        attri_json["vector_size"] = type->getVectorSize();
+        attribute.name = m_reflection.intern(program.getAttributeName(i));
+        attribute.basic_type = internBasicType(*type);
+        attribute.vector_size = type->getVectorSize();
+        if (type->isMatrix()) {
+            attribute.matrix_columns = type->getMatrixCols();
+            attribute.matrix_rows = type->getMatrixRows();
+        }
+        if (type->isSizedArray()) {
+            attribute.array_size = type->getCumulativeArraySize();
+        }
 
-        setQualifier(type, attri_json, program.getAttributeName(i));
+        setQualifier(type, attribute.qualifier, attribute.name);
 
         const auto& qualifier = type->getQualifier();
         if (qualifier.layoutPushConstant == false) {
-            attributes_json[program.getAttributeName(i)] = attri_json;
-        }
-        else {
-            continue;
+            m_reflection.attributes.push_back(attribute);
         }
     }
-    if (attributes_size > 0)
-        config_json["attributes"] = attributes_json;
-    m_attributes_count += attributes_size;
+    m_reflection.attributes_count += attributes_size;
 }
 
-void ShaderDescriptor::writeUniformBlocksJSON(const glslang::TProgram& program, JSON& config_json) {
-    JSON uniform_blocks_json;
+void ShaderDescriptor::reflectUniformBlocks(const glslang::TProgram& program) {
     auto uniform_blks_size = program.getNumLiveUniformBlocks();
     for (int i = 0; i < uniform_blks_size; ++i) {
-        JSON uniform_blk_json;
-        uniform_blk_json["block_size"] = program.getUniformBlockSize(i);
+        ReflectedUniformBlock block;
+        block.block_size = program.getUniformBlockSize(i);
 
         const auto& type = program.getUniformBlockTType(i);
-        writeBasicType(uniform_blk_json, *type);
+        countDescriptor(*type);
+        block.name = m_reflection.intern(program.getUniformBlockName(i));
+        block.basic_type = internBasicType(*type);
 
-        setQualifier(type, uniform_blk_json, program.getUniformBlockName(i));
+        setQualifier(type, block.qualifier, block.name);
 
         const auto& qualifier = type->getQualifier();
         auto offset = program.getUniformBufferOffset(i);
         if (offset >= 0 && qualifier.layoutPushConstant == false) {
-            uniform_blk_json["offset"] = offset;
+            block.offset = offset;
         }
 
-        auto name = program.getUniformBlockName(i);
         if (qualifier.layoutPushConstant == false) {
-            uniform_blocks_json[program.getUniformBlockName(i)] = uniform_blk_json;
+            reflectBlockLayout(*type, block);
+            m_reflection.uniform_blocks.push_back(block);
         }
-        else {
-            continue;
+    }
+    m_reflection.uniform_blocks_count += uniform_blks_size;
+}
+
+void ShaderDescriptor::reflectBlockLayout(const glslang::TType& type, ReflectedUniformBlock& block) {
+    const auto& qualifier = type.getQualifier();
+    LayoutPacking packing;
+    switch (qualifier.layoutPacking) {
+    case glslang::ElpStd140:
+        packing = kPackingStd140;
+        break;
+    case glslang::ElpStd430:
+        packing = kPackingStd430;
+        break;
+    case glslang::ElpScalar:
+        packing = kPackingScalar;
+        break;
+    default:
+        // shared and packed leave the layout to the driver.
+        return;
+    }
+
+    // glslang gives every top-level member its offset, explicit or not, so
+    // the layout is first made without them: when it lands on the same
+    // offsets, none was forced and a better order may be suggested.
+    const bool row_major = qualifier.layoutMatrix == glslang::ElmRowMajor;
+    std::vector<LayoutType::Member> members;
+    std::vector<uint32_t> offsets;
+    for (const auto& field : *type.getStruct()) {
+        const auto& field_qualifier = field.type->getQualifier();
+        auto member = GetLayoutMember(*field.type, row_major);
+        if (field_qualifier.hasAlign()) {
+            member.align = field_qualifier.layoutAlign;
+        }
+        if (qualifier.hasAlign()) {
+            member.align = std::max<uint32_t>(member.align, qualifier.layoutAlign);
         }
+        offsets.push_back(field_qualifier.hasOffset() ? field_qualifier.layoutOffset : 0xFFFFFFFF);
+        members.push_back(member);
     }
-    if (uniform_blks_size > 0)
-        config_json["uniform_blocks"] = uniform_blocks_json;
-    m_uniform_blocks_count += uniform_blks_size;
+
+    auto layout = LayOutBlock(members, packing);
+    bool forced = false;
+    for (size_t i = 0; i < members.size(); ++i) {
+        const auto& name = members[i].name;
+        const auto it = std::find_if(layout.members.begin(), layout.members.end(), [&](const MemberLayout& member) {
+            return member.name == name;
+        });
+        if (offsets[i] != 0xFFFFFFFF && it->offset != offsets[i]) {
+            forced = true;
+        }
+    }
+    if (forced) {
+        for (size_t i = 0; i < members.size(); ++i) {
+            members[i].explicit_offset = offsets[i];
+        }
+        layout = LayOutBlock(members, packing);
+    }
+
+    // A layout glslang disagrees with is worse than none.
+    if (layout.size > block.block_size) {
+        return;
+    }
+
+    for (const auto& member : layout.members) {
+        ReflectedBlockMember reflected;
+        reflected.name = m_reflection.intern(member.name.c_str());
+        reflected.offset = member.offset;
+        reflected.size = member.size;
+        reflected.array_stride = member.array_stride;
+        reflected.matrix_stride = member.matrix_stride;
+        block.members.push_back(reflected);
+    }
+    block.padding_bytes = layout.padding_bytes;
+    for (const auto& name : layout.suggested_order) {
+        block.suggested_order.push_back(m_reflection.intern(name.c_str()));
+    }
+    block.suggested_size = layout.suggested_size;
 }
 
-void ShaderDescriptor::writeUniformVariablesJSON(const glslang::TProgram& program, JSON& config_json) {
-    JSON uniform_variables_json;
+void ShaderDescriptor::reflectUniformVariables(const glslang::TProgram& program) {
     auto uniform_vars_size = program.getNumLiveUniformVariables();
     for (int i = 0; i < uniform_vars_size; ++i) {
         auto index = program.getUniformBlockIndex(i);
@@ -202,49 +462,95 @@ void ShaderDescriptor::writeUniformVariablesJSON(const glslang::TProgram& progra
             continue;
         }
 
-        JSON uniform_var_json;
+        ReflectedUniformVariable variable;
 
         const auto& type = program.getUniformTType(i);
-        writeBasicType(uniform_var_json, *type);
+        // Arrays of opaque types are one entry, one descriptor per element.
+        const uint32_t count = std::max(1, program.getUniformArraySize(i));
+        countDescriptor(*type, count);
+        variable.name = m_reflection.intern(program.getUniformName(i));
+        variable.basic_type = internBasicType(*type);
         if (type->getBasicType() == glslang::EbtSampler) {
             auto sampler = type->getSampler();
-            JSON sampler_json;
-            sampler_json["dim"] = sampler.dim;
-            sampler_json["type"] = sampler.type;
-            sampler_json["combined"] = sampler.combined;
-            uniform_var_json["sampler"] = sampler_json;
+            variable.has_sampler = true;
+            variable.sampler.dim = sampler.dim;
+            variable.sampler.type = sampler.type;
+            variable.sampler.combined = sampler.combined;
         }
 
         auto offset = program.getUniformBufferOffset(i);
         if (offset >= 0) {
-            uniform_var_json["offset"] = offset;
+            variable.offset = offset;
         }
 
-        setQualifier(type, uniform_var_json, program.getUniformName(i));
+        setQualifier(type, variable.qualifier, variable.name, count);
+
+        m_reflection.uniform_variables.push_back(variable);
+    }
+    m_reflection.uniform_variables_count += uniform_vars_size;
+}
+
+void ShaderDescriptor::reflectStorageBlocks(const glslang::TProgram& program) {
+    auto storage_blks_size = program.getNumBufferBlocks();
+    for (int i = 0; i < storage_blks_size; ++i) {
+        const auto& reflected = program.getBufferBlock(i);
+        ReflectedStorageBlock block;
+        block.name = m_reflection.intern(reflected.name.c_str());
+        block.block_size = reflected.size;
 
-        uniform_variables_json[program.getUniformName(i)] = uniform_var_json;
+        const auto& type = reflected.getType();
+        countDescriptor(*type);
+        block.basic_type = internBasicType(*type);
+
+        setQualifier(type, block.qualifier, block.name);
+
+        m_reflection.storage_blocks.push_back(block);
+    }
+}
+
+void ShaderDescriptor::reflectCompute(const glslang::TProgram& program) {
+    // The shared memory size needs the SPIR-V, see WorkgroupMemorySize.
+    m_reflection.compute.local_size_x = program.getLocalSize(0);
+    m_reflection.compute.local_size_y = program.getLocalSize(1);
+    m_reflection.compute.local_size_z = program.getLocalSize(2);
+}
+
+void ShaderDescriptor::writeSpvs(Config& config) {
+    m_spvs.clear();
+    for (auto s : config.getStages()) {
+        m_spvs[config.getShaderBinFilename(s)] = s;
     }
-    if (uniform_vars_size > 0)
-        config_json["uniform_variables"] = uniform_variables_json;
-    m_uniform_variables_count += uniform_vars_size;
 }
 
 VkDescriptorType ShaderDescriptor::getDescriptorType(const glslang::TType& type)
 {
+    // Push constants take no descriptor.
     VkDescriptorType ret = VK_DESCRIPTOR_TYPE_MAX_ENUM;
-    std::string basic_type(type.getBasicTypeString().c_str());
-    std::size_t found = basic_type.find("sampler");
-    if (found != std::string::npos) {
-        const auto sampler = type.getSampler();
-        if (sampler.combined) {
+    if (type.getBasicType() == glslang::EbtSampler) {
+        const auto& sampler = type.getSampler();
+        if (sampler.isSubpass()) {
+            ret = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        }
+        else if (sampler.isPureSampler()) {
+            ret = VK_DESCRIPTOR_TYPE_SAMPLER;
+        }
+        else if (sampler.isImage()) {
+            ret = sampler.dim == glslang::EsdBuffer ?
+                VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        }
+        else if (sampler.dim == glslang::EsdBuffer) {
+            ret = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        }
+        else if (sampler.combined) {
             ret = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         }
         else {
-            ret = VK_DESCRIPTOR_TYPE_SAMPLER;
+            ret = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
         }
     }
-    else if (basic_type == "block") {
-        ret = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    else if (type.getBasicType() == glslang::EbtBlock && !type.getQualifier().layoutPushConstant) {
+        ret = type.getQualifier().storage == glslang::EvqBuffer ?
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     }
     return ret;
 }
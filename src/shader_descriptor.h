@@ -1,44 +1,81 @@
 #pragma once
 #include <vector>
+#include <map>
+#include <string>
 #include <json.hpp>
 #include <ShaderLang.h>
 #include <GlslangToSpv.h>
 #include <vulkan/vulkan.h>
 #include "gl2vulkan.h"
+#include "reflection.h"
+#include "content_hash.h"
 using JSON = nlohmann::json;
 
 class Config;
 
+// One entry of the "permutations" table of a define matrix .sd, see
+// CompilePermutations.
+struct DescriptorPermutation {
+    std::string name;
+    std::map<std::string, std::string> defines;
+    // The permutation with the same preprocessed text that was built
+    // instead, or kReflectionAbsent.
+    uint32_t alias_of = kReflectionAbsent;
+    // Left out of its layout, which permutations share.
+    std::vector<ReflectedStageCost> costs;
+    std::map<std::string, uint32_t> spvs;
+    ProgramHashes hashes;
+    // Index into the "layouts" of the .sd.
+    uint32_t layout = 0;
+};
+
 class ShaderDescriptor {
 public:
     ShaderDescriptor();
-    ~ShaderDescriptor() {
-        for (auto p : dummy_programs) {
-            if (p)
-                delete p;
-        }
-    };
-
-    void buildPushConstants(glslang::TShader* p_shader, Config& config);
+    ~ShaderDescriptor() {};
+
+    void buildPushConstants(const glslang::TProgram& program, Config& config);
     void processProgram(glslang::TProgram& program, Config& config);
-    void writeFile(std::string filename);
+    // compact leaves out all whitespace.
+    void writeFile(std::string filename, bool only_if_changed = false, bool compact = false);
+    // Writes the binary format of binary_descriptor.h instead of JSON.
+    void writeBinaryFile(std::string filename, bool only_if_changed = false);
+
+    // Everything processProgram reflected except the output file names, so
+    // it can be cached and later restored for a differently named output.
+    const ProgramReflection& getReflection() const { return m_reflection; }
+    void loadReflection(const ProgramReflection& reflection, Config& config);
+    // Hashes the modules "spvs" names, as they are written, for
+    // "spv_hashes", "layout_hash" and "pipeline_hash"; until then those
+    // are left out.
+    void hashModules(const std::map<VkShaderStageFlagBits, std::vector<unsigned int>>& spirv);
+    void setPermutations(const std::vector<DescriptorPermutation>& permutations, const std::vector<ProgramReflection>& layouts);
+
+    // The documents writeFile() and writeBinaryFile() write.
+    std::string toJSON(bool compact) const;
+    std::string toBinary() const;
 
 private:
-    void setQualifier(const glslang::TType* type, JSON& json, const char* variable_name);
+    // count is the number of descriptors behind the variable, its array size.
+    void setQualifier(const glslang::TType* type, ReflectedQualifier& qualifier, const char* variable_name,
+        uint32_t count = 1);
     int getTypeDef(const bool vulkan_def, const int attri_type);
-    void writeBasicType(JSON& j, const glslang::TType& type);
-    void writeAttributesJSON(const glslang::TProgram& program, JSON& config_json, const bool vulkan_def);
-    void writeUniformBlocksJSON(const glslang::TProgram& program, JSON& config_json);
-    void writeUniformVariablesJSON(const glslang::TProgram& program, JSON& config_json);
+    void countDescriptor(const glslang::TType& type, uint32_t count = 1);
+    const char* internBasicType(const glslang::TType& type);
+    void reflectAttributes(const glslang::TProgram& program, const bool vulkan_def);
+    void mergePushConstantRanges(std::vector<ReflectedPushConstantRange>& stage_ranges);
+    void reflectUniformBlocks(const glslang::TProgram& program);
+    // Member offsets, strides, padding and a better order, see block_layout.h.
+    void reflectBlockLayout(const glslang::TType& type, ReflectedUniformBlock& block);
+    void reflectUniformVariables(const glslang::TProgram& program);
+    void reflectStorageBlocks(const glslang::TProgram& program);
+    void reflectCompute(const glslang::TProgram& program);
+    void writeSpvs(Config& config);
     VkDescriptorType getDescriptorType(const glslang::TType& type);
 
-    JSON m_base;
-    uint32_t m_attributes_count = 0;
-    uint32_t m_uniform_blocks_count = 0;
-    uint32_t m_uniform_variables_count = 0;
-    uint32_t m_max_set = 1;
-    JSON m_push_constants;
-    std::vector<uint32_t> m_descriptor_pool;
-    std::vector<glslang::TProgram*> dummy_programs;
-    JSON m_bindings;
-};
\ No newline at end of file
+    ProgramReflection m_reflection;
+    std::map<std::string, uint32_t> m_spvs;
+    ProgramHashes m_hashes;
+    std::vector<DescriptorPermutation> m_permutations;
+    std::vector<ProgramReflection> m_layouts;
+};
@@ -0,0 +1,110 @@
+#include <sstream>
+#include "shader_generator.h"
+
+namespace {
+// The innermost value of the struct nested in a uniform block.
+std::string NestedValue(uint32_t block, uint32_t struct_depth) {
+    std::string path = "block_" + std::to_string(block) + ".nested";
+    for (uint32_t d = 1; d < struct_depth; ++d) {
+        path += ".inner";
+    }
+    return path + ".value";
+}
+
+std::string GenerateVertex(const SyntheticShaderParams& params) {
+    std::ostringstream source;
+    source << "#version 450\n";
+    for (uint32_t i = 0; i < params.attributes; ++i) {
+        source << "layout(location=" << i << ") in vec4 in_attribute_" << i << ";\n";
+    }
+    source << "layout(push_constant) uniform Transform {\n"
+        << "    mat4 world_view_project;\n"
+        << "} transform;\n"
+        << "layout(location=0) out vec4 out_color;\n"
+        << "out gl_PerVertex {\n"
+        << "    vec4 gl_Position;\n"
+        << "};\n"
+        << "void main() {\n"
+        << "    vec4 sum = vec4(1.0);\n";
+    for (uint32_t i = 0; i < params.attributes; ++i) {
+        source << "    sum += in_attribute_" << i << ";\n";
+    }
+    source << "    out_color = sum;\n"
+        << "    gl_Position = transform.world_view_project * sum;\n"
+        << "}\n";
+    return source.str();
+}
+
+std::string GenerateFragmentDeclarations(const SyntheticShaderParams& params) {
+    std::ostringstream source;
+    source << "#version 450\n";
+    for (uint32_t d = 0; d < params.struct_depth; ++d) {
+        source << "struct Nested" << d << " {\n";
+        if (d > 0) {
+            source << "    Nested" << d - 1 << " inner;\n";
+        }
+        source << "    vec4 value;\n"
+            << "};\n";
+    }
+    for (uint32_t b = 0; b < params.uniform_blocks; ++b) {
+        source << "layout(set=0, binding=" << b << ") uniform Block" << b << " {\n";
+        if (params.struct_depth > 0) {
+            source << "    Nested" << params.struct_depth - 1 << " nested;\n";
+        }
+        source << "    vec4 values[4];\n"
+            << "} block_" << b << ";\n";
+    }
+    for (uint32_t s = 0; s < params.samplers; ++s) {
+        source << "layout(set=1, binding=" << s << ") uniform sampler2D sampler_" << s << ";\n";
+    }
+    source << "layout(location=0) in vec4 in_color;\n"
+        << "layout(location=0) out vec4 out_color;\n";
+    return source.str();
+}
+
+std::string GenerateHelper(uint32_t index) {
+    std::ostringstream source;
+    source << "vec4 helper_" << index << "(vec4 v) {\n"
+        << "    return v * " << index + 1 << ".0 + vec4(0.5);\n"
+        << "}\n";
+    return source.str();
+}
+
+std::string GenerateFragmentMain(const SyntheticShaderParams& params) {
+    std::ostringstream source;
+    source << "void main() {\n"
+        << "    vec4 color = in_color;\n";
+    for (uint32_t s = 0; s < params.samplers; ++s) {
+        source << "    color += texture(sampler_" << s << ", color.xy);\n";
+    }
+    for (uint32_t l = 0; l < params.loops; ++l) {
+        source << "    for (int i = 0; i < 4; ++i) {\n";
+        for (uint32_t b = 0; b < params.uniform_blocks; ++b) {
+            source << "        color += block_" << b << ".values[i] * " << l + 1 << ".0";
+            if (params.struct_depth > 0) {
+                source << " + " << NestedValue(b, params.struct_depth);
+            }
+            source << ";\n";
+        }
+        source << "        color = color * 0.5 + vec4(float(i));\n"
+            << "    }\n";
+    }
+    for (uint32_t h = 0; h < params.includes; ++h) {
+        source << "    color = helper_" << h << "(color);\n";
+    }
+    source << "    out_color = color;\n"
+        << "}\n";
+    return source.str();
+}
+}
+
+SyntheticProgram GenerateSyntheticProgram(const SyntheticShaderParams& params) {
+    SyntheticProgram program;
+    program.vertex.push_back(GenerateVertex(params));
+    program.fragment.push_back(GenerateFragmentDeclarations(params));
+    for (uint32_t h = 0; h < params.includes; ++h) {
+        program.fragment.push_back(GenerateHelper(h));
+    }
+    program.fragment.push_back(GenerateFragmentMain(params));
+    return program;
+}
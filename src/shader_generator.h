@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Sizes of a synthetic program; each one scales one part of the shader so
+// the phases of a compile can be measured against it.
+struct SyntheticShaderParams {
+    // Fragment uniform blocks, each holding a nested struct and an array.
+    uint32_t uniform_blocks = 1;
+    // Fragment combined image samplers.
+    uint32_t samplers = 1;
+    // Vertex input attributes.
+    uint32_t attributes = 1;
+    // Structs nested inside every uniform block.
+    uint32_t struct_depth = 1;
+    // Loops in the fragment main, each reading every uniform block.
+    uint32_t loops = 1;
+    // Helper functions passed to glslang as separate source strings, the
+    // way an #include expands into its own chunk of text.
+    uint32_t includes = 0;
+};
+
+// Source strings of a vertex and a fragment stage; the first string of a
+// stage holds the #version line.
+struct SyntheticProgram {
+    std::vector<std::string> vertex;
+    std::vector<std::string> fragment;
+};
+
+// Deterministic for given params, so runs can be compared with each other.
+SyntheticProgram GenerateSyntheticProgram(const SyntheticShaderParams& params);
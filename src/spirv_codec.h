@@ -0,0 +1,298 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// Compressed .sr format. The SPIR-V words are rewritten as a byte stream of
+// LEB128 varints laid out per opcode:
+//
+//     header   version, generator, bound, schema (the magic is implied)
+//     per instruction
+//         tag          opcode << 4 | min(word count - 1, 15)
+//                      [word count - 16 when the count did not fit]
+//         result type  zigzag delta from the previous result type
+//         result id    zigzag delta from the previous result id + 1
+//         operands     ID operands of the opcode as zigzag distance back
+//                      from the last result id, everything else as is
+//
+// All arithmetic wraps at 32 bits, so the stream reproduces any word
+// sequence exactly; the opcode table only decides how small it gets.
+// With kCsEntropy the varint stream is additionally coded with an order-0
+// rANS coder, preceded by its symbol frequencies.
+//
+//     CsHeader
+//     [symbol count, then symbol and frequency varints]  (kCsEntropy)
+//     payload
+
+const uint32_t kCsMagic = 0x53435253; // "SRCS"
+const uint32_t kCsVersion = 1;
+const uint32_t kCsEntropy = 0x1;
+
+const uint32_t kCsRansScaleBits = 12;
+const uint32_t kCsRansScale = 1u << kCsRansScaleBits;
+const uint32_t kCsRansLow = 1u << 23;
+
+struct CsHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;
+    // Of the decoded module.
+    uint32_t word_count;
+    // Of the varint stream, before the entropy stage.
+    uint32_t stream_size;
+};
+
+enum CsOperandLayout : uint8_t {
+    kCsHasType = 0x10,
+    kCsHasResult = 0x20,
+    // The low nibble is the number of leading operands (after the result)
+    // that are IDs; kCsAllIds when every operand is.
+    kCsAllIds = 0x0F,
+};
+
+// Layout of the operands of an opcode. Unknown opcodes are encoded as raw
+// varints, which only costs size.
+inline uint8_t CsOpcodeLayout(uint32_t opcode) {
+    const uint8_t value = kCsHasType | kCsHasResult;
+    if (opcode >= 19 && opcode <= 38) {
+        return kCsHasResult | kCsAllIds;              // OpType*
+    }
+    if (opcode >= 126 && opcode <= 215) {
+        return value | kCsAllIds;                     // arithmetic, relational, derivatives
+    }
+    if (opcode >= 109 && opcode <= 124) {
+        return value | 1;                             // conversions
+    }
+    if (opcode >= 86 && opcode <= 107) {
+        return value | 2;                             // image instructions
+    }
+    if (opcode >= 227 && opcode <= 242) {
+        return value | 1;                             // atomics
+    }
+    switch (opcode) {
+    case 1:                                           // OpUndef
+    case 41: case 42: case 43: case 45: case 46:      // OpConstant*
+    case 48: case 49: case 50:                        // OpSpecConstant*
+    case 55:                                          // OpFunctionParameter
+    case 59:                                          // OpVariable
+        return value;
+    case 7:                                           // OpString
+    case 11:                                          // OpExtInstImport
+    case 248:                                         // OpLabel
+        return kCsHasResult;
+    case 12:                                          // OpExtInst
+        return value | 1;
+    case 44: case 51:                                 // OpConstantComposite
+    case 57:                                          // OpFunctionCall
+    case 60: case 61:                                 // OpImageTexelPointer, OpLoad
+    case 84:                                          // OpCopyObject
+    case 85:                                          // OpTranspose
+    case 245:                                         // OpPhi
+    case 80:                                          // OpCompositeConstruct
+        return value | kCsAllIds;
+    case 54:                                          // OpFunction
+        return value;
+    case 62: case 63:                                 // OpStore, OpCopyMemory
+        return kCsAllIds;
+    case 65: case 66: case 67: case 68:               // access chains, OpArrayLength
+    case 81:                                          // OpCompositeExtract
+    case 77:                                          // OpVectorExtractDynamic
+        return value | 1;
+    case 78: case 79: case 82:                        // vector insert/shuffle, OpCompositeInsert
+        return value | 2;
+    case 254:                                         // OpReturnValue
+        return kCsAllIds;
+    default:
+        return 0;
+    }
+}
+
+inline uint32_t CsZigzag(uint32_t delta) {
+    return (delta << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31);
+}
+
+inline uint32_t CsUnzigzag(uint32_t value) {
+    return (value >> 1) ^ (0u - (value & 1));
+}
+
+template<typename Reader>
+inline uint32_t CsReadVarint(Reader& reader) {
+    uint32_t value = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+        const uint8_t byte = reader.next();
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    return value;
+}
+
+// Reads the varint stream straight from the file.
+class CsRawReader {
+public:
+    CsRawReader(const uint8_t* p_data, size_t size) : m_p(p_data), m_p_end(p_data + size) {}
+
+    uint8_t next() {
+        if (m_p == m_p_end) {
+            m_failed = true;
+            return 0;
+        }
+        return *m_p++;
+    }
+
+    bool failed() const { return m_failed; }
+    size_t remaining() const { return m_p_end - m_p; }
+
+private:
+    const uint8_t* m_p;
+    const uint8_t* m_p_end;
+    bool m_failed = false;
+};
+
+// Produces the varint stream by decoding the rANS payload byte by byte, so
+// the two stages run in one pass without an intermediate buffer.
+class CsRansReader {
+public:
+    CsRansReader(const uint8_t* p_data, size_t size, uint32_t stream_size) : m_p_end(p_data + size), m_remaining(stream_size) {
+        CsRawReader table(p_data, size);
+        uint32_t symbol_count = CsReadVarint(table);
+        uint32_t cumulative = 0;
+        for (uint32_t i = 0; i < symbol_count && !table.failed(); ++i) {
+            const uint32_t symbol = table.next();
+            const uint32_t frequency = CsReadVarint(table);
+            if (frequency == 0 || cumulative + frequency > kCsRansScale) {
+                m_failed = true;
+                return;
+            }
+            m_frequency[symbol] = static_cast<uint16_t>(frequency);
+            m_start[symbol] = static_cast<uint16_t>(cumulative);
+            std::memset(m_symbols + cumulative, static_cast<int>(symbol), frequency);
+            cumulative += frequency;
+        }
+        m_p = p_data + (size - table.remaining());
+        if (table.failed() || (cumulative != kCsRansScale && m_remaining > 0) || m_p_end - m_p < 4) {
+            m_failed = true;
+            return;
+        }
+        std::memcpy(&m_state, m_p, 4);
+        m_p += 4;
+    }
+
+    uint8_t next() {
+        if (m_remaining == 0 || m_failed) {
+            m_failed = true;
+            return 0;
+        }
+        --m_remaining;
+        const uint32_t slot = m_state & (kCsRansScale - 1);
+        const uint8_t symbol = m_symbols[slot];
+        m_state = m_frequency[symbol] * (m_state >> kCsRansScaleBits) + slot - m_start[symbol];
+        while (m_state < kCsRansLow) {
+            if (m_p == m_p_end) {
+                m_failed = true;
+                return 0;
+            }
+            m_state = (m_state << 8) | *m_p++;
+        }
+        return symbol;
+    }
+
+    bool failed() const { return m_failed; }
+
+private:
+    const uint8_t* m_p = nullptr;
+    const uint8_t* m_p_end;
+    uint32_t m_remaining;
+    uint32_t m_state = 0;
+    bool m_failed = false;
+    uint16_t m_frequency[256] = {};
+    uint16_t m_start[256] = {};
+    uint8_t m_symbols[kCsRansScale] = {};
+};
+
+// Reconstructs word_count SPIR-V words from the varint stream.
+template<typename Reader>
+inline bool CsDecodeWords(Reader& reader, uint32_t* p_words, uint32_t word_count) {
+    const size_t kHeaderWords = 5;
+    if (word_count < kHeaderWords) {
+        return false;
+    }
+    p_words[0] = 0x07230203;
+    for (size_t i = 1; i < kHeaderWords; ++i) {
+        p_words[i] = CsReadVarint(reader);
+    }
+
+    uint32_t last_type = 0;
+    uint32_t last_result = 0;
+    size_t offset = kHeaderWords;
+    while (offset < word_count && !reader.failed()) {
+        const uint32_t tag = CsReadVarint(reader);
+        const uint32_t opcode = tag >> 4;
+        uint32_t length = (tag & 0xF) + 1;
+        if (length == 16) {
+            length += CsReadVarint(reader);
+        }
+        if (length > word_count - offset) {
+            return false;
+        }
+        uint32_t* p_instruction = p_words + offset;
+        p_instruction[0] = (length << 16) | opcode;
+
+        const uint8_t layout = CsOpcodeLayout(opcode);
+        uint32_t w = 1;
+        if ((layout & kCsHasType) != 0 && w < length) {
+            last_type += CsUnzigzag(CsReadVarint(reader));
+            p_instruction[w++] = last_type;
+        }
+        if ((layout & kCsHasResult) != 0 && w < length) {
+            last_result += 1 + CsUnzigzag(CsReadVarint(reader));
+            p_instruction[w++] = last_result;
+        }
+        const uint32_t id_end = (layout & kCsAllIds) == kCsAllIds ? length : w + (layout & kCsAllIds);
+        for (; w < length; ++w) {
+            const uint32_t value = CsReadVarint(reader);
+            p_instruction[w] = w < id_end ? last_result - CsUnzigzag(value) : value;
+        }
+        offset += length;
+    }
+    return offset == word_count && !reader.failed();
+}
+
+// Number of words a compressed module decodes to, or 0 when data is not one.
+inline uint32_t CsDecodedWordCount(const void* p_data, size_t size) {
+    CsHeader header;
+    if (size < sizeof(header)) {
+        return 0;
+    }
+    std::memcpy(&header, p_data, sizeof(header));
+    if (header.magic != kCsMagic || header.version != kCsVersion) {
+        return 0;
+    }
+    return header.word_count;
+}
+
+// Decodes a compressed module into p_words, which must hold
+// CsDecodedWordCount() words. Both stages run in one pass.
+inline bool CsDecode(const void* p_data, size_t size, uint32_t* p_words) {
+    const uint32_t word_count = CsDecodedWordCount(p_data, size);
+    if (word_count == 0) {
+        return false;
+    }
+    CsHeader header;
+    std::memcpy(&header, p_data, sizeof(header));
+    const uint8_t* p_payload = static_cast<const uint8_t*>(p_data) + sizeof(header);
+    const size_t payload_size = size - sizeof(header);
+    if ((header.flags & kCsEntropy) != 0) {
+        CsRansReader reader(p_payload, payload_size, header.stream_size);
+        return !reader.failed() && CsDecodeWords(reader, p_words, word_count);
+    }
+    CsRawReader reader(p_payload, payload_size);
+    return CsDecodeWords(reader, p_words, word_count);
+}
+
+inline bool CsDecode(const void* p_data, size_t size, std::vector<uint32_t>& words) {
+    words.resize(CsDecodedWordCount(p_data, size));
+    return !words.empty() && CsDecode(p_data, size, words.data());
+}
@@ -0,0 +1,109 @@
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <iomanip>
+#include <exception>
+#include "spirv_codec_benchmark.h"
+#include "spirv_codec_writer.h"
+
+namespace {
+const double kMinBenchmarkSeconds = 0.2;
+
+struct CodecResult {
+    size_t bytes = 0;
+    // Decoded bytes per second.
+    double throughput = 0.0;
+};
+
+bool LoadSpirv(const std::string& path, std::vector<unsigned int>& spirv) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (CsDecodedWordCount(data.data(), data.size()) > 0) {
+        std::vector<uint32_t> words;
+        if (!CsDecode(data.data(), data.size(), words)) {
+            return false;
+        }
+        spirv.assign(words.begin(), words.end());
+        return true;
+    }
+    spirv.resize(data.size() / sizeof(unsigned int));
+    std::memcpy(spirv.data(), data.data(), spirv.size() * sizeof(unsigned int));
+    return spirv.size() >= 5 && spirv[0] == 0x07230203;
+}
+
+bool Measure(const std::vector<unsigned int>& spirv, bool entropy, CodecResult& result) {
+    const std::string encoded = EncodeCompressedSpirv(spirv, entropy);
+    result.bytes = encoded.size();
+
+    std::vector<uint32_t> words(spirv.size());
+    if (!CsDecode(encoded.data(), encoded.size(), words.data()) ||
+        !std::equal(words.begin(), words.end(), spirv.begin())) {
+        return false;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    size_t iterations = 0;
+    const auto begin = Clock::now();
+    std::chrono::duration<double> elapsed(0.0);
+    do {
+        for (int i = 0; i < 16; ++i) {
+            CsDecode(encoded.data(), encoded.size(), words.data());
+        }
+        iterations += 16;
+        elapsed = Clock::now() - begin;
+    } while (elapsed.count() < kMinBenchmarkSeconds);
+    result.throughput = iterations * spirv.size() * sizeof(unsigned int) / elapsed.count();
+    return true;
+}
+
+void WriteRow(std::ostream& out, const std::string& name, size_t raw_bytes, const CodecResult& compact, const CodecResult& entropy) {
+    out << name << ": " << raw_bytes << " bytes, compact "
+        << compact.bytes << " (" << static_cast<double>(raw_bytes) / compact.bytes << "x, "
+        << compact.throughput / (1 << 20) << " MB/s), entropy "
+        << entropy.bytes << " (" << static_cast<double>(raw_bytes) / entropy.bytes << "x, "
+        << entropy.throughput / (1 << 20) << " MB/s)" << std::endl;
+}
+}
+
+bool RunCodecBenchmark(const std::vector<std::string>& paths, std::ostream& out) {
+    size_t total_raw = 0;
+    CodecResult total_compact;
+    CodecResult total_entropy;
+    double compact_seconds = 0.0;
+    double entropy_seconds = 0.0;
+
+    out << std::fixed << std::setprecision(2);
+    for (const auto& path : paths) {
+        std::vector<unsigned int> spirv;
+        if (!LoadSpirv(path, spirv)) {
+            out << path << " is not a SPIR-V module." << std::endl;
+            return false;
+        }
+        CodecResult compact;
+        CodecResult entropy;
+        if (!Measure(spirv, false, compact) || !Measure(spirv, true, entropy)) {
+            out << path << " does not round-trip!" << std::endl;
+            return false;
+        }
+        const size_t raw_bytes = spirv.size() * sizeof(unsigned int);
+        WriteRow(out, path, raw_bytes, compact, entropy);
+
+        total_raw += raw_bytes;
+        total_compact.bytes += compact.bytes;
+        total_entropy.bytes += entropy.bytes;
+        compact_seconds += raw_bytes / compact.throughput;
+        entropy_seconds += raw_bytes / entropy.throughput;
+    }
+    if (paths.size() > 1) {
+        total_compact.throughput = total_raw / compact_seconds;
+        total_entropy.throughput = total_raw / entropy_seconds;
+        WriteRow(out, "total", total_raw, total_compact, total_entropy);
+    }
+    out.unsetf(std::ios::floatfield);
+    return true;
+}
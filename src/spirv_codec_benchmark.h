@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+
+// Encodes every .sr file (raw or already compressed) in both compressed
+// forms, then times decoding them; reports the compression ratio and the
+// decode throughput per file and in total. Returns false if a file can not
+// be read or does not round-trip.
+bool RunCodecBenchmark(const std::vector<std::string>& paths, std::ostream& out);
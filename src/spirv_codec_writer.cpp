@@ -0,0 +1,143 @@
+#include <stdexcept>
+#include <algorithm>
+#include "spirv_codec_writer.h"
+
+namespace {
+void WriteVarint(std::string& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+std::string EncodeWords(const std::vector<unsigned int>& spirv) {
+    const size_t kHeaderWords = 5;
+    std::string out;
+    out.reserve(spirv.size() * 2);
+    for (size_t i = 1; i < kHeaderWords; ++i) {
+        WriteVarint(out, spirv[i]);
+    }
+
+    uint32_t last_type = 0;
+    uint32_t last_result = 0;
+    for (size_t offset = kHeaderWords; offset < spirv.size();) {
+        const uint32_t* p_instruction = spirv.data() + offset;
+        const uint32_t opcode = p_instruction[0] & 0xFFFF;
+        const uint32_t length = p_instruction[0] >> 16;
+        if (length == 0 || length > spirv.size() - offset) {
+            throw std::runtime_error("malformed SPIR-V can not be compressed.");
+        }
+        WriteVarint(out, (opcode << 4) | std::min(length - 1, 15u));
+        if (length - 1 >= 15) {
+            WriteVarint(out, length - 16);
+        }
+
+        const uint8_t layout = CsOpcodeLayout(opcode);
+        uint32_t w = 1;
+        if ((layout & kCsHasType) != 0 && w < length) {
+            WriteVarint(out, CsZigzag(p_instruction[w] - last_type));
+            last_type = p_instruction[w++];
+        }
+        if ((layout & kCsHasResult) != 0 && w < length) {
+            WriteVarint(out, CsZigzag(p_instruction[w] - last_result - 1));
+            last_result = p_instruction[w++];
+        }
+        const uint32_t id_end = (layout & kCsAllIds) == kCsAllIds ? length : w + (layout & kCsAllIds);
+        for (; w < length; ++w) {
+            WriteVarint(out, w < id_end ? CsZigzag(last_result - p_instruction[w]) : p_instruction[w]);
+        }
+        offset += length;
+    }
+    return out;
+}
+
+// Scales the byte histogram of data to frequencies summing to kCsRansScale,
+// keeping every byte that occurs at least at 1.
+void NormalizeFrequencies(const std::string& data, uint32_t (&frequency)[256]) {
+    uint64_t counts[256] = {};
+    for (unsigned char c : data) {
+        ++counts[c];
+    }
+    uint32_t total = 0;
+    for (int s = 0; s < 256; ++s) {
+        frequency[s] = counts[s] == 0 ? 0 :
+            std::max<uint32_t>(1, static_cast<uint32_t>(counts[s] * kCsRansScale / data.size()));
+        total += frequency[s];
+    }
+    while (total != kCsRansScale) {
+        int largest = static_cast<int>(std::max_element(frequency, frequency + 256) - frequency);
+        if (total > kCsRansScale) {
+            --frequency[largest];
+            --total;
+        }
+        else {
+            ++frequency[largest];
+            ++total;
+        }
+    }
+}
+
+std::string EncodeEntropy(const std::string& stream) {
+    std::string out;
+    if (stream.empty()) {
+        WriteVarint(out, 0);
+        out.append(4, '\0');
+        return out;
+    }
+
+    uint32_t frequency[256];
+    uint32_t start[256];
+    NormalizeFrequencies(stream, frequency);
+    uint32_t symbol_count = 0;
+    for (uint32_t s = 0, cumulative = 0; s < 256; ++s) {
+        start[s] = cumulative;
+        cumulative += frequency[s];
+        symbol_count += frequency[s] != 0;
+    }
+    WriteVarint(out, symbol_count);
+    for (uint32_t s = 0; s < 256; ++s) {
+        if (frequency[s] != 0) {
+            out.push_back(static_cast<char>(s));
+            WriteVarint(out, frequency[s]);
+        }
+    }
+
+    // rANS codes back to front; the bytes come out reversed.
+    std::string reversed;
+    reversed.reserve(stream.size());
+    uint32_t state = kCsRansLow;
+    for (auto it = stream.rbegin(); it != stream.rend(); ++it) {
+        const unsigned char s = *it;
+        const uint32_t limit = ((kCsRansLow >> kCsRansScaleBits) << 8) * frequency[s];
+        while (state >= limit) {
+            reversed.push_back(static_cast<char>(state & 0xFF));
+            state >>= 8;
+        }
+        state = ((state / frequency[s]) << kCsRansScaleBits) + (state % frequency[s]) + start[s];
+    }
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        reversed.push_back(static_cast<char>((state >> shift) & 0xFF));
+    }
+    out.append(reversed.rbegin(), reversed.rend());
+    return out;
+}
+}
+
+std::string EncodeCompressedSpirv(const std::vector<unsigned int>& spirv, bool entropy) {
+    if (spirv.size() < 5 || spirv[0] != 0x07230203) {
+        throw std::runtime_error("malformed SPIR-V can not be compressed.");
+    }
+    const std::string stream = EncodeWords(spirv);
+
+    CsHeader header;
+    header.magic = kCsMagic;
+    header.version = kCsVersion;
+    header.flags = entropy ? kCsEntropy : 0;
+    header.word_count = static_cast<uint32_t>(spirv.size());
+    header.stream_size = static_cast<uint32_t>(stream.size());
+
+    std::string out(reinterpret_cast<const char*>(&header), sizeof(header));
+    out += entropy ? EncodeEntropy(stream) : stream;
+    return out;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "spirv_codec.h"
+
+// Encodes a SPIR-V module in the compressed .sr format read by CsDecode();
+// with entropy the varint stream also goes through the rANS stage.
+std::string EncodeCompressedSpirv(const std::vector<unsigned int>& spirv, bool entropy);
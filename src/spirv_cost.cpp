@@ -0,0 +1,611 @@
+#include <map>
+#include <string>
+#include <algorithm>
+#include "spirv_cost.h"
+
+namespace {
+const uint32_t kSpvMagic = 0x07230203;
+const size_t kHeaderWords = 5;
+const uint32_t kStorageClassFunction = 7;
+const size_t kNoPosition = static_cast<size_t>(-1);
+
+enum SpvOpcode : uint32_t {
+    kOpExtInstImport = 11,
+    kOpExtInst = 12,
+    kOpTypeVoid = 19,
+    kOpTypeBool = 20,
+    kOpTypeInt = 21,
+    kOpTypeFloat = 22,
+    kOpTypeVector = 23,
+    kOpTypeMatrix = 24,
+    kOpTypeArray = 28,
+    kOpTypeStruct = 30,
+    kOpTypePointer = 32,
+    kOpTypeForwardPointer = 39,
+    kOpConstant = 43,
+    kOpFunction = 54,
+    kOpFunctionEnd = 56,
+    kOpVariable = 59,
+    kOpLoad = 61,
+    kOpStore = 62,
+    kOpVectorShuffle = 79,
+    kOpCompositeExtract = 81,
+    kOpCompositeInsert = 82,
+    kOpImageSampleImplicitLod = 87,
+    kOpImageFetch = 95,
+    kOpImageGather = 96,
+    kOpImageDrefGather = 97,
+    kOpImageRead = 98,
+    kOpConvertFToU = 109,
+    kOpQuantizeToF16 = 116,
+    kOpBitcast = 124,
+    kOpSNegate = 126,
+    kOpIAdd = 128,
+    kOpISub = 130,
+    kOpVectorTimesMatrix = 144,
+    kOpMatrixTimesVector = 145,
+    kOpMatrixTimesMatrix = 146,
+    kOpDot = 148,
+    kOpSMulExtended = 152,
+    kOpAny = 154,
+    kOpIEqual = 170,
+    kOpINotEqual = 171,
+    kOpUGreaterThan = 172,
+    kOpSGreaterThan = 173,
+    kOpUGreaterThanEqual = 174,
+    kOpSGreaterThanEqual = 175,
+    kOpULessThan = 176,
+    kOpSLessThan = 177,
+    kOpULessThanEqual = 178,
+    kOpSLessThanEqual = 179,
+    kOpFUnordGreaterThanEqual = 191,
+    kOpShiftRightLogical = 194,
+    kOpBitCount = 205,
+    kOpDPdx = 207,
+    kOpFwidthCoarse = 215,
+    kOpLoopMerge = 246,
+    kOpLabel = 248,
+    kOpBranchConditional = 250,
+    kOpSwitch = 251,
+    kOpImageSparseSampleImplicitLod = 305,
+    kOpImageSparseFetch = 313,
+    kOpImageSparseGather = 314,
+    kOpImageSparseDrefGather = 315,
+    kOpImageSparseRead = 320,
+};
+
+struct Instruction {
+    const unsigned int* words;
+    uint32_t opcode;
+    uint32_t word_count;
+};
+
+struct TypeInfo {
+    uint32_t components = 0;
+    // 32-bit registers; 0 for pointers and opaque types.
+    uint32_t registers = 0;
+    // Of a matrix, 1 otherwise.
+    uint32_t columns = 1;
+    bool is_float = false;
+};
+
+struct Loop {
+    // Positions of the header block and of the merge block.
+    size_t begin;
+    size_t end;
+    uint32_t merge;
+    bool is_static;
+    uint32_t trip_count;
+};
+
+bool Decode(const std::vector<unsigned int>& spirv, std::vector<Instruction>& instructions) {
+    if (spirv.size() < kHeaderWords || spirv[0] != kSpvMagic) {
+        return false;
+    }
+    for (size_t offset = kHeaderWords; offset < spirv.size();) {
+        const uint32_t word_count = spirv[offset] >> 16;
+        if (word_count == 0 || offset + word_count > spirv.size()) {
+            return false;
+        }
+        instructions.push_back({ spirv.data() + offset, spirv[offset] & 0xFFFF, word_count });
+        offset += word_count;
+    }
+    return true;
+}
+
+std::string DecodeString(const unsigned int* words, size_t count) {
+    std::string value;
+    for (size_t i = 0; i < count; ++i) {
+        for (int byte = 0; byte < 4; ++byte) {
+            const char c = static_cast<char>((words[i] >> (byte * 8)) & 0xFF);
+            if (c == '\0') {
+                return value;
+            }
+            value.push_back(c);
+        }
+    }
+    return value;
+}
+
+bool IsSample(uint32_t opcode) {
+    return (opcode >= kOpImageSampleImplicitLod && opcode < kOpImageFetch) ||
+        opcode == kOpImageGather || opcode == kOpImageDrefGather ||
+        (opcode >= kOpImageSparseSampleImplicitLod && opcode < kOpImageSparseFetch) ||
+        opcode == kOpImageSparseGather || opcode == kOpImageSparseDrefGather;
+}
+
+bool IsImageRead(uint32_t opcode) {
+    return opcode == kOpImageFetch || opcode == kOpImageRead || opcode == kOpImageSparseFetch ||
+        opcode == kOpImageSparseRead;
+}
+
+// Arithmetic, bit and derivative instructions; conversions and
+// comparisons are counted apart.
+bool IsArithmetic(uint32_t opcode) {
+    return (opcode >= kOpSNegate && opcode <= kOpSMulExtended) ||
+        (opcode >= kOpShiftRightLogical && opcode <= kOpBitCount) ||
+        (opcode >= kOpDPdx && opcode <= kOpFwidthCoarse);
+}
+
+// GLSL.std.450 Sin to InverseSqrt, and Length, Distance and Normalize for
+// their square root.
+bool IsTranscendental(uint32_t instruction) {
+    return (instruction >= 13 && instruction <= 32) || instruction == 66 || instruction == 67 ||
+        instruction == 69;
+}
+
+// The comparison with its operands swapped.
+uint32_t Mirror(uint32_t opcode) {
+    switch (opcode) {
+    case kOpUGreaterThan: return kOpULessThan;
+    case kOpSGreaterThan: return kOpSLessThan;
+    case kOpUGreaterThanEqual: return kOpULessThanEqual;
+    case kOpSGreaterThanEqual: return kOpSLessThanEqual;
+    case kOpULessThan: return kOpUGreaterThan;
+    case kOpSLessThan: return kOpSGreaterThan;
+    case kOpULessThanEqual: return kOpUGreaterThanEqual;
+    case kOpSLessThanEqual: return kOpSGreaterThanEqual;
+    default: return opcode;
+    }
+}
+
+// Iterations of "for (i = init; i <op> bound; i += step)", or -1.
+int64_t TripCount(uint32_t opcode, int64_t init, int64_t bound, int64_t step) {
+    const int64_t distance = bound - init;
+    switch (opcode) {
+    case kOpULessThan:
+    case kOpSLessThan:
+        return step > 0 ? std::max<int64_t>(0, (distance + step - 1) / step) : -1;
+    case kOpULessThanEqual:
+    case kOpSLessThanEqual:
+        return step > 0 ? std::max<int64_t>(0, distance / step + 1) : -1;
+    case kOpUGreaterThan:
+    case kOpSGreaterThan:
+        return step < 0 ? std::max<int64_t>(0, (-distance - step - 1) / -step) : -1;
+    case kOpUGreaterThanEqual:
+    case kOpSGreaterThanEqual:
+        return step < 0 ? std::max<int64_t>(0, -distance / -step + 1) : -1;
+    case kOpINotEqual:
+        return distance % step == 0 && distance / step >= 0 ? distance / step : -1;
+    default:
+        return -1;
+    }
+}
+
+void Add(uint32_t& total, uint64_t amount) {
+    total = static_cast<uint32_t>(std::min<uint64_t>(0xFFFFFFFF, total + amount));
+}
+
+class CostEstimator {
+public:
+    explicit CostEstimator(ReflectedStageCost& cost) : m_cost(cost) {}
+
+    // Module-level declarations, which come before every function.
+    void declare(const Instruction& instruction) {
+        const auto* words = instruction.words;
+        if (instruction.opcode >= kOpTypeVoid && instruction.opcode < kOpTypeForwardPointer) {
+            m_types[words[1]] = TypeInfo();
+        }
+        switch (instruction.opcode) {
+        case kOpExtInstImport:
+            if (DecodeString(words + 2, instruction.word_count - 2) == "GLSL.std.450") {
+                m_glsl_std = words[1];
+            }
+            break;
+        case kOpTypeBool:
+            m_types[words[1]] = { 1, 1, 1, false };
+            break;
+        case kOpTypeInt:
+        case kOpTypeFloat:
+            m_types[words[1]] = { 1, std::max(1u, words[2] / 32), 1, instruction.opcode == kOpTypeFloat };
+            break;
+        case kOpTypeVector:
+        case kOpTypeMatrix:
+        case kOpTypeArray: {
+            const auto element = type(words[2]);
+            uint32_t count = words[3];
+            if (instruction.opcode == kOpTypeArray) {
+                // A specialization constant length counts as 0.
+                const auto length = m_constants.find(words[3]);
+                count = length != m_constants.end() ? static_cast<uint32_t>(length->second) : 0;
+            }
+            m_types[words[1]] = { element.components * count, element.registers * count,
+                instruction.opcode == kOpTypeMatrix ? count : 1, element.is_float };
+            break;
+        }
+        case kOpTypeStruct: {
+            TypeInfo info;
+            for (uint32_t i = 2; i < instruction.word_count; ++i) {
+                info.components += type(words[i]).components;
+                info.registers += type(words[i]).registers;
+            }
+            m_types[words[1]] = info;
+            break;
+        }
+        case kOpTypePointer:
+            m_pointees[words[1]] = words[3];
+            break;
+        case kOpConstant:
+            m_value_types[words[2]] = words[1];
+            m_constants[words[2]] = static_cast<int32_t>(words[3]);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // One function, OpFunction to OpFunctionEnd.
+    void estimate(const std::vector<Instruction>& body) {
+        std::map<uint32_t, size_t> definitions;
+        for (size_t i = 0; i < body.size(); ++i) {
+            if (hasResult(body[i])) {
+                definitions[body[i].words[2]] = i;
+                m_value_types[body[i].words[2]] = body[i].words[1];
+            }
+        }
+        auto loops = findLoops(body);
+        for (auto& loop : loops) {
+            findTripCount(body, definitions, loop);
+            ++(loop.is_static ? m_cost.static_loops : m_cost.dynamic_loops);
+        }
+        count(body, loops);
+        m_cost.registers = std::max(m_cost.registers, registerPressure(body, loops));
+    }
+
+private:
+    TypeInfo type(uint32_t id) const {
+        const auto it = m_types.find(id);
+        return it != m_types.end() ? it->second : TypeInfo();
+    }
+
+    TypeInfo valueType(uint32_t id) const {
+        const auto it = m_value_types.find(id);
+        return it != m_value_types.end() ? type(it->second) : TypeInfo();
+    }
+
+    bool hasResult(const Instruction& instruction) const {
+        return instruction.word_count >= 3 && m_types.count(instruction.words[1]) > 0;
+    }
+
+    bool isConstant(uint32_t id) const { return m_constants.count(id) > 0; }
+
+    // Whether word is an operand naming a value, not a literal.
+    static bool isOperand(const Instruction& instruction, uint32_t word) {
+        switch (instruction.opcode) {
+        case kOpVariable:
+            return word != 3;
+        case kOpLoad:
+        case kOpCompositeExtract:
+            return word == 3;
+        case kOpStore:
+        case kOpSwitch:
+            return word < 3;
+        case kOpCompositeInsert:
+        case kOpVectorShuffle:
+            return word < 5;
+        case kOpExtInst:
+            return word > 4;
+        default:
+            return true;
+        }
+    }
+
+    std::vector<Loop> findLoops(const std::vector<Instruction>& body) const {
+        std::vector<Loop> loops;
+        std::vector<size_t> open;
+        size_t block = 0;
+        for (size_t i = 0; i < body.size(); ++i) {
+            if (body[i].opcode == kOpLabel) {
+                block = i;
+                while (!open.empty() && loops[open.back()].merge == body[i].words[1]) {
+                    loops[open.back()].end = i;
+                    open.pop_back();
+                }
+            }
+            else if (body[i].opcode == kOpLoopMerge) {
+                open.push_back(loops.size());
+                loops.push_back({ block, body.size(), body[i].words[1], false, 0 });
+            }
+        }
+        return loops;
+    }
+
+    void findTripCount(const std::vector<Instruction>& body, const std::map<uint32_t, size_t>& definitions,
+        Loop& loop) const {
+        auto definition = [&](uint32_t id) -> const Instruction* {
+            const auto it = definitions.find(id);
+            return it != definitions.end() ? &body[it->second] : nullptr;
+        };
+
+        // The exit test is the first conditional branch, leaving when false.
+        size_t test = loop.begin;
+        while (test < loop.end && body[test].opcode != kOpBranchConditional) {
+            ++test;
+        }
+        if (test == loop.end || body[test].words[3] != loop.merge) {
+            return;
+        }
+        const auto compare = definition(body[test].words[1]);
+        if (compare == nullptr || compare->opcode < kOpIEqual || compare->opcode > kOpSLessThanEqual) {
+            return;
+        }
+        uint32_t opcode = compare->opcode;
+        uint32_t counter = compare->words[3];
+        uint32_t bound = compare->words[4];
+        if (isConstant(counter)) {
+            std::swap(counter, bound);
+            opcode = Mirror(opcode);
+        }
+        const auto load = definition(counter);
+        if (!isConstant(bound) || load == nullptr || load->opcode != kOpLoad) {
+            return;
+        }
+        const uint32_t variable = load->words[3];
+
+        int64_t init = 0;
+        bool has_init = false;
+        for (size_t i = loop.begin; i-- > 0;) {
+            if (body[i].opcode == kOpStore && body[i].words[1] == variable) {
+                has_init = isConstant(body[i].words[2]);
+                init = has_init ? m_constants.at(body[i].words[2]) : 0;
+                break;
+            }
+        }
+
+        // The one store in the loop must be the variable plus a constant.
+        int64_t step = 0;
+        uint32_t stores = 0;
+        for (size_t i = loop.begin; i < loop.end; ++i) {
+            if (body[i].opcode != kOpStore || body[i].words[1] != variable) {
+                continue;
+            }
+            ++stores;
+            const auto next = definition(body[i].words[2]);
+            if (next == nullptr || (next->opcode != kOpIAdd && next->opcode != kOpISub)) {
+                continue;
+            }
+            uint32_t previous = next->words[3];
+            uint32_t constant = next->words[4];
+            if (next->opcode == kOpIAdd && isConstant(previous)) {
+                std::swap(previous, constant);
+            }
+            const auto previous_load = definition(previous);
+            if (isConstant(constant) && previous_load != nullptr && previous_load->opcode == kOpLoad &&
+                previous_load->words[3] == variable) {
+                step = next->opcode == kOpIAdd ? m_constants.at(constant) : -m_constants.at(constant);
+            }
+        }
+        if (!has_init || stores != 1 || step == 0) {
+            return;
+        }
+        const int64_t trip_count = TripCount(opcode, init, m_constants.at(bound), step);
+        if (trip_count >= 0 && trip_count <= 0xFFFFFFFF) {
+            loop.is_static = true;
+            loop.trip_count = static_cast<uint32_t>(trip_count);
+        }
+    }
+
+    void count(const std::vector<Instruction>& body, const std::vector<Loop>& loops) {
+        // Loops are sorted by header, an inner one ending before its outer one.
+        std::vector<const Loop*> open;
+        size_t next = 0;
+        uint64_t multiplier = 1;
+        for (size_t i = 0; i < body.size(); ++i) {
+            bool changed = false;
+            while (!open.empty() && open.back()->end == i) {
+                open.pop_back();
+                changed = true;
+            }
+            for (; next < loops.size() && loops[next].begin == i; ++next) {
+                open.push_back(&loops[next]);
+                changed = true;
+            }
+            if (changed) {
+                multiplier = 1;
+                for (const auto p_loop : open) {
+                    multiplier = std::min<uint64_t>(0xFFFFFFFF, multiplier * (p_loop->is_static ? p_loop->trip_count : 1));
+                }
+            }
+            countInstruction(body[i], multiplier);
+        }
+    }
+
+    void countInstruction(const Instruction& instruction, uint64_t multiplier) {
+        const auto* words = instruction.words;
+        const uint32_t opcode = instruction.opcode;
+        if (IsSample(opcode)) {
+            Add(m_cost.texture_samples, multiplier);
+            return;
+        }
+        if (IsImageRead(opcode)) {
+            Add(m_cost.image_reads, multiplier);
+            return;
+        }
+        if (opcode == kOpBranchConditional || opcode == kOpSwitch) {
+            Add(m_cost.branches, multiplier);
+            return;
+        }
+        if (!hasResult(instruction)) {
+            return;
+        }
+        const auto result = type(words[1]);
+        if ((opcode >= kOpConvertFToU && opcode <= kOpQuantizeToF16) || opcode == kOpBitcast) {
+            Add(m_cost.conversion_ops, multiplier * result.components);
+        }
+        else if (opcode >= kOpAny && opcode <= kOpFUnordGreaterThanEqual) {
+            Add(m_cost.compare_ops, multiplier * result.components);
+        }
+        else if (IsArithmetic(opcode) || (opcode == kOpExtInst && words[3] == m_glsl_std)) {
+            // A product of vectors or matrices takes one op per term.
+            uint64_t ops = result.components;
+            if (opcode == kOpDot) {
+                ops = valueType(words[3]).components;
+            }
+            else if (opcode == kOpVectorTimesMatrix) {
+                ops *= valueType(words[3]).components;
+            }
+            else if (opcode == kOpMatrixTimesVector || opcode == kOpMatrixTimesMatrix) {
+                ops *= valueType(words[3]).columns;
+            }
+            if (opcode == kOpExtInst && IsTranscendental(words[4])) {
+                Add(m_cost.transcendental_ops, multiplier * ops);
+            }
+            else {
+                Add(result.is_float ? m_cost.float_ops : m_cost.integer_ops, multiplier * ops);
+            }
+        }
+    }
+
+    uint32_t registerPressure(const std::vector<Instruction>& body, const std::vector<Loop>& loops) const {
+        struct Range {
+            size_t begin;
+            size_t end;
+            uint32_t registers;
+        };
+        // A value is live from its definition, a variable from its first
+        // use, to the last use.
+        std::map<uint32_t, Range> ranges;
+        for (size_t i = 0; i < body.size(); ++i) {
+            const auto& instruction = body[i];
+            uint32_t first_operand = 1;
+            if (hasResult(instruction)) {
+                first_operand = 3;
+                const uint32_t id = instruction.words[2];
+                if (instruction.opcode == kOpVariable) {
+                    if (instruction.words[3] == kStorageClassFunction) {
+                        const auto pointee = m_pointees.find(instruction.words[1]);
+                        const uint32_t registers = pointee != m_pointees.end() ? type(pointee->second).registers : 0;
+                        ranges[id] = { kNoPosition, 0, registers };
+                    }
+                }
+                else if (type(instruction.words[1]).registers > 0) {
+                    ranges[id] = { i, i, type(instruction.words[1]).registers };
+                }
+            }
+            for (uint32_t word = first_operand; word < instruction.word_count; ++word) {
+                if (!isOperand(instruction, word)) {
+                    continue;
+                }
+                const auto it = ranges.find(instruction.words[word]);
+                if (it != ranges.end()) {
+                    it->second.begin = std::min(it->second.begin, i);
+                    it->second.end = i;
+                }
+            }
+        }
+
+        // Live into a loop means live through all of it, inner loops first.
+        std::vector<const Loop*> by_end;
+        for (const auto& loop : loops) {
+            by_end.push_back(&loop);
+        }
+        std::sort(by_end.begin(), by_end.end(), [](const Loop* a, const Loop* b) { return a->end < b->end; });
+        for (const auto p_loop : by_end) {
+            for (auto& range : ranges) {
+                auto& live = range.second;
+                if (live.begin < p_loop->begin && live.end >= p_loop->begin && live.end < p_loop->end) {
+                    live.end = p_loop->end;
+                }
+            }
+        }
+
+        // Ends sort ahead of definitions at the same position.
+        std::vector<std::pair<size_t, int64_t>> events;
+        for (const auto& range : ranges) {
+            if (range.second.begin != kNoPosition) {
+                events.emplace_back(range.second.begin, range.second.registers);
+                events.emplace_back(range.second.end + 1, -static_cast<int64_t>(range.second.registers));
+            }
+        }
+        std::sort(events.begin(), events.end());
+        int64_t live = 0;
+        int64_t peak = 0;
+        for (const auto& event : events) {
+            live += event.second;
+            peak = std::max(peak, live);
+        }
+        return static_cast<uint32_t>(peak);
+    }
+
+    ReflectedStageCost& m_cost;
+    std::map<uint32_t, TypeInfo> m_types;
+    std::map<uint32_t, uint32_t> m_pointees;
+    std::map<uint32_t, int64_t> m_constants;
+    // The type of every value with a result, constants included.
+    std::map<uint32_t, uint32_t> m_value_types;
+    uint32_t m_glsl_std = 0;
+};
+}
+
+ReflectedStageCost EstimateStageCost(const std::vector<unsigned int>& spirv, uint32_t stage) {
+    ReflectedStageCost cost;
+    cost.stage = stage;
+    std::vector<Instruction> instructions;
+    if (!Decode(spirv, instructions)) {
+        return cost;
+    }
+    CostEstimator estimator(cost);
+    size_t i = 0;
+    for (; i < instructions.size() && instructions[i].opcode != kOpFunction; ++i) {
+        estimator.declare(instructions[i]);
+    }
+    while (i < instructions.size()) {
+        std::vector<Instruction> body;
+        for (; i < instructions.size(); ++i) {
+            body.push_back(instructions[i]);
+            if (instructions[i].opcode == kOpFunctionEnd) {
+                ++i;
+                break;
+            }
+        }
+        estimator.estimate(body);
+    }
+    return cost;
+}
+
+bool IsCostMetric(const std::string& metric) {
+    return metric == "alu" || metric == "transcendental" || metric == "texture_samples" ||
+        metric == "image_reads" || metric == "branches" || metric == "dynamic_loops" || metric == "registers";
+}
+
+uint32_t GetCostMetric(const ReflectedStageCost& cost, const std::string& metric) {
+    if (metric == "alu") {
+        return cost.getAluOps();
+    }
+    if (metric == "transcendental") {
+        return cost.transcendental_ops;
+    }
+    if (metric == "texture_samples") {
+        return cost.texture_samples;
+    }
+    if (metric == "image_reads") {
+        return cost.image_reads;
+    }
+    if (metric == "branches") {
+        return cost.branches;
+    }
+    if (metric == "dynamic_loops") {
+        return cost.dynamic_loops;
+    }
+    return cost.registers;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "reflection.h"
+
+// Estimates what one stage costs per invocation from the SPIR-V glslang
+// emits, before any post-processing. Loops are the blocks between an
+// OpLoopMerge and its merge block; a loop has a static trip count when it
+// compares a Function variable set to a constant before the loop, and
+// stepped by a constant in it, against a constant. Register pressure is
+// the peak of values and Function variables live at once, a value used in
+// a loop staying live to its end. Calls are not followed: every function
+// is counted once, and registers are those of the heaviest function.
+// An all-zero cost (but stage) is returned for a malformed module.
+ReflectedStageCost EstimateStageCost(const std::vector<unsigned int>& spirv, uint32_t stage);
+
+// The metrics a "cost_budget" may limit: "alu", "transcendental",
+// "texture_samples", "image_reads", "branches", "dynamic_loops" and
+// "registers".
+bool IsCostMetric(const std::string& metric);
+uint32_t GetCostMetric(const ReflectedStageCost& cost, const std::string& metric);
@@ -0,0 +1,398 @@
+#include <map>
+#include <algorithm>
+#include <iomanip>
+#include <spirv-tools/optimizer.hpp>
+#include "spirv_postprocess.h"
+
+namespace {
+const uint32_t kSpvMagic = 0x07230203;
+const size_t kHeaderWords = 5;
+const uint32_t kStorageClassWorkgroup = 4;
+
+enum SpvOpcode : uint32_t {
+    kOpUndef = 1,
+    kOpSourceContinued = 2,
+    kOpSource = 3,
+    kOpSourceExtension = 4,
+    kOpName = 5,
+    kOpMemberName = 6,
+    kOpString = 7,
+    kOpLine = 8,
+    kOpTypeVoid = 19,
+    kOpTypeBool = 20,
+    kOpTypeInt = 21,
+    kOpTypeFloat = 22,
+    kOpTypeVector = 23,
+    kOpTypeMatrix = 24,
+    kOpTypeArray = 28,
+    kOpTypeStruct = 30,
+    kOpTypePointer = 32,
+    kOpTypeForwardPointer = 39,
+    kOpConstantTrue = 41,
+    kOpConstant = 43,
+    kOpConstantNull = 46,
+    kOpSpecConstant = 50,
+    kOpFunction = 54,
+    kOpVariable = 59,
+    kOpDecorate = 71,
+    kOpMemberDecorate = 72,
+    kOpNoLine = 317,
+    kOpModuleProcessed = 330,
+    kOpDecorateId = 332,
+    kOpDecorateString = 5632,
+    kOpMemberDecorateString = 5633,
+};
+
+struct Instruction {
+    size_t offset;
+    uint32_t opcode;
+    uint32_t word_count;
+};
+
+bool Decode(const std::vector<unsigned int>& spirv, std::vector<Instruction>& instructions) {
+    if (spirv.size() < kHeaderWords || spirv[0] != kSpvMagic) {
+        return false;
+    }
+    for (size_t offset = kHeaderWords; offset < spirv.size();) {
+        Instruction instruction = { offset, spirv[offset] & 0xFFFF, spirv[offset] >> 16 };
+        if (instruction.word_count == 0 || offset + instruction.word_count > spirv.size()) {
+            return false;
+        }
+        instructions.push_back(instruction);
+        offset += instruction.word_count;
+    }
+    return true;
+}
+
+std::string DecodeString(const std::vector<unsigned int>& spirv, size_t offset, size_t end) {
+    std::string value;
+    for (; offset < end; ++offset) {
+        for (int byte = 0; byte < 4; ++byte) {
+            char c = static_cast<char>((spirv[offset] >> (byte * 8)) & 0xFF);
+            if (c == '\0') {
+                return value;
+            }
+            value.push_back(c);
+        }
+    }
+    return value;
+}
+
+bool IsDebug(uint32_t opcode) {
+    return (opcode >= kOpSourceContinued && opcode <= kOpLine) ||
+        opcode == kOpNoLine || opcode == kOpModuleProcessed;
+}
+
+// Instructions whose first operand only names the target they annotate.
+bool IsTargetAnnotation(uint32_t opcode) {
+    return opcode == kOpName || opcode == kOpMemberName || opcode == kOpDecorate ||
+        opcode == kOpMemberDecorate || opcode == kOpDecorateId || opcode == kOpDecorateString ||
+        opcode == kOpMemberDecorateString;
+}
+
+// Global declarations that can go when nothing references their result.
+// Specialization constants stay, the application may still set them.
+bool IsType(uint32_t opcode) {
+    return opcode >= kOpTypeVoid && opcode < kOpTypeForwardPointer;
+}
+
+bool IsRemovableDeclaration(uint32_t opcode) {
+    return IsType(opcode) || (opcode >= kOpConstantTrue && opcode <= kOpConstantNull) ||
+        opcode == kOpVariable || opcode == kOpUndef;
+}
+
+// Types have no result type, so their result ID comes first.
+size_t ResultIdWord(uint32_t opcode) {
+    return IsType(opcode) ? 1 : 2;
+}
+
+void Rebuild(std::vector<unsigned int>& spirv, const std::vector<Instruction>& instructions, const std::vector<bool>& removed) {
+    std::vector<unsigned int> result(spirv.begin(), spirv.begin() + kHeaderWords);
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        if (!removed[i]) {
+            result.insert(result.end(), spirv.begin() + instructions[i].offset,
+                spirv.begin() + instructions[i].offset + instructions[i].word_count);
+        }
+    }
+    spirv.swap(result);
+}
+
+size_t StripDebug(std::vector<unsigned int>& spirv, const std::vector<Instruction>& instructions, const std::set<std::string>& kept_names) {
+    std::map<uint32_t, bool> kept_types;
+    std::vector<bool> removed(instructions.size(), false);
+    size_t removed_count = 0;
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        const auto& instruction = instructions[i];
+        if (!IsDebug(instruction.opcode)) {
+            continue;
+        }
+        const size_t end = instruction.offset + instruction.word_count;
+        if (instruction.opcode == kOpName) {
+            const auto target = spirv[instruction.offset + 1];
+            if (kept_names.count(DecodeString(spirv, instruction.offset + 2, end)) > 0) {
+                kept_types[target] = true;
+                continue;
+            }
+        }
+        // OpName precedes OpMemberName, so the struct's fate is known here.
+        if (instruction.opcode == kOpMemberName && kept_types.count(spirv[instruction.offset + 1]) > 0 &&
+            kept_names.count(DecodeString(spirv, instruction.offset + 3, end)) > 0) {
+            continue;
+        }
+        removed[i] = true;
+        ++removed_count;
+    }
+    Rebuild(spirv, instructions, removed);
+    return removed_count;
+}
+
+// Any word outside the declaration itself that equals its ID counts as a
+// use. Literals may alias IDs, which only ever keeps a dead declaration.
+size_t RemoveDeadDeclarations(std::vector<unsigned int>& spirv) {
+    size_t removed_count = 0;
+    while (true) {
+        std::vector<Instruction> instructions;
+        Decode(spirv, instructions);
+        const uint32_t bound = spirv[3];
+
+        std::vector<uint32_t> uses(bound, 0);
+        for (const auto& instruction : instructions) {
+            size_t first = 1;
+            if (IsTargetAnnotation(instruction.opcode)) {
+                // Only OpDecorateId has operands that are real uses.
+                first = instruction.opcode == kOpDecorateId ? 2 : instruction.word_count;
+            }
+            const bool is_declaration = IsRemovableDeclaration(instruction.opcode);
+            for (size_t w = first; w < instruction.word_count; ++w) {
+                const auto word = spirv[instruction.offset + w];
+                if (word < bound && !(is_declaration && w == ResultIdWord(instruction.opcode))) {
+                    ++uses[word];
+                }
+            }
+        }
+
+        std::vector<bool> dead_ids(bound, false);
+        std::vector<bool> removed(instructions.size(), false);
+        bool in_function = false;
+        size_t removed_now = 0;
+        for (size_t i = 0; i < instructions.size(); ++i) {
+            const auto& instruction = instructions[i];
+            if (instruction.opcode == kOpFunction) {
+                in_function = true;
+            }
+            if (in_function || !IsRemovableDeclaration(instruction.opcode)) {
+                continue;
+            }
+            const size_t result_word = ResultIdWord(instruction.opcode);
+            if (instruction.word_count <= result_word) {
+                continue;
+            }
+            const auto id = spirv[instruction.offset + result_word];
+            if (id < bound && uses[id] == 0) {
+                dead_ids[id] = true;
+                removed[i] = true;
+                ++removed_now;
+            }
+        }
+        if (removed_now == 0) {
+            break;
+        }
+        for (size_t i = 0; i < instructions.size(); ++i) {
+            const auto& instruction = instructions[i];
+            if (IsTargetAnnotation(instruction.opcode) && instruction.word_count > 1 &&
+                spirv[instruction.offset + 1] < bound && dead_ids[spirv[instruction.offset + 1]]) {
+                removed[i] = true;
+            }
+        }
+        Rebuild(spirv, instructions, removed);
+        removed_count += removed_now;
+    }
+    return removed_count;
+}
+
+struct TypeLayout {
+    uint32_t size = 0;
+    uint32_t alignment = 1;
+};
+
+uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// std430 sizes of the types a workgroup variable can have. Types are
+// declared before use, so one pass in order sees every operand first.
+class WorkgroupLayout {
+public:
+    void add(const std::vector<unsigned int>& spirv, const Instruction& instruction) {
+        const unsigned int* words = spirv.data() + instruction.offset;
+        switch (instruction.opcode) {
+        case kOpTypeBool:
+            m_types[words[1]] = { 4, 4 };
+            break;
+        case kOpTypeInt:
+        case kOpTypeFloat:
+            m_types[words[1]] = { words[2] / 8, words[2] / 8 };
+            break;
+        case kOpTypeVector: {
+            const auto component = m_types[words[2]];
+            const uint32_t count = words[3];
+            m_types[words[1]] = { component.size * count, component.alignment * (count == 3 ? 4 : count) };
+            break;
+        }
+        case kOpTypeMatrix:
+            m_types[words[1]] = array(m_types[words[2]], words[3]);
+            break;
+        case kOpTypeArray:
+            m_types[words[1]] = array(m_types[words[2]], m_constants[words[3]]);
+            break;
+        case kOpTypeStruct: {
+            TypeLayout layout;
+            for (uint32_t i = 2; i < instruction.word_count; ++i) {
+                const auto& member = m_types[words[i]];
+                layout.size = AlignUp(layout.size, member.alignment) + member.size;
+                layout.alignment = std::max(layout.alignment, member.alignment);
+            }
+            layout.size = AlignUp(layout.size, layout.alignment);
+            m_types[words[1]] = layout;
+            break;
+        }
+        case kOpTypePointer:
+            m_pointees[words[1]] = words[3];
+            break;
+        case kOpConstant:
+        case kOpSpecConstant:
+            // Array lengths; wider constants keep their low word.
+            m_constants[words[2]] = words[3];
+            break;
+        case kOpVariable:
+            if (words[3] == kStorageClassWorkgroup) {
+                const auto& layout = m_types[m_pointees[words[1]]];
+                m_size = AlignUp(m_size, layout.alignment) + layout.size;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    uint32_t getSize() const { return m_size; }
+
+private:
+    static TypeLayout array(const TypeLayout& element, uint32_t length) {
+        return { AlignUp(element.size, element.alignment) * length, element.alignment };
+    }
+
+    std::map<uint32_t, TypeLayout> m_types;
+    std::map<uint32_t, uint32_t> m_pointees;
+    std::map<uint32_t, uint32_t> m_constants;
+    uint32_t m_size = 0;
+};
+
+template<typename T, typename Add>
+void AddNames(const std::vector<T>& entries, Add& add) {
+    for (const auto& entry : entries) {
+        add(entry.name);
+    }
+}
+}
+
+void SpirvStatistics::add(const SpirvPostProcessStats& stats) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_totals.bytes_before += stats.bytes_before;
+    m_totals.bytes_after += stats.bytes_after;
+    m_totals.debug_instructions_removed += stats.debug_instructions_removed;
+    m_totals.declarations_removed += stats.declarations_removed;
+    ++m_modules;
+}
+
+void SpirvStatistics::write(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const double saved = m_totals.bytes_before > 0 ?
+        100.0 * (m_totals.bytes_before - m_totals.bytes_after) / m_totals.bytes_before : 0.0;
+    out << "spirv: " << m_modules << " modules, "
+        << m_totals.bytes_before << " -> " << m_totals.bytes_after << " bytes (-"
+        << std::fixed << std::setprecision(1) << saved << "%), "
+        << m_totals.debug_instructions_removed << " debug instructions and "
+        << m_totals.declarations_removed << " unused declarations removed." << std::endl;
+    out.unsetf(std::ios::floatfield);
+}
+
+std::set<std::string> ReflectedNames(const ProgramReflection& reflection) {
+    std::set<std::string> names;
+    auto add = [&names](const std::string& name) {
+        size_t begin = 0;
+        while (begin < name.size()) {
+            size_t end = name.find_first_of(".[", begin);
+            if (end == std::string::npos) {
+                end = name.size();
+            }
+            if (end > begin) {
+                names.insert(name.substr(begin, end - begin));
+            }
+            // Skip a subscript up to the next member.
+            begin = name[end] == '[' ? name.find('.', end) : end;
+            begin = begin == std::string::npos ? name.size() : begin + 1;
+        }
+    };
+    AddNames(reflection.attributes, add);
+    AddNames(reflection.uniform_blocks, add);
+    for (const auto& block : reflection.uniform_blocks) {
+        AddNames(block.members, add);
+    }
+    AddNames(reflection.uniform_variables, add);
+    AddNames(reflection.push_constants, add);
+    AddNames(reflection.storage_blocks, add);
+    AddNames(reflection.bindings, add);
+    return names;
+}
+
+bool PostProcessSpirv(std::vector<unsigned int>& spirv, const std::set<std::string>& kept_names,
+    SpirvPostProcessStats& stats, std::ostream& log) {
+    stats.bytes_before += spirv.size() * sizeof(unsigned int);
+
+    std::vector<Instruction> instructions;
+    if (!Decode(spirv, instructions)) {
+        log << "SPIR-V post-processing skipped, the module is malformed." << std::endl;
+        stats.bytes_after += spirv.size() * sizeof(unsigned int);
+        return false;
+    }
+
+    std::vector<unsigned int> result = spirv;
+    size_t debug_removed = StripDebug(result, instructions, kept_names);
+    size_t declarations_removed = RemoveDeadDeclarations(result);
+
+    // Renumbering has to know which operands are IDs, which takes the
+    // SPIR-V grammar; SPIRV-Tools already ships with glslang.
+    spvtools::Optimizer optimizer(SPV_ENV_VULKAN_1_0);
+    optimizer.SetMessageConsumer([&](spv_message_level_t, const char*, const spv_position_t&, const char* message) {
+        log << message << std::endl;
+    });
+    optimizer.RegisterPass(spvtools::CreateCompactIdsPass());
+    std::vector<uint32_t> compacted;
+    if (!optimizer.Run(result.data(), result.size(), &compacted)) {
+        log << "SPIR-V post-processing failed, the module is written unchanged." << std::endl;
+        stats.bytes_after += spirv.size() * sizeof(unsigned int);
+        return false;
+    }
+
+    spirv.assign(compacted.begin(), compacted.end());
+    stats.bytes_after += spirv.size() * sizeof(unsigned int);
+    stats.debug_instructions_removed += debug_removed;
+    stats.declarations_removed += declarations_removed;
+    return true;
+}
+
+uint32_t WorkgroupMemorySize(const std::vector<unsigned int>& spirv) {
+    std::vector<Instruction> instructions;
+    if (!Decode(spirv, instructions)) {
+        return 0;
+    }
+    WorkgroupLayout layout;
+    for (const auto& instruction : instructions) {
+        if (instruction.opcode == kOpFunction) {
+            break;
+        }
+        layout.add(spirv, instruction);
+    }
+    return layout.getSize();
+}
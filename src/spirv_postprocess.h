@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include <set>
+#include <string>
+#include <ostream>
+#include <cstddef>
+#include <mutex>
+#include "reflection.h"
+
+struct SpirvPostProcessStats {
+    size_t bytes_before = 0;
+    size_t bytes_after = 0;
+    size_t debug_instructions_removed = 0;
+    size_t declarations_removed = 0;
+};
+
+// Totals over every module post-processed in a run, shared by all threads.
+class SpirvStatistics {
+public:
+    void add(const SpirvPostProcessStats& stats);
+    void write(std::ostream& out) const;
+
+private:
+    mutable std::mutex m_mutex;
+    SpirvPostProcessStats m_totals;
+    size_t m_modules = 0;
+};
+
+// The identifiers a reflection ShaderDescriptor refers to: attribute,
+// block, member and variable names, without array subscripts.
+std::set<std::string> ReflectedNames(const ProgramReflection& reflection);
+
+// Shrinks a module before it is written: strips debug instructions
+// (OpSource*, OpString, OpLine, OpModuleProcessed and every OpName or
+// OpMemberName not in kept_names), removes types, constants and global
+// variables nothing references, and renumbers the IDs compactly.
+// The module is left untouched and false returned if anything fails.
+bool PostProcessSpirv(std::vector<unsigned int>& spirv, const std::set<std::string>& kept_names,
+    SpirvPostProcessStats& stats, std::ostream& log);
+
+// Bytes of workgroup ("shared") memory the module declares, every variable
+// laid out as std430 would in declaration order; 0 for a malformed module.
+uint32_t WorkgroupMemorySize(const std::vector<unsigned int>& spirv);
@@ -1,7 +1,5 @@
 #include <iostream>
-#include <fstream>
 #include <exception>
-#include <streambuf>
 #include <new>
 #include <cstring>
 #include <cassert>
@@ -9,6 +7,8 @@
 #include <vector>
 #include "spv_program.h"
 #include "config.h"
+#include "tracer.h"
+#include "include_cache.h"
 
 EShLanguage VKStageFlagToEShStage(VkShaderStageFlagBits stage) {
     switch (stage)
@@ -19,6 +19,9 @@ EShLanguage VKStageFlagToEShStage(VkShaderStageFlagBits stage) {
     case VK_SHADER_STAGE_FRAGMENT_BIT:
         return EShLangFragment;
         break;
+    case VK_SHADER_STAGE_COMPUTE_BIT:
+        return EShLangCompute;
+        break;
     default:
         assert(false);
         break;
@@ -26,65 +29,108 @@ EShLanguage VKStageFlagToEShStage(VkShaderStageFlagBits stage) {
     return EShLangCount;
 }
 
+const char* StageName(VkShaderStageFlagBits stage) {
+    switch (stage)
+    {
+    case VK_SHADER_STAGE_VERTEX_BIT:
+        return "vertex";
+    case VK_SHADER_STAGE_FRAGMENT_BIT:
+        return "fragment";
+    case VK_SHADER_STAGE_COMPUTE_BIT:
+        return "compute";
+    default:
+        assert(false);
+        break;
+    }
+    return "unknown";
+}
+
 void CreateShader(EShLanguage stage, glslang::TShader*& p_shader) {
     p_shader = new(std::nothrow) glslang::TShader(stage);
 }
 
-std::vector<std::string> LoadShaderSoruces(std::vector<std::string> file_paths) {
-    std::vector<std::string> ret;
-    for (auto path : file_paths) {
-        std::ifstream file(path);
-        if (!file.is_open()) {
-            break;
+bool LoadShaderSources(const std::vector<std::string>& file_paths, std::vector<ShaderSource>& sources,
+    IncludeCache* p_cache, std::ostream& log) {
+    IncludeCache own_cache;
+    auto& cache = p_cache != nullptr ? *p_cache : own_cache;
+    bool loaded = true;
+    for (const auto& path : file_paths) {
+        ShaderSource source;
+        source.p_file = cache.get(AbsolutePath(path));
+        if (source.p_file == nullptr) {
+            log << path << " can not be loaded!" << std::endl;
+            loaded = false;
+            continue;
         }
-
-        std::string shader_content(
-            (std::istreambuf_iterator<char>(file)),
-            std::istreambuf_iterator<char>()
-        );
-        ret.push_back(shader_content);
-        file.close();
+        source.data = source.p_file->data();
+        source.size = source.p_file->size();
+        sources.push_back(source);
     }
-    return ret;
+    return loaded;
 }
 
-bool ParseShader(glslang::TShader* p_shader, const EShMessages e_messages) {
-    if (!p_shader->parse(&DefaultTBuiltInResource, 100, false, e_messages)) {
-        std::cout << p_shader->getInfoLog() << std::endl;
-        std::cout << p_shader->getInfoDebugLog() << std::endl;
+bool ParseShader(glslang::TShader* p_shader, const EShMessages e_messages, glslang::TShader::Includer& includer,
+    std::ostream& log) {
+    if (!p_shader->parse(&DefaultTBuiltInResource, kDefaultShaderVersion, false, e_messages, includer)) {
+        log << p_shader->getInfoLog() << std::endl;
+        log << p_shader->getInfoDebugLog() << std::endl;
         return false;
     }
     return true;
 }
 
-bool InitializeProgram(glslang::TProgram& program, const EShMessages e_messages) {
-    if (!program.link(e_messages)) {
-        std::cout << program.getInfoLog() << std::endl;
-        std::cout << program.getInfoDebugLog() << std::endl;
-        return false;
+bool InitializeProgram(glslang::TProgram& program, const EShMessages e_messages, std::ostream& log,
+    Tracer* p_tracer, const std::string& program_name) {
+    bool succeeded = false;
+    {
+        TraceSpan span(p_tracer, "link", program_name);
+        succeeded = program.link(e_messages);
     }
-    if (!program.mapIO()) {
-        std::cout << program.getInfoLog() << std::endl;
-        std::cout << program.getInfoDebugLog() << std::endl;
-        return false;
+    if (succeeded) {
+        TraceSpan span(p_tracer, "mapIO", program_name);
+        succeeded = program.mapIO();
     }
-    if (!program.buildReflection()) {
-        std::cout << program.getInfoLog() << std::endl;
-        std::cout << program.getInfoDebugLog() << std::endl;
+    if (succeeded) {
+        TraceSpan span(p_tracer, "buildReflection", program_name);
+        succeeded = program.buildReflection();
+    }
+    if (!succeeded) {
+        log << program.getInfoLog() << std::endl;
+        log << program.getInfoDebugLog() << std::endl;
         return false;
     }
     return true;
 }
 
-void ConfigureShader(glslang::TShader* const p_shader, EShLanguage stage, Config& k_config) {
+namespace {
+void SetShaderEnvironment(glslang::TShader* const p_shader, EShLanguage stage, Config& k_config) {
     p_shader->setEnvInput(
         k_config.getSource(),
         stage,
         glslang::EShClientVulkan,
-        450
+        kInputSemanticsVersion
     );
-    p_shader->setEnvClient(glslang::EShClientVulkan, 100);
-    p_shader->setEnvTarget(glslang::EshTargetSpv, 0x00001000);
-    bool result = ParseShader(p_shader, k_config.getMessages());
-    assert(result);
+    p_shader->setEnvClient(glslang::EShClientVulkan, kVulkanClientVersion);
+    p_shader->setEnvTarget(glslang::EshTargetSpv, kSpvTargetVersion);
+}
+}
+
+bool ConfigureShader(glslang::TShader* const p_shader, EShLanguage stage, Config& k_config, std::ostream& log,
+    glslang::TShader::Includer* p_includer) {
+    SetShaderEnvironment(p_shader, stage, k_config);
+    glslang::TShader::ForbidIncluder forbid_includer;
+    return ParseShader(p_shader, k_config.getMessages(), p_includer != nullptr ? *p_includer : forbid_includer, log);
+}
+
+bool PreprocessShader(glslang::TShader* const p_shader, EShLanguage stage, Config& k_config, std::string& output, std::ostream& log,
+    glslang::TShader::Includer* p_includer) {
+    SetShaderEnvironment(p_shader, stage, k_config);
+    glslang::TShader::ForbidIncluder forbid_includer;
+    if (!p_shader->preprocess(&DefaultTBuiltInResource, kDefaultShaderVersion, ENoProfile, false, false,
+        k_config.getMessages(), &output, p_includer != nullptr ? *p_includer : forbid_includer)) {
+        log << p_shader->getInfoLog() << std::endl;
+        log << p_shader->getInfoDebugLog() << std::endl;
+        return false;
+    }
+    return true;
 }
\ No newline at end of file
@@ -1,18 +1,60 @@
 #pragma once
+#include <ostream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
 #include <ShaderLang.h>
 #include <GlslangToSpv.h>
 #include <vulkan/vulkan.h>
 
 class Config;
+class Tracer;
+class MappedFile;
+class IncludeCache;
+
+// The environment ConfigureShader hands to glslang. Anything that changes
+// here changes the SPIR-V, so the compile cache keys on it as well.
+const int kDefaultShaderVersion = 100;
+const int kInputSemanticsVersion = 450;
+const int kVulkanClientVersion = 100;
+const int kSpvTargetVersion = 0x00001000;
 
 EShLanguage VKStageFlagToEShStage(VkShaderStageFlagBits stage);
 
+// The name of the stage in a config's "sources".
+const char* StageName(VkShaderStageFlagBits stage);
+
 void CreateShader(EShLanguage stage, glslang::TShader*& p_shader);
 
-std::vector<std::string> LoadShaderSoruces(std::vector<std::string> file_paths);
+// One string of a stage's source: a mapped file, or text the config owns.
+// Not null-terminated; hand it to glslang with setStringsWithLengths().
+struct ShaderSource {
+    const char* data = "";
+    size_t size = 0;
+    std::shared_ptr<const MappedFile> p_file;
+};
+
+// Maps every file of file_paths read-only through p_cache, or on its own
+// when p_cache is null. Every file that can not be read is reported to
+// log, and false returned.
+bool LoadShaderSources(const std::vector<std::string>& file_paths, std::vector<ShaderSource>& sources,
+    IncludeCache* p_cache, std::ostream& log = std::cout);
+
+bool ParseShader(glslang::TShader* p_shader, const EShMessages e_messages, glslang::TShader::Includer& includer,
+    std::ostream& log = std::cout);
 
-bool ParseShader(glslang::TShader* p_shader, const EShMessages e_messages);
+// Links, maps IO and builds the reflection; each step is a span of
+// program_name when p_tracer is set.
+bool InitializeProgram(glslang::TProgram& program, const EShMessages e_messages, std::ostream& log = std::cout,
+    Tracer* p_tracer = nullptr, const std::string& program_name = std::string());
 
-bool InitializeProgram(glslang::TProgram& program, const EShMessages e_messages);
+// #include fails without p_includer (see ShaderIncluder).
+bool ConfigureShader(glslang::TShader* const p_shader, EShLanguage stage, Config& k_config, std::ostream& log = std::cout,
+    glslang::TShader::Includer* p_includer = nullptr);
 
-void ConfigureShader(glslang::TShader* const p_shader, EShLanguage stage, Config& k_config);
\ No newline at end of file
+// Sets the same environment as ConfigureShader but only runs the
+// preprocessor, leaving the expanded text in output.
+bool PreprocessShader(glslang::TShader* const p_shader, EShLanguage stage, Config& k_config, std::string& output, std::ostream& log = std::cout,
+    glslang::TShader::Includer* p_includer = nullptr);
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include <cstring>
+#include "string_arena.h"
+
+namespace {
+uint32_t Hash(const char* text, size_t size) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(text[i])) * 16777619u;
+    }
+    return hash;
+}
+}
+
+const char* StringArena::intern(const char* text) {
+    return intern(text, std::strlen(text));
+}
+
+const char* StringArena::intern(const char* text, size_t size) {
+    if ((m_count + 1) * 2 > m_table.size()) {
+        grow();
+    }
+    const size_t mask = m_table.size() - 1;
+    size_t slot = Hash(text, size) & mask;
+    while (m_table[slot] != nullptr) {
+        const char* interned = m_table[slot];
+        if (std::strncmp(interned, text, size) == 0 && interned[size] == '\0') {
+            return interned;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    char* copy = allocate(size + 1);
+    std::memcpy(copy, text, size);
+    copy[size] = '\0';
+    m_table[slot] = copy;
+    ++m_count;
+    return copy;
+}
+
+char* StringArena::allocate(size_t size) {
+    if (size > kBlockSize / 4) {
+        // Large strings get a block of their own, so the free space of the
+        // current block is not given up for them.
+        m_large_blocks.emplace_back(new char[size]);
+        return m_large_blocks.back().get();
+    }
+    if (m_block_used + size > kBlockSize) {
+        m_blocks.emplace_back(new char[kBlockSize]);
+        m_block_used = 0;
+    }
+    char* p = m_blocks.back().get() + m_block_used;
+    m_block_used += size;
+    return p;
+}
+
+void StringArena::grow() {
+    std::vector<const char*> table(m_table.empty() ? 64 : m_table.size() * 2, nullptr);
+    const size_t mask = table.size() - 1;
+    for (const char* interned : m_table) {
+        if (interned == nullptr) {
+            continue;
+        }
+        size_t slot = Hash(interned, std::strlen(interned)) & mask;
+        while (table[slot] != nullptr) {
+            slot = (slot + 1) & mask;
+        }
+        table[slot] = interned;
+    }
+    m_table.swap(table);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// Interns null-terminated strings into a few large blocks. An interned
+// string stays put for the life of the arena, and equal strings share one
+// copy, so they can be compared by pointer. Everything is freed at once
+// with the arena. Not thread-safe.
+class StringArena {
+public:
+    StringArena() = default;
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    const char* intern(const char* text);
+    const char* intern(const char* text, size_t size);
+
+    size_t getBlockCount() const { return m_blocks.size() + m_large_blocks.size(); }
+
+private:
+    static const size_t kBlockSize = 4096;
+
+    char* allocate(size_t size);
+    void grow();
+
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    std::vector<std::unique_ptr<char[]>> m_large_blocks;
+    size_t m_block_used = kBlockSize;
+    // Open addressing, the size a power of two; null marks a free slot.
+    std::vector<const char*> m_table;
+    size_t m_count = 0;
+};
@@ -0,0 +1,180 @@
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <iomanip>
+#include "tracer.h"
+#include "json_writer.h"
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "Psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+uint64_t GetPeakRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // Kilobytes on Linux.
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+}
+
+void WriteEventHeader(JsonWriter& writer, const char* name, const char* phase, uint32_t thread, uint64_t time_us) {
+    writer.key("name");
+    writer.value(name);
+    writer.key("ph");
+    writer.value(phase);
+    writer.key("ts");
+    writer.value(time_us);
+    writer.key("pid");
+    writer.value(1u);
+    writer.key("tid");
+    writer.value(thread);
+}
+
+void WriteMilliseconds(std::ostream& out, uint64_t us) {
+    out << std::setw(12) << us / 1000.0 << " ms  ";
+}
+}
+
+Tracer::Tracer() : m_start(Clock::now()) {
+
+}
+
+void Tracer::addSpan(const char* name, const std::string& program, const char* stage,
+    Clock::time_point begin, Clock::time_point end) {
+    const uint64_t begin_us = toMicroseconds(begin);
+    const uint64_t end_us = toMicroseconds(end);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_spans.push_back({ name, program, stage, getThreadIndex(), begin_us, end_us - begin_us });
+}
+
+void Tracer::addMemorySample() {
+    const uint64_t time_us = toMicroseconds(Clock::now());
+    const uint64_t peak_rss_kb = GetPeakRssKb();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_memory.push_back({ getThreadIndex(), time_us, peak_rss_kb });
+}
+
+bool Tracer::writeFile(const std::string& path) const {
+    std::string out;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        JsonWriter writer(out, true);
+        writer.beginObject();
+        writer.key("displayTimeUnit");
+        writer.value("ms");
+        writer.key("traceEvents");
+        writer.beginArray();
+        for (const auto& thread : m_threads) {
+            writer.beginObject();
+            WriteEventHeader(writer, "thread_name", "M", thread.second, 0);
+            writer.key("args");
+            writer.beginObject();
+            writer.key("name");
+            writer.value("thread " + std::to_string(thread.second));
+            writer.endObject();
+            writer.endObject();
+        }
+        for (const auto& span : m_spans) {
+            writer.beginObject();
+            WriteEventHeader(writer, span.name, "X", span.thread, span.begin_us);
+            writer.key("dur");
+            writer.value(span.duration_us);
+            writer.key("cat");
+            writer.value(span.stage != nullptr ? "stage" : "program");
+            writer.key("args");
+            writer.beginObject();
+            writer.key("program");
+            writer.value(span.program);
+            if (span.stage != nullptr) {
+                writer.key("stage");
+                writer.value(span.stage);
+            }
+            writer.endObject();
+            writer.endObject();
+        }
+        for (const auto& sample : m_memory) {
+            writer.beginObject();
+            WriteEventHeader(writer, "memory", "C", sample.thread, sample.time_us);
+            writer.key("args");
+            writer.beginObject();
+            writer.key("peak_rss_kb");
+            writer.value(sample.peak_rss_kb);
+            writer.endObject();
+            writer.endObject();
+        }
+        writer.endArray();
+        writer.endObject();
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write(out.data(), out.size());
+    return file.good();
+}
+
+void Tracer::writeSummary(std::ostream& out, size_t count) const {
+    std::vector<std::pair<uint64_t, std::string>> programs;
+    std::map<std::string, uint64_t> phases;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& span : m_spans) {
+            if (std::strcmp(span.name, "program") == 0) {
+                programs.emplace_back(span.duration_us, span.program);
+            }
+            else {
+                phases[span.name] += span.duration_us;
+            }
+        }
+    }
+    std::vector<std::pair<uint64_t, std::string>> phase_totals;
+    for (const auto& phase : phases) {
+        phase_totals.emplace_back(phase.second, phase.first);
+    }
+    auto slowest_first = [](const std::pair<uint64_t, std::string>& a, const std::pair<uint64_t, std::string>& b) {
+        return a.first > b.first;
+    };
+    std::sort(programs.begin(), programs.end(), slowest_first);
+    std::sort(phase_totals.begin(), phase_totals.end(), slowest_first);
+
+    out << std::fixed << std::setprecision(1);
+    out << "slowest programs:" << std::endl;
+    for (size_t i = 0; i < std::min(count, programs.size()); ++i) {
+        WriteMilliseconds(out, programs[i].first);
+        out << programs[i].second << std::endl;
+    }
+    out << "slowest phases (all programs):" << std::endl;
+    for (size_t i = 0; i < std::min(count, phase_totals.size()); ++i) {
+        WriteMilliseconds(out, phase_totals[i].first);
+        out << phase_totals[i].second << std::endl;
+    }
+    out.unsetf(std::ios::floatfield);
+}
+
+uint32_t Tracer::getThreadIndex() {
+    const auto id = std::this_thread::get_id();
+    auto thread = m_threads.find(id);
+    if (thread == m_threads.end()) {
+        thread = m_threads.emplace(id, static_cast<uint32_t>(m_threads.size())).first;
+    }
+    return thread->second;
+}
+
+uint64_t Tracer::toMicroseconds(Clock::time_point time) const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(time - m_start).count());
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+// Records what every thread spent its time on, span by span, along with
+// samples of the peak resident memory. The recording is written in the
+// Chrome trace event format (viewable in Perfetto or chrome://tracing),
+// or summed up as the slowest programs and phases. Thread-safe.
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Tracer();
+
+    // stage may be null for spans covering the whole program.
+    void addSpan(const char* name, const std::string& program, const char* stage,
+        Clock::time_point begin, Clock::time_point end);
+    // Samples the peak resident memory of the process so far.
+    void addMemorySample();
+
+    bool writeFile(const std::string& path) const;
+    // The count slowest "program" spans, then the count phases that took
+    // the most time over all programs.
+    void writeSummary(std::ostream& out, size_t count) const;
+
+private:
+    struct Span {
+        const char* name;
+        std::string program;
+        const char* stage;
+        uint32_t thread;
+        uint64_t begin_us;
+        uint64_t duration_us;
+    };
+
+    struct MemorySample {
+        uint32_t thread;
+        uint64_t time_us;
+        uint64_t peak_rss_kb;
+    };
+
+    // Small, stable thread numbers in the order threads first show up.
+    uint32_t getThreadIndex();
+    uint64_t toMicroseconds(Clock::time_point time) const;
+
+    const Clock::time_point m_start;
+    mutable std::mutex m_mutex;
+    std::vector<Span> m_spans;
+    std::vector<MemorySample> m_memory;
+    std::map<std::thread::id, uint32_t> m_threads;
+};
+
+// Adds a span from its construction to its destruction; does nothing
+// without a tracer. name and stage must outlive the tracer.
+class TraceSpan {
+public:
+    TraceSpan(Tracer* p_tracer, const char* name, const std::string& program, const char* stage = nullptr) :
+        m_p_tracer(p_tracer), m_name(name), m_program(p_tracer != nullptr ? program : std::string()),
+        m_stage(stage), m_begin(p_tracer != nullptr ? Tracer::Clock::now() : Tracer::Clock::time_point()) {}
+    ~TraceSpan() {
+        if (m_p_tracer != nullptr) {
+            m_p_tracer->addSpan(m_name, m_program, m_stage, m_begin, Tracer::Clock::now());
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    Tracer* m_p_tracer;
+    const char* m_name;
+    std::string m_program;
+    const char* m_stage;
+    Tracer::Clock::time_point m_begin;
+};
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <vulkan/vulkan.h>
+#include "vertex_input.h"
+
+namespace {
+// A format with 1 to 4 components, the bytes of one component and the
+// numeric format that ends its VkFormat name.
+struct FormatFamily {
+    const char* name;
+    uint32_t component_bytes;
+    const char* numeric_format;
+    VkFormat formats[4];
+};
+
+const FormatFamily kFamilies[] = {
+    { "float", 4, "SFLOAT", { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT } },
+    { "half", 2, "SFLOAT", { VK_FORMAT_R16_SFLOAT, VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16B16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT } },
+    { "unorm8", 1, "UNORM", { VK_FORMAT_R8_UNORM, VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_R8G8B8A8_UNORM } },
+    { "snorm8", 1, "SNORM", { VK_FORMAT_R8_SNORM, VK_FORMAT_R8G8_SNORM, VK_FORMAT_R8G8B8_SNORM, VK_FORMAT_R8G8B8A8_SNORM } },
+    { "unorm16", 2, "UNORM", { VK_FORMAT_R16_UNORM, VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16B16_UNORM, VK_FORMAT_R16G16B16A16_UNORM } },
+    { "snorm16", 2, "SNORM", { VK_FORMAT_R16_SNORM, VK_FORMAT_R16G16_SNORM, VK_FORMAT_R16G16B16_SNORM, VK_FORMAT_R16G16B16A16_SNORM } },
+    // The formats of other attributes, by basic type.
+    { "double", 8, "SFLOAT", { VK_FORMAT_R64_SFLOAT, VK_FORMAT_R64G64_SFLOAT, VK_FORMAT_R64G64B64_SFLOAT, VK_FORMAT_R64G64B64A64_SFLOAT } },
+    { "float16_t", 2, "SFLOAT", { VK_FORMAT_R16_SFLOAT, VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16B16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT } },
+    { "int", 4, "SINT", { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT } },
+    { "uint", 4, "UINT", { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT } },
+    { "int8_t", 1, "SINT", { VK_FORMAT_R8_SINT, VK_FORMAT_R8G8_SINT, VK_FORMAT_R8G8B8_SINT, VK_FORMAT_R8G8B8A8_SINT } },
+    { "uint8_t", 1, "UINT", { VK_FORMAT_R8_UINT, VK_FORMAT_R8G8_UINT, VK_FORMAT_R8G8B8_UINT, VK_FORMAT_R8G8B8A8_UINT } },
+    { "int16_t", 2, "SINT", { VK_FORMAT_R16_SINT, VK_FORMAT_R16G16_SINT, VK_FORMAT_R16G16B16_SINT, VK_FORMAT_R16G16B16A16_SINT } },
+    { "uint16_t", 2, "UINT", { VK_FORMAT_R16_UINT, VK_FORMAT_R16G16_UINT, VK_FORMAT_R16G16B16_UINT, VK_FORMAT_R16G16B16A16_UINT } },
+    { "int64_t", 8, "SINT", { VK_FORMAT_R64_SINT, VK_FORMAT_R64G64_SINT, VK_FORMAT_R64G64B64_SINT, VK_FORMAT_R64G64B64A64_SINT } },
+    { "uint64_t", 8, "UINT", { VK_FORMAT_R64_UINT, VK_FORMAT_R64G64_UINT, VK_FORMAT_R64G64B64_UINT, VK_FORMAT_R64G64B64A64_UINT } },
+};
+
+// The first ones, those a float attribute may be fetched as.
+const size_t kFloatFamilyCount = 6;
+
+const FormatFamily* FindFamily(const char* name, size_t count = sizeof(kFamilies) / sizeof(kFamilies[0])) {
+    for (size_t i = 0; i < count; ++i) {
+        if (std::strcmp(kFamilies[i].name, name) == 0) {
+            return &kFamilies[i];
+        }
+    }
+    return nullptr;
+}
+
+const FormatFamily& GetFamily(const ReflectedAttribute& attribute, const VertexInputOptions& options) {
+    const bool is_float = std::strcmp(attribute.basic_type, "float") == 0;
+    const auto format = options.formats.find(attribute.name);
+    if (format != options.formats.end()) {
+        if (!is_float) {
+            throw std::runtime_error("vertex_input formats only apply to float attributes.");
+        }
+        return *FindFamily(format->second.c_str());
+    }
+    if (is_float && options.compact) {
+        return *FindFamily("half");
+    }
+    const auto family = FindFamily(attribute.basic_type);
+    if (family == nullptr) {
+        throw std::runtime_error("attribute type has no vertex format.");
+    }
+    return *family;
+}
+
+uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+}
+
+std::string VertexFormatName(uint32_t format) {
+    for (const auto& family : kFamilies) {
+        for (uint32_t components = 1; components <= 4; ++components) {
+            if (static_cast<uint32_t>(family.formats[components - 1]) != format) {
+                continue;
+            }
+            std::string name = "VK_FORMAT_";
+            for (uint32_t i = 0; i < components; ++i) {
+                name += "RGBA"[i] + std::to_string(family.component_bytes * 8);
+            }
+            return name + "_" + family.numeric_format;
+        }
+    }
+    return "static_cast<VkFormat>(" + std::to_string(format) + ")";
+}
+
+bool VertexInputOptions::isFormat(const std::string& format) {
+    return FindFamily(format.c_str(), kFloatFamilyCount) != nullptr;
+}
+
+void BuildVertexInput(ProgramReflection& reflection, const VertexInputOptions& options) {
+    reflection.vertex_bindings.clear();
+    reflection.vertex_attributes.clear();
+
+    std::vector<const ReflectedAttribute*> attributes;
+    for (const auto& attribute : reflection.attributes) {
+        if (std::strncmp(attribute.name, "gl_", 3) == 0) {
+            continue;
+        }
+        // Without layout(location) the linker places it; nothing to build.
+        if (attribute.qualifier.location == kReflectionAbsent) {
+            return;
+        }
+        attributes.push_back(&attribute);
+    }
+    if (attributes.empty()) {
+        return;
+    }
+    std::sort(attributes.begin(), attributes.end(), [](const ReflectedAttribute* a, const ReflectedAttribute* b) {
+        return a->qualifier.location < b->qualifier.location;
+    });
+
+    // Per-vertex attributes first, then per-instance ones.
+    for (uint32_t input_rate : { VK_VERTEX_INPUT_RATE_VERTEX, VK_VERTEX_INPUT_RATE_INSTANCE }) {
+        const uint32_t binding = static_cast<uint32_t>(reflection.vertex_bindings.size());
+        uint32_t offset = 0;
+        uint32_t alignment = 1;
+        for (const auto p_attribute : attributes) {
+            const bool instanced = options.instanced.count(p_attribute->name) > 0;
+            if (instanced != (input_rate == VK_VERTEX_INPUT_RATE_INSTANCE)) {
+                continue;
+            }
+            const auto& family = GetFamily(*p_attribute, options);
+            // Each column of a matrix is a vector at a location of its own;
+            // array elements follow one another the same way.
+            const bool matrix = p_attribute->matrix_columns > 0;
+            uint32_t components = matrix ? p_attribute->matrix_rows : p_attribute->vector_size;
+            const uint32_t columns = (matrix ? p_attribute->matrix_columns : 1) * p_attribute->array_size;
+            // 64-bit vectors of three or four components take two locations.
+            const uint32_t locations = family.component_bytes == 8 && components > 2 ? 2 : 1;
+            // Three 8 or 16-bit components are an optional vertex format; a
+            // fourth that the shader ignores is supported everywhere.
+            if (components == 3 && family.component_bytes < 4) {
+                components = 4;
+            }
+            uint32_t location = p_attribute->qualifier.location;
+            for (uint32_t column = 0; column < columns; ++column) {
+                offset = AlignUp(offset, family.component_bytes);
+                reflection.vertex_attributes.push_back({ location, binding,
+                    static_cast<uint32_t>(family.formats[components - 1]), offset });
+                offset += family.component_bytes * components;
+                location += locations;
+            }
+            alignment = std::max(alignment, family.component_bytes);
+        }
+        if (offset > 0) {
+            reflection.vertex_bindings.push_back({ binding, AlignUp(offset, alignment), input_rate });
+        }
+    }
+}
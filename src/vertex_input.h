@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <set>
+#include <map>
+#include "reflection.h"
+
+// Builds the vertex input state of a pipeline from the attributes of its
+// vertex stage: one VkVertexInputBindingDescription per buffer and one
+// VkVertexInputAttributeDescription per location a vertex fetch reads,
+// so a matrix gets one per column. Attributes are interleaved in location
+// order, each at the next offset its components are aligned to.
+
+// "vertex_input" of a config.
+struct VertexInputOptions {
+    // Attributes fed per instance, from a binding after the per-vertex one.
+    std::set<std::string> instanced;
+    // Float attributes are fetched as half floats unless formats says
+    // otherwise.
+    bool compact = false;
+    // Attribute name to "float", "half", "unorm8", "snorm8", "unorm16" or
+    // "snorm16"; only for float attributes.
+    std::map<std::string, std::string> formats;
+
+    static bool isFormat(const std::string& format);
+};
+
+// Fills the vertex_bindings and vertex_attributes of reflection, leaving
+// them empty when an attribute has no location to put it at.
+void BuildVertexInput(ProgramReflection& reflection, const VertexInputOptions& options);
+
+// The VkFormat enumerator of a format BuildVertexInput picks, as C++ source.
+std::string VertexFormatName(uint32_t format);
@@ -0,0 +1,109 @@
+#include <iostream>
+#include "watch_mode.h"
+#include "batch_compiler.h"
+#include "config.h"
+#include "shader_archive_writer.h"
+#include "include_cache.h"
+
+namespace {
+// Editors write several files, or one file several times, per save.
+const int kDebounceMs = 100;
+const int kMaxDebounceMs = 2000;
+}
+
+WatchSession::WatchSession(const Manifest& manifest, const Options& options, const CompileContext& context) :
+    m_manifest(manifest),
+    m_options(options),
+    m_context(context) {
+    m_context.keep_unchanged_outputs = true;
+}
+
+void WatchSession::run() {
+    std::vector<size_t> all_programs;
+    for (size_t i = 0; i < m_manifest.getPrograms().size(); ++i) {
+        all_programs.push_back(i);
+    }
+    compile(all_programs);
+
+    while (true) {
+        std::set<std::string> changed;
+        if (!m_watcher.wait(changed, -1)) {
+            continue;
+        }
+        for (int waited = 0; waited < kMaxDebounceMs && m_watcher.wait(changed, kDebounceMs); waited += kDebounceMs) {
+
+        }
+
+        std::set<size_t> affected;
+        for (const auto& path : changed) {
+            std::cout << "changed: " << path << std::endl;
+            auto dependents = m_dependents.find(path);
+            if (dependents != m_dependents.end()) {
+                affected.insert(dependents->second.begin(), dependents->second.end());
+            }
+        }
+        if (!affected.empty()) {
+            compile(std::vector<size_t>(affected.begin(), affected.end()));
+        }
+    }
+}
+
+void WatchSession::compile(const std::vector<size_t>& program_indices) {
+    std::vector<Manifest::Program> programs;
+    for (auto i : program_indices) {
+        programs.push_back(m_manifest.getPrograms()[i]);
+    }
+    Manifest manifest(programs);
+    BatchCompiler batch_compiler(manifest, m_options, m_context);
+    batch_compiler.run();
+    if (m_context.p_archive != nullptr) {
+        m_context.p_archive->commit();
+    }
+
+    for (auto i : program_indices) {
+        updateDependencies(i);
+    }
+    // Files stay mapped only while compiling, so they can be edited.
+    if (m_context.p_include_cache != nullptr) {
+        m_context.p_include_cache->clear();
+    }
+}
+
+void WatchSession::updateDependencies(size_t program_index) {
+    for (auto& dependents : m_dependents) {
+        dependents.second.erase(program_index);
+    }
+
+    const auto& program = m_manifest.getPrograms()[program_index];
+    std::set<std::string> files;
+    try {
+        if (program.config.is_null()) {
+            files.insert(AbsolutePath(program.name));
+        }
+        Config config = program.config.is_null() ?
+            Config(Config::LoadJSON(program.name)) :
+            Config(program.config);
+        IncludeCache own_cache;
+        auto& include_cache = m_context.p_include_cache != nullptr ? *m_context.p_include_cache : own_cache;
+        for (const auto& path : config.shaderFilepaths) {
+            if (config.shaderSources.count(path.first) == 0) {
+                ScanIncludes(path.second, config.getIncludePaths(), files, include_cache);
+            }
+        }
+    }
+    catch (std::exception&) {
+        // A broken config is still watched, so fixing it triggers a rebuild.
+    }
+
+    for (const auto& file : files) {
+        m_dependents[file].insert(program_index);
+        // A file in a directory that does not exist yet is watched again
+        // after the next rebuild of the program.
+        try {
+            m_watcher.watch(file);
+        }
+        catch (std::exception& error) {
+            std::cout << error.what() << std::endl;
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include "manifest.h"
+#include "options.h"
+#include "program_compiler.h"
+#include "file_watcher.h"
+
+// Keeps the outputs of a set of programs up to date. Every file a program
+// reads (its config, stage sources and their transitive #includes) is
+// watched; a burst of changes is coalesced and only the programs depending
+// on a changed file are compiled again.
+class WatchSession {
+public:
+    WatchSession(const Manifest& manifest, const Options& options, const CompileContext& context);
+
+    // Never returns; stop the process to end the session.
+    void run();
+
+private:
+    void compile(const std::vector<size_t>& program_indices);
+    void updateDependencies(size_t program_index);
+
+    const Manifest& m_manifest;
+    const Options& m_options;
+    CompileContext m_context;
+    FileWatcher m_watcher;
+    // Absolute file path to the programs reading it.
+    std::map<std::string, std::set<size_t>> m_dependents;
+};